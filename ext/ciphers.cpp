@@ -36,17 +36,20 @@
 // stream cipher algorithms:
 
 #include "jarc4.h"
+#include "jchacha.h"
 #include "jmarc4.h"
 #include "jpanamacipher.h"
 #include "jseal.h"
 
 #include "jbasiccipherinfo.h"
+#include "jciphercache.h"
 #include "jexception.h"
 
 #include "cryptopp_ruby_api.h"
 
 extern void cipher_mark(JBase *c);
 extern void cipher_free(JBase *c);
+extern JHash* digest_factory(VALUE algorithm);
 
 // forward declarations
 
@@ -62,14 +65,20 @@ static VALUE wrap_cipher_in_ruby(JBase* cipher);
 static void cipher_rand_iv(VALUE self, VALUE l);
 static string cipher_iv_eq(VALUE self, VALUE iv, bool hex);
 static string cipher_iv(VALUE self, bool hex);
-static string cipher_plaintext_eq(VALUE self, VALUE plaintext, bool hex);
-static string cipher_plaintext(VALUE self, bool hex);
-static string cipher_ciphertext_eq(VALUE self, VALUE ciphertext, bool hex);
-static string cipher_ciphertext(VALUE self, bool hex);
+static void cipher_aad_eq(VALUE self, VALUE aad, bool hex);
+static void cipher_mac_key_eq(VALUE self, VALUE key, bool hex);
+static void cipher_plaintext_eq(VALUE self, VALUE plaintext, bool hex);
+static VALUE cipher_plaintext(VALUE self, bool hex);
+static void cipher_ciphertext_eq(VALUE self, VALUE ciphertext, bool hex);
+static VALUE cipher_ciphertext(VALUE self, bool hex);
 static string cipher_key_eq(VALUE self, VALUE key, bool hex);
 static string cipher_key(VALUE self, bool hex);
 static VALUE cipher_encrypt(VALUE self, bool hex);
 static VALUE cipher_decrypt(VALUE self, bool hex);
+static VALUE cipher_message(JBase* cipher, VALUE data, bool decrypting);
+static VALUE cipher_in_place(VALUE self, VALUE data, bool decrypting);
+static VALUE cipher_update(VALUE self, VALUE data, bool decrypting);
+static VALUE cipher_str_new(const string& data, bool hex);
 
 static CipherEnum cipher_sym_to_const(VALUE c)
 {
@@ -163,6 +172,21 @@ static bool cipher_enabled(CipherEnum cipher)
 }
 
 
+/* Builds a Ruby String of exactly the right size and writes data, or its hex
+ * encoding, straight into it, so results aren't copied through temporary
+ * std::strings on the way out. */
+static VALUE cipher_str_new(const string& data, bool hex)
+{
+  if (!hex) {
+    return rb_tainted_str_new(data.data(), data.length());
+  }
+
+  VALUE retval = rb_tainted_str_new(NULL, data.length() * 2);
+  StringSource(data, true, new HexEncoder(new ArraySink((byte*) RSTRING_PTR(retval), data.length() * 2), false));
+  return retval;
+}
+
+
 /* Figure out options for a cipher. We only check for Symbols, not Strings. */
 static void cipher_options(VALUE self, VALUE options)
 {
@@ -196,6 +220,14 @@ static void cipher_options(VALUE self, VALUE options)
     }
   }
 
+  // XTS changes what key lengths are valid, so the mode goes first
+  {
+    VALUE block_mode = rb_hash_aref(options, ID2SYM(rb_intern("block_mode")));
+    if (!NIL_P(block_mode)) {
+      rb_cipher_block_mode_eq(self, block_mode);
+    }
+  }
+
   {
     VALUE key = rb_hash_aref(options, ID2SYM(rb_intern("key")));
     VALUE key_hex = rb_hash_aref(options, ID2SYM(rb_intern("key_hex")));
@@ -263,16 +295,69 @@ static void cipher_options(VALUE self, VALUE options)
   }
 
   {
-    VALUE block_mode = rb_hash_aref(options, ID2SYM(rb_intern("block_mode")));
-    if (!NIL_P(block_mode)) {
-      rb_cipher_block_mode_eq(self, block_mode);
+    VALUE padding = rb_hash_aref(options, ID2SYM(rb_intern("padding")));
+    if (!NIL_P(padding)) {
+      rb_cipher_padding_eq(self, padding);
     }
   }
 
   {
-    VALUE padding = rb_hash_aref(options, ID2SYM(rb_intern("padding")));
-    if (!NIL_P(padding)) {
-      rb_cipher_padding_eq(self, padding);
+    VALUE aad = rb_hash_aref(options, ID2SYM(rb_intern("aad")));
+    VALUE aad_hex = rb_hash_aref(options, ID2SYM(rb_intern("aad_hex")));
+    if (!NIL_P(aad) && !NIL_P(aad_hex)) {
+      rb_raise(rb_eCryptoPP_Error, "can't set both aad and aad_hex in options");
+    }
+    else if (!NIL_P(aad)) {
+      cipher_aad_eq(self, aad, false);
+    }
+    else if (!NIL_P(aad_hex)) {
+      cipher_aad_eq(self, aad_hex, true);
+    }
+  }
+
+  {
+    VALUE tag_length = rb_hash_aref(options, ID2SYM(rb_intern("tag_length")));
+    if (!NIL_P(tag_length)) {
+      rb_cipher_tag_length_eq(self, tag_length);
+    }
+  }
+
+  {
+    VALUE gcm_tables = rb_hash_aref(options, ID2SYM(rb_intern("gcm_tables")));
+    if (!NIL_P(gcm_tables)) {
+      rb_cipher_gcm_tables_eq(self, gcm_tables);
+    }
+  }
+
+  {
+    VALUE mac = rb_hash_aref(options, ID2SYM(rb_intern("mac")));
+    if (!NIL_P(mac)) {
+      rb_cipher_mac_eq(self, mac);
+    }
+  }
+
+  {
+    VALUE mac_key = rb_hash_aref(options, ID2SYM(rb_intern("mac_key")));
+    VALUE mac_key_hex = rb_hash_aref(options, ID2SYM(rb_intern("mac_key_hex")));
+    if (!NIL_P(mac_key) && !NIL_P(mac_key_hex)) {
+      rb_raise(rb_eCryptoPP_Error, "can't set both mac_key and mac_key_hex in options");
+    }
+    else if (!NIL_P(mac_key)) {
+      cipher_mac_key_eq(self, mac_key, false);
+    }
+    else if (!NIL_P(mac_key_hex)) {
+      cipher_mac_key_eq(self, mac_key_hex, true);
+    }
+  }
+
+  {
+    VALUE parallel = rb_hash_aref(options, ID2SYM(rb_intern("parallel")));
+    VALUE threads = rb_hash_aref(options, ID2SYM(rb_intern("threads")));
+    if (!NIL_P(threads)) {
+      rb_cipher_threads_eq(self, threads);
+    }
+    else if (RTEST(parallel)) {
+      rb_cipher_threads_eq(self, UINT2NUM(getProcessorCount()));
     }
   }
 }
@@ -457,6 +542,322 @@ VALUE rb_cipher_iv_hex(VALUE self)
 }
 
 
+/* Sets the additional authenticated data. */
+static void cipher_aad_eq(VALUE self, VALUE aad, bool hex)
+{
+  JBase *cipher = NULL;
+  Check_Type(aad, T_STRING);
+  Data_Get_Struct(self, JBase, cipher);
+  cipher->setAAD(string(StringValuePtr(aad), RSTRING_LEN(aad)), hex);
+}
+
+/**
+ * call-seq:
+ *    aad=(aad) => String
+ *
+ * Sets additional authenticated data for the authenticated block modes,
+ * :gcm, :eax and :ocb, and the :chacha20_poly1305 and :xchacha20_poly1305
+ * ciphers. The data isn't encrypted but is covered by the tag,
+ * so decryption fails if it doesn't match what was used for encryption.
+ */
+VALUE rb_cipher_aad_eq(VALUE self, VALUE aad)
+{
+  cipher_aad_eq(self, aad, false);
+  return aad;
+}
+
+/**
+ * call-seq:
+ *    aad_hex=(aad) => String
+ *
+ * Sets additional authenticated data using hex data.
+ */
+VALUE rb_cipher_aad_hex_eq(VALUE self, VALUE aad)
+{
+  cipher_aad_eq(self, aad, true);
+  return aad;
+}
+
+/**
+ * call-seq:
+ *    aad => String
+ *
+ * Returns the additional authenticated data in binary.
+ */
+VALUE rb_cipher_aad(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  string retval = cipher->getAAD();
+  return rb_tainted_str_new(retval.data(), retval.length());
+}
+
+/**
+ * call-seq:
+ *    aad_hex => String
+ *
+ * Returns the additional authenticated data in hex.
+ */
+VALUE rb_cipher_aad_hex(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  string retval = cipher->getAAD(true);
+  return rb_tainted_str_new(retval.data(), retval.length());
+}
+
+/**
+ * call-seq:
+ *    tag => String
+ *
+ * Returns the authentication tag from the last encrypt in an authenticated
+ * block mode or cipher, in binary. The tag is also the last tag_length bytes of the
+ * ciphertext, which is where decrypt expects to find it.
+ */
+VALUE rb_cipher_tag(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  string retval = cipher->getTag();
+  return rb_tainted_str_new(retval.data(), retval.length());
+}
+
+/**
+ * call-seq:
+ *    tag_hex => String
+ *
+ * Returns the authentication tag from the last encrypt in hex.
+ */
+VALUE rb_cipher_tag_hex(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  string retval = cipher->getTag(true);
+  return rb_tainted_str_new(retval.data(), retval.length());
+}
+
+/**
+ * call-seq:
+ *    tag_length=(length) => Integer
+ *
+ * Sets the length in bytes of the authentication tag, between 4 and 16.
+ * The default is 16. Returns the length as set.
+ */
+VALUE rb_cipher_tag_length_eq(VALUE self, VALUE l)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  return UINT2NUM(cipher->setTagLength(NUM2UINT(rb_funcall(l, rb_intern("to_i"), 0))));
+}
+
+/**
+ * call-seq:
+ *    tag_length => Integer
+ *
+ * Gets the length in bytes of the authentication tag.
+ */
+VALUE rb_cipher_tag_length(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  return UINT2NUM(cipher->getTagLength());
+}
+
+
+/**
+ * call-seq:
+ *    gcm_tables=(tables) => Symbol
+ *
+ * Sets the size of the tables used for GHASH in :gcm mode, either :gcm_2k
+ * or :gcm_64k. The larger tables are faster on CPUs without carry-less
+ * multiplication but take up 64 KB per Cipher and are slower to set up.
+ * Where the CPU has PCLMULQDQ Crypto++ uses that instead and the setting
+ * makes little difference. The default is :gcm_2k. Raises an exception on
+ * stream ciphers.
+ */
+VALUE rb_cipher_gcm_tables_eq(VALUE self, VALUE t)
+{
+  JBase *cipher = NULL;
+  GCM_TablesOption tables;
+  ID id = SYM2ID(t);
+
+  if (id == rb_intern("gcm_2k")) {
+    tables = GCM_2K_Tables;
+  }
+  else if (id == rb_intern("gcm_64k")) {
+    tables = GCM_64K_Tables;
+  }
+  else {
+    rb_raise(rb_eCryptoPP_Error, "invalid GCM tables; use :gcm_2k or :gcm_64k");
+  }
+
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can't set GCM tables on stream ciphers");
+  }
+  else {
+    ((JCipher*) cipher)->setGCMTables(tables);
+    return t;
+  }
+}
+
+/**
+ * call-seq:
+ *    gcm_tables => Symbol
+ *
+ * Gets the size of the GCM tables. Returns nil on stream ciphers.
+ */
+VALUE rb_cipher_gcm_tables(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    return Qnil;
+  }
+  else if (((JCipher*) cipher)->getGCMTables() == GCM_64K_Tables) {
+    return ID2SYM(rb_intern("gcm_64k"));
+  }
+  else {
+    return ID2SYM(rb_intern("gcm_2k"));
+  }
+}
+
+
+/**
+ * call-seq:
+ *    mac=(hmac) => Symbol
+ *
+ * Turns on encrypt-then-MAC using one of the HMAC digests, e.g.
+ * :sha256_hmac. encrypt then appends an HMAC of the IV and ciphertext,
+ * truncated to tag_length bytes, and decrypt checks it before decrypting
+ * anything, raising a CryptoPPError if it doesn't match. The ciphertext is
+ * MACed as it is produced, so this is cheaper than encrypting and then
+ * running the result through a separate HMAC. The key is set with
+ * mac_key=, and should be independent of the cipher's key. Set to nil to
+ * turn it off. Raises an exception on stream ciphers and authenticated
+ * block modes, and whole messages are needed, so update and the IO
+ * methods are unavailable while a MAC is set.
+ */
+VALUE rb_cipher_mac_eq(VALUE self, VALUE m)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+
+  if (NIL_P(m)) {
+    cipher->setMAC(NULL);
+    return m;
+  }
+  else if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can't set a MAC on stream ciphers");
+  }
+
+  JHash* hash = NULL;
+  try {
+    hash = digest_factory(m);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+
+  JHMAC* mac = dynamic_cast<JHMAC*>(hash);
+  if (mac == NULL) {
+    delete hash;
+    rb_raise(rb_eCryptoPP_Error, "the MAC must be an HMAC digest");
+  }
+
+  cipher->setMAC(mac);
+  return m;
+}
+
+/**
+ * call-seq:
+ *    mac => Symbol
+ *
+ * Returns the HMAC used for encrypt-then-MAC, or nil if there isn't one.
+ */
+VALUE rb_cipher_mac(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  JHMAC *mac = cipher->getMAC();
+
+  if (mac == NULL) {
+    return Qnil;
+  }
+
+  switch (mac->getHashType()) {
+    default:
+      return Qnil;
+
+#    define HMAC_ALGORITHM_X(klass, r, c, s) \
+      case r ## _HMAC: \
+        return ID2SYM(rb_intern(# s));
+#    include "defs/hmacs.def"
+  }
+}
+
+/* Sets the key used for encrypt-then-MAC. */
+static void cipher_mac_key_eq(VALUE self, VALUE key, bool hex)
+{
+  JBase *cipher = NULL;
+  Check_Type(key, T_STRING);
+  Data_Get_Struct(self, JBase, cipher);
+  cipher->setMACKey(string(StringValuePtr(key), RSTRING_LEN(key)), hex);
+}
+
+/**
+ * call-seq:
+ *    mac_key=(key) => String
+ *
+ * Sets the key for encrypt-then-MAC.
+ */
+VALUE rb_cipher_mac_key_eq(VALUE self, VALUE key)
+{
+  cipher_mac_key_eq(self, key, false);
+  return key;
+}
+
+/**
+ * call-seq:
+ *    mac_key_hex=(key) => String
+ *
+ * Sets the key for encrypt-then-MAC using hex data.
+ */
+VALUE rb_cipher_mac_key_hex_eq(VALUE self, VALUE key)
+{
+  cipher_mac_key_eq(self, key, true);
+  return key;
+}
+
+/**
+ * call-seq:
+ *    mac_key => String
+ *
+ * Returns the key for encrypt-then-MAC in binary.
+ */
+VALUE rb_cipher_mac_key(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  string retval = cipher->getMACKey();
+  return rb_tainted_str_new(retval.data(), retval.length());
+}
+
+/**
+ * call-seq:
+ *    mac_key_hex => String
+ *
+ * Returns the key for encrypt-then-MAC in hex.
+ */
+VALUE rb_cipher_mac_key_hex(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  string retval = cipher->getMACKey(true);
+  return rb_tainted_str_new(retval.data(), retval.length());
+}
+
+
 /**
  * call-seq:
  *    block_mode=(mode) => Symbol
@@ -619,13 +1020,12 @@ VALUE rb_cipher_rng(VALUE self)
 
 
 /* Set the plaintext. */
-static string cipher_plaintext_eq(VALUE self, VALUE plaintext, bool hex)
+static void cipher_plaintext_eq(VALUE self, VALUE plaintext, bool hex)
 {
   JBase *cipher = NULL;
   Check_Type(plaintext, T_STRING);
   Data_Get_Struct(self, JBase, cipher);
   cipher->setPlaintext(string(StringValuePtr(plaintext), RSTRING_LEN(plaintext)), hex);
-  return cipher->getPlaintext(hex);
 }
 
 /**
@@ -654,11 +1054,11 @@ VALUE rb_cipher_plaintext_hex_eq(VALUE self, VALUE plaintext)
 
 
 /* Get the plaintext. */
-static string cipher_plaintext(VALUE self, bool hex)
+static VALUE cipher_plaintext(VALUE self, bool hex)
 {
   JBase *cipher = NULL;
   Data_Get_Struct(self, JBase, cipher);
-  return cipher->getPlaintext(hex);
+  return cipher_str_new(cipher->getRawPlaintext(), hex);
 }
 
 /**
@@ -669,8 +1069,7 @@ static string cipher_plaintext(VALUE self, bool hex)
  */
 VALUE rb_cipher_plaintext(VALUE self)
 {
-  string retval = cipher_plaintext(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_plaintext(self, false);
 }
 
 /**
@@ -681,19 +1080,17 @@ VALUE rb_cipher_plaintext(VALUE self)
  */
 VALUE rb_cipher_plaintext_hex(VALUE self)
 {
-  string retval = cipher_plaintext(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_plaintext(self, true);
 }
 
 
 /* Set the ciphertext. */
-static string cipher_ciphertext_eq(VALUE self, VALUE ciphertext, bool hex)
+static void cipher_ciphertext_eq(VALUE self, VALUE ciphertext, bool hex)
 {
   JBase *cipher = NULL;
   Check_Type(ciphertext, T_STRING);
   Data_Get_Struct(self, JBase, cipher);
   cipher->setCiphertext(string(StringValuePtr(ciphertext), RSTRING_LEN(ciphertext)), hex);
-  return cipher->getCiphertext(hex);
 }
 
 /**
@@ -722,11 +1119,11 @@ VALUE rb_cipher_ciphertext_hex_eq(VALUE self, VALUE ciphertext)
 
 
 /* Get the ciphertext. */
-static string cipher_ciphertext(VALUE self, bool hex)
+static VALUE cipher_ciphertext(VALUE self, bool hex)
 {
   JBase *cipher = NULL;
   Data_Get_Struct(self, JBase, cipher);
-  return cipher->getCiphertext(hex);
+  return cipher_str_new(cipher->getRawCiphertext(), hex);
 }
 
 /**
@@ -737,8 +1134,7 @@ static string cipher_ciphertext(VALUE self, bool hex)
  */
 VALUE rb_cipher_ciphertext(VALUE self)
 {
-  string retval = cipher_ciphertext(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_ciphertext(self, false);
 }
 
 /**
@@ -749,8 +1145,7 @@ VALUE rb_cipher_ciphertext(VALUE self)
  */
 VALUE rb_cipher_ciphertext_hex(VALUE self)
 {
-  string retval = cipher_ciphertext(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_ciphertext(self, true);
 }
 
 
@@ -1041,33 +1436,231 @@ VALUE rb_cipher_rounds(VALUE self)
 }
 
 
-/* Encrypt the plaintext using the options set on the Cipher. This method will
- * return the ciphertext in binary or hex accordingly, but the raw ciphertext
- * will always be available through the ciphertext methods regardless. */
-static VALUE cipher_encrypt(VALUE self, bool hex)
+/**
+ * call-seq:
+ *    threads=(threads) => Integer
+ *
+ * Sets the number of native threads block ciphers may use to encrypt and
+ * decrypt large buffers. Only work that can be split up without changing
+ * the result uses them: encryption and decryption in CTR and ECB modes,
+ * and decryption in CBC, CBC with CTS and CFB modes, including decrypt_io. Each
+ * thread gets at least 256 KB of work, so smaller buffers are processed on a
+ * single thread regardless.
+ * Raises an exception on stream ciphers.
+ */
+VALUE rb_cipher_threads_eq(VALUE self, VALUE t)
 {
   JBase *cipher = NULL;
+  unsigned int threads = NUM2UINT(rb_funcall(t, rb_intern("to_i"), 0));
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can't set threads on stream ciphers");
+  }
+  else {
+    return UINT2NUM(((JCipher*) cipher)->setThreads(threads));
+  }
+}
+
+
+/**
+ * call-seq:
+ *    threads => Integer
+ *
+ * Gets the number of threads block ciphers may use. Returns nil on stream
+ * ciphers.
+ */
+VALUE rb_cipher_threads(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    return Qnil;
+  }
+  else {
+    return UINT2NUM(((JCipher*) cipher)->getThreads());
+  }
+}
+
+
+struct JCipherMessage
+{
+  JBase* cipher;
+  const byte* in;
+  size_t length;
+  byte* out;
+  size_t written;
+  bool decrypting;
+  bool inPlace;
+  int state;
+  VALUE error;
+};
+
+/* The part of cipher_message and cipher_in_place that may run without the
+ * GVL. */
+static void cipher_message_work(void* data, const volatile bool* interrupted)
+{
+  JCipherMessage* message = (JCipherMessage*) data;
+  if (message->inPlace) {
+    message->cipher->processInPlace(message->out, message->length, message->decrypting, interrupted);
+    message->written = message->length;
+  }
+  else {
+    message->written = message->cipher->processMessage(message->in, message->length, message->out, message->decrypting, interrupted);
+  }
+}
+
+/* Runs a cipher_message job under rb_ensure. Crypto++ exceptions are caught
+ * here rather than being left to unwind through Ruby's frames. */
+static VALUE cipher_message_run(VALUE data)
+{
+  JCipherMessage* message = (JCipherMessage*) data;
+  try {
+    message->state = runWithoutGVL(cipher_message_work, message, message->length);
+  }
+  catch (Exception e) {
+    message->error = rb_str_new2(e.GetWhat().c_str());
+  }
+  return Qnil;
+}
+
+static VALUE cipher_message_unlock(VALUE data)
+{
+  return rb_str_unlocktmp(data);
+}
+
+/* Encrypts or decrypts data straight out of its String and into the one
+ * returned, without copying it into the Cipher. data is locked for the
+ * duration so it can't be modified or resized while the GVL is released. */
+static VALUE cipher_message(JBase* cipher, VALUE data, bool decrypting)
+{
+  StringValue(data);
+
+  JCipherMessage message;
+  message.cipher = cipher;
+  message.length = RSTRING_LEN(data);
+  message.written = 0;
+  message.decrypting = decrypting;
+  message.inPlace = false;
+  message.state = 0;
+  message.error = Qnil;
+
+  VALUE retval = rb_tainted_str_new(NULL, cipher->getMaxOutputLength(message.length, decrypting));
+  message.in = (const byte*) RSTRING_PTR(data);
+  message.out = (byte*) RSTRING_PTR(retval);
+
+  rb_str_locktmp(data);
+  rb_ensure(RUBY_METHOD_FUNC(cipher_message_run), (VALUE) &message, RUBY_METHOD_FUNC(cipher_message_unlock), data);
+
+  if (message.state != 0 || !NIL_P(message.error)) {
+    // a failed or interrupted decryption may have left unauthenticated
+    // plaintext behind
+    memset(RSTRING_PTR(retval), 0, RSTRING_LEN(retval));
+    if (message.state != 0) {
+      rb_jump_tag(message.state);
+    }
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", RSTRING_PTR(message.error));
+  }
+
+  rb_str_set_len(retval, message.written);
+  return retval;
+}
+
+/* Encrypts or decrypts data over itself. data is made independent of any
+ * Strings it shares its buffer with first, and raises if it's frozen. */
+static VALUE cipher_in_place(VALUE self, VALUE data, bool decrypting)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  StringValue(data);
+  rb_str_modify(data);
+
+  JCipherMessage message;
+  message.cipher = cipher;
+  message.in = (const byte*) RSTRING_PTR(data);
+  message.out = (byte*) RSTRING_PTR(data);
+  message.length = RSTRING_LEN(data);
+  message.written = 0;
+  message.decrypting = decrypting;
+  message.inPlace = true;
+  message.state = 0;
+  message.error = Qnil;
+
+  rb_str_locktmp(data);
+  rb_ensure(RUBY_METHOD_FUNC(cipher_message_run), (VALUE) &message, RUBY_METHOD_FUNC(cipher_message_unlock), data);
+
+  if (message.state != 0) {
+    rb_jump_tag(message.state);
+  }
+  if (!NIL_P(message.error)) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", RSTRING_PTR(message.error));
+  }
+
+  return data;
+}
+
+/* The parts of cipher_encrypt and cipher_decrypt that may run without the
+ * GVL. */
+static void cipher_encrypt_work(void* data, const volatile bool* interrupted)
+{
+  ((JBase*) data)->encrypt(interrupted);
+}
+
+static void cipher_decrypt_work(void* data, const volatile bool* interrupted)
+{
+  ((JBase*) data)->decrypt(interrupted);
+}
+
+/* Encrypt the plaintext using the options set on the Cipher. This method will
+ * return the ciphertext in binary or hex accordingly, but the raw ciphertext
+ * will always be available through the ciphertext methods regardless. */
+static VALUE cipher_encrypt(VALUE self, bool hex)
+{
+  JBase *cipher = NULL;
+  int state = 0;
   Data_Get_Struct(self, JBase, cipher);
   try {
-    cipher->encrypt();
-    return rb_tainted_str_new(cipher->getCiphertext(hex).data(), cipher->getCiphertext(hex).length());
+    state = runWithoutGVL(cipher_encrypt_work, cipher, cipher->getPlaintextLength());
   }
   catch (Exception e) {
     rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
   }
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  return cipher_str_new(cipher->getRawCiphertext(), hex);
 }
 
 /**
  * call-seq:
  *     encrypt => String
+ *     encrypt(data) => String
  *
  * Encrypt the plaintext using the options set on the Cipher. This method will
  * return the ciphertext in binary. The raw ciphertext will always be available
  * through the ciphertext and ciphertext_hex afterwards.
+ *
+ * Given data, data is encrypted instead, straight out of the String and into
+ * the one returned. Neither the plaintext nor the ciphertext attributes are
+ * set, so the Cipher holds on to nothing but its key, IV and settings, and
+ * nothing is copied along the way. data can't be modified while it's being
+ * encrypted.
+ *
+ * Plaintexts of at least CryptoPP.gvl_threshold bytes are encrypted without
+ * holding the GVL, so other threads keep running in the meantime. Don't use
+ * the same Cipher from more than one thread at a time.
  */
-VALUE rb_cipher_encrypt(VALUE self)
+VALUE rb_cipher_encrypt(int argc, VALUE *argv, VALUE self)
 {
-  return cipher_encrypt(self, false);
+  VALUE data;
+  rb_scan_args(argc, argv, "01", &data);
+  if (NIL_P(data)) {
+    return cipher_encrypt(self, false);
+  }
+  else {
+    JBase *cipher = NULL;
+    Data_Get_Struct(self, JBase, cipher);
+    return cipher_message(cipher, data, false);
+  }
 }
 
 /**
@@ -1091,28 +1684,46 @@ VALUE rb_cipher_encrypt_hex(VALUE self)
 static VALUE cipher_decrypt(VALUE self, bool hex)
 {
   JBase *cipher = NULL;
+  int state = 0;
   Data_Get_Struct(self, JBase, cipher);
   try {
-    cipher->decrypt();
-    string retval = cipher->getPlaintext(hex);
-    return rb_tainted_str_new(retval.data(), retval.length());
+    state = runWithoutGVL(cipher_decrypt_work, cipher, cipher->getCiphertextLength());
   }
   catch (Exception e) {
     rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
   }
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  return cipher_str_new(cipher->getRawPlaintext(), hex);
 }
 
 /**
  * call-seq:
  *     decrypt => String
+ *     decrypt(data) => String
  *
  * Decrypt the ciphertext using the options set on the Cipher. This method
  * will return the plaintext in binary. The raw plaintext will always be
  * available through the plaintext and plaintext_hex methods afterwards.
+ *
+ * Given data, data is decrypted instead, without setting the plaintext or
+ * ciphertext attributes, the same as encrypt(data).
+ *
+ * Like encrypt, large ciphertexts are decrypted without holding the GVL.
  */
-VALUE rb_cipher_decrypt(VALUE self)
+VALUE rb_cipher_decrypt(int argc, VALUE *argv, VALUE self)
 {
-  return cipher_decrypt(self, false);
+  VALUE data;
+  rb_scan_args(argc, argv, "01", &data);
+  if (NIL_P(data)) {
+    return cipher_decrypt(self, false);
+  }
+  else {
+    JBase *cipher = NULL;
+    Data_Get_Struct(self, JBase, cipher);
+    return cipher_message(cipher, data, true);
+  }
 }
 
 /**
@@ -1128,6 +1739,40 @@ VALUE rb_cipher_decrypt_hex(VALUE self)
   return cipher_decrypt(self, true);
 }
 
+/**
+ * call-seq:
+ *     encrypt!(string) => string
+ *
+ * Encrypts string in place and returns it. Nothing is allocated along the
+ * way, which halves the memory needed for large buffers. The plaintext and
+ * ciphertext attributes are left alone.
+ *
+ * Only works where the ciphertext is always the same length as the
+ * plaintext: stream ciphers, and block ciphers in CFB, CTR, OFB or CBC with
+ * CTS mode without a MAC. Raises for anything else, and for frozen Strings.
+ * If encrypting fails part way, string is left partly encrypted.
+ *
+ * Examples:
+ *
+ *  cipher = CryptoPP::Cipher.new(:aes, :block_mode => :ctr, :key => key, :iv => iv)
+ *  cipher.encrypt!(buffer)
+ */
+VALUE rb_cipher_encrypt_bang(VALUE self, VALUE data)
+{
+  return cipher_in_place(self, data, false);
+}
+
+/**
+ * call-seq:
+ *     decrypt!(string) => string
+ *
+ * Like encrypt!, but decrypts string in place.
+ */
+VALUE rb_cipher_decrypt_bang(VALUE self, VALUE data)
+{
+  return cipher_in_place(self, data, true);
+}
+
 
 /**
  * call-seq:
@@ -1187,38 +1832,958 @@ VALUE rb_cipher_decrypt_io(VALUE self, VALUE in, VALUE out)
 }
 
 
+/* Feeds a chunk through the Cipher's stream, starting one if needed, and
+ * returns whatever output is ready. */
+static VALUE cipher_update(VALUE self, VALUE data, bool decrypting)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  StringValue(data);
+  try {
+    string retval = cipher->update(string(RSTRING_PTR(data), RSTRING_LEN(data)), decrypting);
+    return rb_tainted_str_new(retval.data(), retval.length());
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+}
+
 /**
  * call-seq:
- *    cipher_name(algorithm) => String
+ *    update(data) => String
  *
- * Returns the name of a Cipher.
+ * Encrypts another chunk of data as part of a single message and returns the
+ * ciphertext produced so far. Block ciphers hold back any partial block until
+ * more data arrives or final is called, so the returned String may be
+ * shorter than the input or even empty. The plaintext and ciphertext
+ * attributes are left untouched.
+ *
+ * Calling encrypt or decrypt while a stream is in progress raises an error.
+ * Changing the key, key length or rounds throws the stream away.
+ *
+ * Examples:
+ *
+ *  File.open('test.enc', 'w') do |out|
+ *    File.open('test.txt') do |f|
+ *      while chunk = f.read(65536)
+ *        out.write(cipher.update(chunk))
+ *      end
+ *    end
+ *    out.write(cipher.final)
+ *  end
  */
-VALUE rb_module_cipher_name(VALUE self, VALUE c)
+VALUE rb_cipher_update(VALUE self, VALUE data)
 {
-  switch (cipher_sym_to_const(c)) {
-    default:
-      rb_raise(rb_eCryptoPP_Error, "could not find a valid cipher type");
-    break;
+  return cipher_update(self, data, false);
+}
 
-#    define CIPHER_ALGORITHM_X(klass, r, c, s) \
-      case r ## _CIPHER: \
-        return rb_tainted_str_new2(c::getStaticCipherName().c_str());
-#    include "defs/ciphers.def"
+/**
+ * call-seq:
+ *    decrypt_update(data) => String
+ *
+ * Like update, but decrypts the data.
+ */
+VALUE rb_cipher_decrypt_update(VALUE self, VALUE data)
+{
+  return cipher_update(self, data, true);
+}
+
+/**
+ * call-seq:
+ *    final => String
+ *
+ * Finishes the message started with update or decrypt_update, returning any
+ * remaining output including padding. Returns an empty String if no stream is
+ * in progress.
+ */
+VALUE rb_cipher_final(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  try {
+    string retval = cipher->final();
+    return rb_tainted_str_new(retval.data(), retval.length());
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+}
+
+
+struct JCipherBatch
+{
+  JBase* cipher;
+  vector<string> in;
+  vector<string> keys;
+  vector<string> ivs;
+  vector<string> out;
+  bool decrypting;
+};
+
+/* The part of cipher_batch that may run without the GVL. */
+static void cipher_batch_work(void* data, const volatile bool* interrupted)
+{
+  JCipherBatch* batch = (JCipherBatch*) data;
+  batch->cipher->processBatch(batch->in, batch->keys, batch->ivs, batch->out, batch->decrypting, interrupted);
+}
+
+/* Converts an Array of Strings into a new Array of Strings, raising if
+ * anything isn't one. */
+static VALUE cipher_batch_strings(VALUE ary)
+{
+  VALUE retval = rb_ary_new2(RARRAY_LEN(ary));
+  for (long i = 0; i < RARRAY_LEN(ary); ++i) {
+    VALUE str = rb_ary_entry(ary, i);
+    StringValue(str);
+    rb_ary_push(retval, str);
+  }
+  return retval;
+}
+
+/* Runs a batch through the Cipher. data, keys and ivs are Arrays of Strings
+ * that have already been checked, keys and ivs may be nil. Everything coming
+ * from Ruby is checked up front, before any C++ objects are around. */
+static VALUE cipher_batch_run(VALUE self, VALUE data, VALUE keys, VALUE ivs, bool decrypting)
+{
+  JBase *cipher = NULL;
+  VALUE retval = Qnil;
+  int state = 0;
+
+  Data_Get_Struct(self, JBase, cipher);
+  try {
+    JCipherBatch batch;
+    size_t length = 0;
+
+    batch.cipher = cipher;
+    batch.decrypting = decrypting;
+    batch.in.resize(RARRAY_LEN(data));
+    for (long i = 0; i < RARRAY_LEN(data); ++i) {
+      VALUE str = rb_ary_entry(data, i);
+      batch.in[i].assign(RSTRING_PTR(str), RSTRING_LEN(str));
+      length += RSTRING_LEN(str);
+    }
+
+    if (!NIL_P(keys)) {
+      batch.keys.resize(RARRAY_LEN(keys));
+      for (long i = 0; i < RARRAY_LEN(keys); ++i) {
+        VALUE str = rb_ary_entry(keys, i);
+        batch.keys[i].assign(RSTRING_PTR(str), RSTRING_LEN(str));
+      }
+    }
+
+    if (!NIL_P(ivs)) {
+      batch.ivs.resize(RARRAY_LEN(ivs));
+      for (long i = 0; i < RARRAY_LEN(ivs); ++i) {
+        VALUE str = rb_ary_entry(ivs, i);
+        batch.ivs[i].assign(RSTRING_PTR(str), RSTRING_LEN(str));
+      }
+    }
+
+    state = runWithoutGVL(cipher_batch_work, &batch, length);
+    if (state == 0) {
+      retval = rb_ary_new2(batch.out.size());
+      for (size_t i = 0; i < batch.out.size(); ++i) {
+        rb_ary_push(retval, rb_tainted_str_new(batch.out[i].data(), batch.out[i].length()));
+      }
+    }
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+
+  // only now that batch is gone
+  if (state != 0) {
+    rb_jump_tag(state);
   }
+  return retval;
 }
 
+/* Encrypts or decrypts an Array of Strings in one go. */
+static VALUE cipher_batch(int argc, VALUE *argv, VALUE self, bool decrypting)
+{
+  VALUE data, options, ivs = Qnil;
+
+  rb_scan_args(argc, argv, "11", &data, &options);
+  Check_Type(data, T_ARRAY);
+  data = cipher_batch_strings(data);
+
+  if (!NIL_P(options)) {
+    Check_Type(options, T_HASH);
+    ivs = rb_hash_aref(options, ID2SYM(rb_intern("ivs")));
+  }
+
+  if (!NIL_P(ivs)) {
+    Check_Type(ivs, T_ARRAY);
+    if (RARRAY_LEN(ivs) != RARRAY_LEN(data)) {
+      rb_raise(rb_eCryptoPP_Error, "the number of IVs doesn't match the number of entries");
+    }
+    ivs = cipher_batch_strings(ivs);
+  }
+
+  return cipher_batch_run(self, data, Qnil, ivs, decrypting);
+}
 
 /**
  * call-seq:
- *    algorithm_name() => String
+ *    encrypt_batch(plaintexts, options = {}) => Array
  *
- * Returns the name of the cipher algorithm being used.
+ * Encrypts each String in the plaintexts Array as a separate message under
+ * the Cipher's key, mode and padding, and returns an Array of ciphertexts in
+ * the same order. The key schedule is only set up once and the whole batch is
+ * handled in a single call into the extension, which makes this a good deal
+ * faster than calling encrypt in a loop for lots of small messages.
+ *
+ * Options:
+ *
+ * * <tt>:ivs</tt> - an Array with an IV for each message. Without it every
+ *   message uses the Cipher's IV.
+ *
+ * The plaintext, ciphertext and IV attributes are left untouched. Like
+ * encrypt, large batches are processed without holding the GVL, and block
+ * ciphers with threads set spread the messages over that many threads.
+ *
+ * Examples:
+ *
+ *  ivs = messages.collect { SecureRandom.random_bytes(16) }
+ *  ciphertexts = cipher.encrypt_batch(messages, :ivs => ivs)
  */
-VALUE rb_cipher_algorithm_name(VALUE self)
+VALUE rb_cipher_encrypt_batch(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_batch(argc, argv, self, false);
+}
+
+/**
+ * call-seq:
+ *    decrypt_batch(ciphertexts, options = {}) => Array
+ *
+ * Like encrypt_batch, but decrypts each message.
+ */
+VALUE rb_cipher_decrypt_batch(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_batch(argc, argv, self, true);
+}
+
+
+struct JCipherSectors
+{
+  JCipher* cipher;
+  string in;
+  string out;
+  word64 firstSector;
+  size_t sectorSize;
+  bool decrypting;
+};
+
+/* The part of cipher_sectors that may run without the GVL. */
+static void cipher_sectors_work(void* data, const volatile bool* interrupted)
+{
+  JCipherSectors* sectors = (JCipherSectors*) data;
+  sectors->cipher->processSectors(sectors->in, sectors->out, sectors->firstSector, sectors->sectorSize, sectors->decrypting, interrupted);
+}
+
+/* Encrypts or decrypts a buffer of whole sectors in XTS mode. */
+static VALUE cipher_sectors(VALUE self, VALUE buffer, VALUE first_sector, VALUE sector_size, bool decrypting)
 {
   JBase *cipher = NULL;
+  StringValue(buffer);
+  word64 first = NUM2ULL(first_sector);
+  size_t size = NUM2SIZET(sector_size);
+
   Data_Get_Struct(self, JBase, cipher);
-  return rb_tainted_str_new2(cipher->getCipherName().c_str());
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can't process sectors with stream ciphers");
+  }
+
+  VALUE retval = Qnil;
+  int state = 0;
+
+  try {
+    JCipherSectors sectors;
+    sectors.cipher = (JCipher*) cipher;
+    sectors.in.assign(RSTRING_PTR(buffer), RSTRING_LEN(buffer));
+    sectors.firstSector = first;
+    sectors.sectorSize = size;
+    sectors.decrypting = decrypting;
+
+    state = runWithoutGVL(cipher_sectors_work, &sectors, sectors.in.length());
+    if (state == 0) {
+      retval = rb_tainted_str_new(sectors.out.data(), sectors.out.length());
+    }
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  return retval;
+}
+
+/**
+ * call-seq:
+ *    encrypt_sectors(buffer, first_sector, sector_size) => String
+ *
+ * Encrypts buffer as consecutive sectors of sector_size bytes in XTS mode
+ * and returns the ciphertext, which is the same length. The first sector is
+ * sector number first_sector, the ones after it follow on from there, and
+ * each sector's number is its tweak. buffer must be a whole number of
+ * sectors and sectors must be at least 16 bytes long; sizes that aren't a
+ * multiple of 16 are handled with ciphertext stealing.
+ *
+ * The key is the data key followed by the tweak key, so AES-128 in XTS mode
+ * takes a 32 byte key, and the two halves can't be the same. With threads set, large buffers are split up by
+ * sector over that many threads. The plaintext, ciphertext and IV
+ * attributes are left untouched.
+ *
+ * Examples:
+ *
+ *  cipher = CryptoPP::Cipher.new(:aes, :block_mode => :xts, :key => key, :threads => 4)
+ *  pages = cipher.encrypt_sectors(data, 2048, 4096)
+ */
+VALUE rb_cipher_encrypt_sectors(VALUE self, VALUE buffer, VALUE first_sector, VALUE sector_size)
+{
+  return cipher_sectors(self, buffer, first_sector, sector_size, false);
+}
+
+/**
+ * call-seq:
+ *    decrypt_sectors(buffer, first_sector, sector_size) => String
+ *
+ * Like encrypt_sectors, but decrypts.
+ */
+VALUE rb_cipher_decrypt_sectors(VALUE self, VALUE buffer, VALUE first_sector, VALUE sector_size)
+{
+  return cipher_sectors(self, buffer, first_sector, sector_size, true);
+}
+
+
+struct JCipherRange
+{
+  JCipher* cipher;
+  string in;
+  string out;
+  lword offset;
+};
+
+/* The part of rb_cipher_decrypt_range that may run without the GVL. */
+static void cipher_range_work(void* data, const volatile bool* interrupted)
+{
+  JCipherRange* range = (JCipherRange*) data;
+  range->cipher->decryptRange(range->in, range->out, range->offset, interrupted);
+}
+
+/**
+ * call-seq:
+ *    decrypt_range(source, offset, length) => String
+ *
+ * Decrypts length bytes of a CTR mode ciphertext starting at byte offset and
+ * returns the plaintext. The counter is worked out from the offset, so
+ * nothing before the range is decrypted, which makes this handy for serving
+ * ranges out of large encrypted files.
+ *
+ * source is either the whole ciphertext as a String or an IO that responds
+ * to <tt>seek</tt> and <tt>read</tt>, in which case only the range itself is
+ * read. Like String#byteslice, ranges running off the end are cut short.
+ * The plaintext and ciphertext attributes are left untouched.
+ *
+ * Examples:
+ *
+ *  File.open('video.enc', 'rb') do |f|
+ *    part = cipher.decrypt_range(f, 1048576, 65536)
+ *  end
+ */
+VALUE rb_cipher_decrypt_range(VALUE self, VALUE source, VALUE offset, VALUE length)
+{
+  JBase *cipher = NULL;
+  lword start = NUM2ULL(offset);
+  size_t count = NUM2SIZET(length);
+  const char* from = NULL;
+  VALUE data;
+
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can't decrypt ranges with stream ciphers");
+  }
+
+  if (TYPE(source) == T_STRING) {
+    data = source;
+    if (start >= (lword) RSTRING_LEN(data)) {
+      count = 0;
+    }
+    else {
+      count = (size_t) STDMIN((lword) count, (lword) RSTRING_LEN(data) - start);
+      from = RSTRING_PTR(data) + start;
+    }
+  }
+  else {
+    rb_funcall(source, rb_intern("seek"), 1, ULL2NUM(start));
+    data = rb_funcall(source, rb_intern("read"), 1, SIZET2NUM(count));
+    if (NIL_P(data)) {
+      count = 0;
+    }
+    else {
+      StringValue(data);
+      count = STDMIN(count, (size_t) RSTRING_LEN(data));
+      from = RSTRING_PTR(data);
+    }
+  }
+
+  VALUE retval = Qnil;
+  int state = 0;
+
+  try {
+    JCipherRange range;
+    range.cipher = (JCipher*) cipher;
+    range.in.assign(from == NULL ? "" : from, count);
+    range.offset = start;
+
+    state = runWithoutGVL(cipher_range_work, &range, range.in.length());
+    if (state == 0) {
+      retval = rb_tainted_str_new(range.out.data(), range.out.length());
+    }
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  return retval;
+}
+
+
+/**
+ * call-seq:
+ *    seek(position) => Integer
+ *
+ * Moves a stream cipher to position bytes into its keystream, so encrypt,
+ * decrypt and the streaming methods start from there rather than from the
+ * start. Only ciphers whose keystream can be jumped around in, such as SEAL,
+ * can seek anywhere but 0; the others raise a CryptoPPError. Block ciphers
+ * raise too, see decrypt_range instead.
+ */
+VALUE rb_cipher_seek(VALUE self, VALUE p)
+{
+  JBase *cipher = NULL;
+  lword position = NUM2ULL(p);
+
+  Data_Get_Struct(self, JBase, cipher);
+  if (!IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can only seek on stream ciphers");
+  }
+
+  try {
+    ((JStream*) cipher)->seek(position);
+    return ULL2NUM(position);
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+}
+
+
+/**
+ * call-seq:
+ *    position => Integer
+ *
+ * Get the keystream position set with seek. Returns <tt>nil</tt> if you try
+ * to use this on a block cipher.
+ */
+VALUE rb_cipher_position(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  if (!IS_STREAM_CIPHER(cipher->getCipherType())) {
+    return Qnil;
+  }
+  else {
+    return ULL2NUM(((JStream*) cipher)->getPosition());
+  }
+}
+
+
+struct JCipherProcessAt
+{
+  JStream* cipher;
+  string in;
+  string out;
+  lword position;
+};
+
+/* The part of rb_cipher_process_at that may run without the GVL. */
+static void cipher_process_at_work(void* data, const volatile bool* interrupted)
+{
+  JCipherProcessAt* job = (JCipherProcessAt*) data;
+  job->out = job->cipher->processAt(job->position, job->in, interrupted);
+}
+
+/**
+ * call-seq:
+ *    process_at(position, data) => String
+ *
+ * Encrypts or decrypts data, which are the same thing for stream ciphers, as
+ * if it were found position bytes into a message. Only the keystream for
+ * data itself is generated, so this is the way to get at a slice of a large
+ * SEAL ciphertext. The position set with seek and the plaintext and
+ * ciphertext attributes are left untouched. Stream ciphers that can't seek
+ * raise a CryptoPPError for any position other than 0.
+ *
+ * Examples:
+ *
+ *  cipher = CryptoPP.cipher_factory(:seal_be, :key => key, :iv => iv)
+ *  slice = cipher.process_at(10 * 1024 * 1024, archive.byteslice(10 * 1024 * 1024, 4096))
+ */
+VALUE rb_cipher_process_at(VALUE self, VALUE p, VALUE data)
+{
+  JBase *cipher = NULL;
+  lword position = NUM2ULL(p);
+
+  StringValue(data);
+  Data_Get_Struct(self, JBase, cipher);
+  if (!IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can only process at a position with stream ciphers");
+  }
+
+  VALUE retval = Qnil;
+  int state = 0;
+
+  try {
+    JCipherProcessAt job;
+    job.cipher = (JStream*) cipher;
+    job.in.assign(RSTRING_PTR(data), RSTRING_LEN(data));
+    job.position = position;
+
+    state = runWithoutGVL(cipher_process_at_work, &job, job.in.length());
+    if (state == 0) {
+      retval = rb_tainted_str_new(job.out.data(), job.out.length());
+    }
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  return retval;
+}
+
+
+struct JCipherKeystream
+{
+  JBase* cipher;
+  size_t length;
+  bool background;
+};
+
+/* The part of rb_cipher_precompute_keystream that may run without the
+ * GVL. */
+static void cipher_keystream_work(void* data, const volatile bool* interrupted)
+{
+  JCipherKeystream* job = (JCipherKeystream*) data;
+  job->cipher->precomputeKeystream(job->length, job->background, interrupted);
+}
+
+/**
+ * call-seq:
+ *    precompute_keystream(bytes, background = false) => Integer
+ *
+ * Generates bytes bytes of keystream ahead of time for the current key and
+ * IV, so that encrypting or decrypting a message of up to that many bytes
+ * later on is just an XOR. With background set, the keystream is generated
+ * on a native thread and this returns right away; encrypt and decrypt wait
+ * for it if it isn't done yet.
+ *
+ * Only stream ciphers and block ciphers in :ctr or :ofb mode have a
+ * keystream. It is thrown away when the key, IV, block mode or position
+ * changes. Every message gets the same keystream, just as encrypt always
+ * starts at the IV, so set a new IV and precompute again between
+ * messages.
+ *
+ * Examples:
+ *
+ *  cipher.iv = next_iv
+ *  cipher.precompute_keystream(4096, true)
+ *  # ... once the message arrives
+ *  cipher.plaintext = message
+ *  cipher.encrypt
+ */
+VALUE rb_cipher_precompute_keystream(int argc, VALUE *argv, VALUE self)
+{
+  JBase *cipher = NULL;
+  VALUE bytes, background;
+
+  rb_scan_args(argc, argv, "11", &bytes, &background);
+  Data_Get_Struct(self, JBase, cipher);
+
+  int state = 0;
+
+  try {
+    JCipherKeystream job;
+    job.cipher = cipher;
+    job.length = NUM2SIZET(bytes);
+    job.background = RTEST(background);
+
+    // starting a background thread doesn't need the GVL let go of
+    state = runWithoutGVL(cipher_keystream_work, &job, job.background ? 0 : job.length);
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  return bytes;
+}
+
+
+/* Splits up the [ key, iv, data ] entries for encrypt_many and decrypt_many
+ * and runs them through a new Cipher. */
+static VALUE module_many(int argc, VALUE *argv, VALUE self, bool decrypting)
+{
+  VALUE algorithm, entries, options, cipher, keys, ivs, data;
+
+  rb_scan_args(argc, argv, "21", &algorithm, &entries, &options);
+  Check_Type(entries, T_ARRAY);
+
+  keys = rb_ary_new2(RARRAY_LEN(entries));
+  ivs = rb_ary_new2(RARRAY_LEN(entries));
+  data = rb_ary_new2(RARRAY_LEN(entries));
+
+  for (long i = 0; i < RARRAY_LEN(entries); ++i) {
+    VALUE entry = rb_ary_entry(entries, i);
+    Check_Type(entry, T_ARRAY);
+    if (RARRAY_LEN(entry) != 3) {
+      rb_raise(rb_eCryptoPP_Error, "entries must be [ key, iv, data ] Arrays");
+    }
+    VALUE iv = rb_ary_entry(entry, 1);
+    rb_ary_push(keys, rb_ary_entry(entry, 0));
+    rb_ary_push(ivs, NIL_P(iv) ? rb_str_new2("") : iv);
+    rb_ary_push(data, rb_ary_entry(entry, 2));
+  }
+
+  keys = cipher_batch_strings(keys);
+  ivs = cipher_batch_strings(ivs);
+  data = cipher_batch_strings(data);
+
+  VALUE args[2] = { algorithm, options };
+  cipher = rb_module_cipher_factory(NIL_P(options) ? 1 : 2, args, self);
+
+  // gives the cached cipher objects a valid key to be copied from
+  if (RARRAY_LEN(keys) > 0) {
+    rb_cipher_key_eq(cipher, rb_ary_entry(keys, 0));
+  }
+
+  return cipher_batch_run(cipher, data, keys, ivs, decrypting);
+}
+
+/**
+ * call-seq:
+ *    encrypt_many(algorithm, entries, options = {}) => Array
+ *
+ * Encrypts a batch of messages that each have their own key. entries is an
+ * Array of <tt>[ key, iv, plaintext ]</tt> Arrays, where the IV may be nil
+ * for modes that don't use one. options are the same as for cipher_factory
+ * and apply to every entry. Returns an Array of ciphertexts in the same
+ * order.
+ *
+ * All of the work happens in a single call into the extension, outside of
+ * the GVL for large batches. Block ciphers expand each key into a copy of
+ * one cipher object, and with <tt>:threads</tt> set large batches are spread
+ * over that many native threads. Within a thread the entries are simply
+ * rekeyed and processed one after the other, so what's saved over calling
+ * CryptoPP.encrypt in a loop is the per-call overhead and the cipher
+ * objects, not any of the key expansion itself.
+ *
+ * Examples:
+ *
+ *  rows = tenants.collect { |t| [ t.key, t.iv, t.data ] }
+ *  ciphertexts = CryptoPP.encrypt_many(:aes, rows, :block_mode => :ctr)
+ */
+VALUE rb_module_encrypt_many(int argc, VALUE *argv, VALUE self)
+{
+  return module_many(argc, argv, self, false);
+}
+
+/**
+ * call-seq:
+ *    decrypt_many(algorithm, entries, options = {}) => Array
+ *
+ * Like encrypt_many, but decrypts each entry.
+ */
+VALUE rb_module_decrypt_many(int argc, VALUE *argv, VALUE self)
+{
+  return module_many(argc, argv, self, true);
+}
+
+
+/* Creates a cipher set up the way key describes. May throw a JException,
+ * in which case nothing is leaked. */
+static JBase* module_cipher_new(VALUE algorithm, const JCipherCacheKey& key)
+{
+  member_ptr<JBase> retval(cipher_factory(algorithm));
+
+  if (IS_STREAM_CIPHER(retval->getCipherType())) {
+    if (key.mode != UNKNOWN_MODE || key.padding != UNKNOWN_PADDING || key.rounds != 0) {
+      throw JException("stream ciphers don't take a block_mode, padding or rounds");
+    }
+  }
+  else {
+    JCipher* cipher = (JCipher*) retval.get();
+
+    if (key.mode != UNKNOWN_MODE) {
+      cipher->setMode(key.mode);
+    }
+    if (key.padding != UNKNOWN_PADDING && cipher->setPadding(key.padding) != key.padding) {
+      throw JException("Padding '" + JCipher::getPaddingName(key.padding) + "' cannot be used with mode '" + cipher->getModeName() + "'");
+    }
+    if (key.rounds != 0 && cipher->setRounds(key.rounds) != key.rounds) {
+      throw JException("invalid number of rounds");
+    }
+  }
+
+  retval->setKey(string((const char*) key.key.data(), key.key.size()));
+
+  return retval.release();
+}
+
+// key is on the heap and freed by module_message_checkin, since
+// cipher_message raises straight out of module_message_run.
+struct JModuleMessage
+{
+  JCipherCacheKey* key;
+  JBase* cipher;
+  VALUE data;
+  bool decrypting;
+  VALUE retval;
+};
+
+static VALUE module_message_run(VALUE data)
+{
+  JModuleMessage* message = (JModuleMessage*) data;
+  message->retval = cipher_message(message->cipher, message->data, message->decrypting);
+  return Qnil;
+}
+
+/* Hands the cipher back to the cache, even if the job raised. */
+static VALUE module_message_checkin(VALUE data)
+{
+  JModuleMessage* message = (JModuleMessage*) data;
+  getCipherCache().checkin(*message->key, message->cipher);
+  delete message->key;
+  return Qnil;
+}
+
+/* The guts of CryptoPP.encrypt and CryptoPP.decrypt. The option names are
+ * interned once rather than on every call. */
+static VALUE module_message(int argc, VALUE *argv, VALUE self, bool decrypting)
+{
+  static const ID id_block_mode = rb_intern("block_mode");
+  static const ID id_padding = rb_intern("padding");
+  static const ID id_rounds = rb_intern("rounds");
+  static const ID id_aad = rb_intern("aad");
+  static const ID id_tag_length = rb_intern("tag_length");
+
+  VALUE algorithm, key, iv, data, options;
+  VALUE mode = Qnil, padding = Qnil, rounds = Qnil, aad = Qnil, tag_length = Qnil;
+
+  rb_scan_args(argc, argv, "41", &algorithm, &key, &iv, &data, &options);
+  StringValue(key);
+  StringValue(data);
+  if (!NIL_P(iv)) {
+    StringValue(iv);
+  }
+  if (!NIL_P(options)) {
+    Check_Type(options, T_HASH);
+    mode = rb_hash_aref(options, ID2SYM(id_block_mode));
+    padding = rb_hash_aref(options, ID2SYM(id_padding));
+    rounds = rb_hash_aref(options, ID2SYM(id_rounds));
+    aad = rb_hash_aref(options, ID2SYM(id_aad));
+    tag_length = rb_hash_aref(options, ID2SYM(id_tag_length));
+  }
+
+  enum CipherEnum algorithmEnum = cipher_sym_to_const(algorithm);
+  enum ModeEnum modeEnum = NIL_P(mode) ? UNKNOWN_MODE : mode_sym_to_const(mode);
+  enum PaddingEnum paddingEnum = NIL_P(padding) ? UNKNOWN_PADDING : padding_sym_to_const(padding);
+  unsigned int roundsValue = NIL_P(rounds) ? 0 : NUM2UINT(rounds);
+
+  if (!NIL_P(mode) && !VALID_MODE(modeEnum)) {
+    rb_raise(rb_eCryptoPP_Error, "invalid cipher mode");
+  }
+  if (!NIL_P(padding) && !VALID_PADDING(paddingEnum)) {
+    rb_raise(rb_eCryptoPP_Error, "invalid cipher padding");
+  }
+  if (!NIL_P(aad)) {
+    StringValue(aad);
+  }
+
+  // anything that might raise is done before the key is copied and a cipher
+  // is checked out
+  unsigned int tagLength = NIL_P(tag_length) ? MAX_TAG_LENGTH : NUM2UINT(tag_length);
+
+  JModuleMessage message;
+  message.key = NULL;
+  message.cipher = NULL;
+  message.data = data;
+  message.decrypting = decrypting;
+  message.retval = Qnil;
+
+  try {
+    message.key = new JCipherCacheKey;
+    message.key->algorithm = algorithmEnum;
+    message.key->mode = modeEnum;
+    message.key->padding = paddingEnum;
+    message.key->rounds = roundsValue;
+    message.key->key.Assign((const byte*) RSTRING_PTR(key), RSTRING_LEN(key));
+    message.cipher = getCipherCache().checkout(*message.key);
+
+    if (message.cipher == NULL) {
+      message.cipher = module_cipher_new(algorithm, *message.key);
+    }
+
+    // the rest is cheap enough to simply set on every call
+    message.cipher->setIV(NIL_P(iv) ? string() : string(RSTRING_PTR(iv), RSTRING_LEN(iv)));
+    message.cipher->setAAD(NIL_P(aad) ? string() : string(RSTRING_PTR(aad), RSTRING_LEN(aad)));
+    message.cipher->setTagLength(tagLength);
+  }
+  catch (Exception& e) {
+    // a bad IV or tag length doesn't make the keyed cipher any less reusable
+    if (message.cipher != NULL) {
+      getCipherCache().checkin(*message.key, message.cipher);
+    }
+    delete message.key;
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+
+  rb_ensure(RUBY_METHOD_FUNC(module_message_run), (VALUE) &message, RUBY_METHOD_FUNC(module_message_checkin), (VALUE) &message);
+
+  return message.retval;
+}
+
+/**
+ * call-seq:
+ *    encrypt(algorithm, key, iv, data, options = {}) => String
+ *
+ * Encrypts data in one go, without creating a Cipher. The IV may be nil for
+ * modes that don't use one. The options are <tt>:block_mode</tt>,
+ * <tt>:padding</tt>, <tt>:rounds</tt>, <tt>:aad</tt> and
+ * <tt>:tag_length</tt>, which mean the same as they do for cipher_factory.
+ *
+ * Keyed ciphers are kept in a least recently used cache of
+ * cipher_cache_size entries, looked up by algorithm, block mode, padding,
+ * rounds and the key itself, so a key that's used over and over only has
+ * its key schedule expanded once. The cache is safe to use from any number
+ * of threads.
+ *
+ * Examples:
+ *
+ *  ciphertext = CryptoPP.encrypt(:aes, key, iv, data, :block_mode => :ctr)
+ */
+VALUE rb_module_encrypt(int argc, VALUE *argv, VALUE self)
+{
+  return module_message(argc, argv, self, false);
+}
+
+/**
+ * call-seq:
+ *    decrypt(algorithm, key, iv, data, options = {}) => String
+ *
+ * Like encrypt, but decrypts.
+ */
+VALUE rb_module_decrypt(int argc, VALUE *argv, VALUE self)
+{
+  return module_message(argc, argv, self, true);
+}
+
+/**
+ * call-seq:
+ *    cipher_cache_size => Integer
+ *
+ * Returns the number of keyed ciphers CryptoPP.encrypt and CryptoPP.decrypt
+ * hold on to. The default is 64.
+ */
+VALUE rb_module_cipher_cache_size(VALUE self)
+{
+  return SIZET2NUM(getCipherCache().getCapacity());
+}
+
+/**
+ * call-seq:
+ *    cipher_cache_size = Integer
+ *
+ * Sets the number of keyed ciphers CryptoPP.encrypt and CryptoPP.decrypt
+ * hold on to. The least recently used ones are thrown away beyond that, and
+ * 0 turns the cache off.
+ */
+VALUE rb_module_cipher_cache_size_eq(VALUE self, VALUE size)
+{
+  getCipherCache().setCapacity(NUM2SIZET(size));
+  return size;
+}
+
+
+/**
+ * call-seq:
+ *    cipher_name(algorithm) => String
+ *
+ * Returns the name of a Cipher.
+ */
+VALUE rb_module_cipher_name(VALUE self, VALUE c)
+{
+  switch (cipher_sym_to_const(c)) {
+    default:
+      rb_raise(rb_eCryptoPP_Error, "could not find a valid cipher type");
+    break;
+
+#    define CIPHER_ALGORITHM_X(klass, r, c, s) \
+      case r ## _CIPHER: \
+        return rb_tainted_str_new2(c::getStaticCipherName().c_str());
+#    include "defs/ciphers.def"
+  }
+}
+
+
+/**
+ * call-seq:
+ *    algorithm_name() => String
+ *
+ * Returns the name of the cipher algorithm being used.
+ */
+VALUE rb_cipher_algorithm_name(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  return rb_tainted_str_new2(cipher->getCipherName().c_str());
+}
+
+
+/**
+ * call-seq:
+ *    implementation_name() => String
+ *
+ * Returns the name of the code path Crypto++ uses for the cipher on this
+ * CPU, like "AESNI", "SSSE3" or "C++". Crypto++ versions before 6.0 don't
+ * report this and return "unknown". See also CryptoPP.cpu_features.
+ *
+ * Ciphers that this extension runs through its own multi-block kernels
+ * report those instead, like "AVX2 8-way" or "SSE2 4-way". RC6, Twofish,
+ * Camellia and CAST-256 only have them in builds configured with
+ * --enable-native on a CPU with AVX2.
+ */
+VALUE rb_cipher_implementation_name(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  try {
+    string retval = cipher->getImplementationName();
+    return rb_tainted_str_new2(retval.c_str());
+  }
+  catch (Exception e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
 }
 
 
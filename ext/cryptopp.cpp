@@ -116,6 +116,11 @@ extern "C" void Init_cryptopp()
    *   at a time.
    * * <tt>:key_length</tt> - set the length of the key. Normally this is done
    *   automatically, but you can force a different key length if necessary.
+   * * <tt>:block_mode</tt> - the block mode, such as :cbc or :ctr. In :xts
+   *   mode the key is a data key followed by a tweak key of the same length,
+   *   so AES-128 takes a 32 byte key, and encrypt and decrypt treat the
+   *   whole message as one data unit with the IV as its tweak. See
+   *   <tt>Cipher#encrypt_sectors</tt> for encrypting storage.
    * * <tt>:effective_key_length</tt> - sets the effective key length on RC2
    *   ciphers.
    * * <tt>:rounds</tt> - sets the number of rounds a cipher performs on
@@ -125,6 +130,27 @@ extern "C" void Init_cryptopp()
    *   systems and environments will support all RNGs. You can check which
    *   ones are supported with <tt>CryptoPP#rng_available?</tt>. Possible
    *   values are :blocking, :non_blocking and :rand.
+   * * <tt>:threads</tt> - the number of native threads block ciphers may use
+   *   on large buffers in modes that allow it.
+   * * <tt>:parallel</tt> - when true and <tt>:threads</tt> isn't given, use
+   *   one thread per processor.
+   * * <tt>:aad</tt> and <tt>:aad_hex</tt> - set the additional authenticated
+   *   data for the authenticated block modes, :gcm, :eax and :ocb, and the
+   *   :chacha20_poly1305 and :xchacha20_poly1305 ciphers. You can only use
+   *   one at a time. :ocb doesn't need carry-less multiplication and
+   *   encrypts with one block cipher call per block, so it is the quickest
+   *   of the three modes on CPUs without PCLMULQDQ. Without AES-NI at all,
+   *   :chacha20_poly1305 is quicker still.
+   * * <tt>:tag_length</tt> - the length in bytes of the authentication tag
+   *   appended to the ciphertext in authenticated block modes and ciphers.
+   *   The default is 16.
+   * * <tt>:gcm_tables</tt> - the size of the GHASH tables used in :gcm mode,
+   *   either :gcm_2k or :gcm_64k.
+   * * <tt>:mac</tt> - an HMAC digest such as :sha256_hmac to use for
+   *   encrypt-then-MAC. The tag is appended to the ciphertext and checked
+   *   before decrypting.
+   * * <tt>:mac_key</tt> and <tt>:mac_key_hex</tt> - set the key for
+   *   <tt>:mac</tt>. You can only use one at a time.
    *
    * All of these options have their equivalent setter and getter methods
    * if you need to modify them after initialization.
@@ -182,6 +208,12 @@ extern "C" void Init_cryptopp()
   rb_define_module_function(rb_mCryptoPP, "rng_available?",   RUBY_METHOD_FUNC(rb_module_rng_available),   1); /* in ciphers.cpp */
 
   rb_define_module_function(rb_mCryptoPP, "cipher_factory",   RUBY_METHOD_FUNC(rb_module_cipher_factory),        -1); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP, "encrypt_many",     RUBY_METHOD_FUNC(rb_module_encrypt_many),          -1); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP, "decrypt_many",     RUBY_METHOD_FUNC(rb_module_decrypt_many),          -1); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP, "encrypt",          RUBY_METHOD_FUNC(rb_module_encrypt),               -1); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP, "decrypt",          RUBY_METHOD_FUNC(rb_module_decrypt),               -1); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP, "cipher_cache_size",  RUBY_METHOD_FUNC(rb_module_cipher_cache_size),  0); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP, "cipher_cache_size=", RUBY_METHOD_FUNC(rb_module_cipher_cache_size_eq), 1); /* in ciphers.cpp */
   rb_define_module_function(rb_mCryptoPP, "digest_factory",   RUBY_METHOD_FUNC(rb_module_digest_factory),        -1); /* in digests.cpp */
   rb_define_module_function(rb_mCryptoPP, "hmac_factory",     RUBY_METHOD_FUNC(rb_module_hmac_factory),   -1); /* in digests.cpp */
 
@@ -205,11 +237,31 @@ extern "C" void Init_cryptopp()
   rb_define_module_function(rb_mCryptoPP, "digest_hmac_hex", RUBY_METHOD_FUNC(rb_module_hmac_digest_hex),    -1);  /* in digests.cpp */
   rb_define_module_function(rb_mCryptoPP, "hmac_list",       RUBY_METHOD_FUNC(rb_module_hmac_list),           0);  /* in digests.cpp */
 
+  rb_define_module_function(rb_mCryptoPP, "gvl_threshold",   RUBY_METHOD_FUNC(rb_module_gvl_threshold),       0);  /* in utils.cpp */
+  rb_define_module_function(rb_mCryptoPP, "gvl_threshold=",  RUBY_METHOD_FUNC(rb_module_gvl_threshold_eq),    1);  /* in utils.cpp */
+  rb_define_module_function(rb_mCryptoPP, "cpu_features",    RUBY_METHOD_FUNC(rb_module_cpu_features),        0);  /* in utils.cpp */
+
   rb_define_method(rb_cCryptoPP_Cipher, "rand_iv",            RUBY_METHOD_FUNC(rb_cipher_rand_iv),            1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "iv=",                RUBY_METHOD_FUNC(rb_cipher_iv_eq),              1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "iv_hex=",            RUBY_METHOD_FUNC(rb_cipher_iv_hex_eq),          1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "iv",                 RUBY_METHOD_FUNC(rb_cipher_iv),                 0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "iv_hex",             RUBY_METHOD_FUNC(rb_cipher_iv_hex),             0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "aad=",               RUBY_METHOD_FUNC(rb_cipher_aad_eq),             1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "aad_hex=",           RUBY_METHOD_FUNC(rb_cipher_aad_hex_eq),         1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "aad",                RUBY_METHOD_FUNC(rb_cipher_aad),                0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "aad_hex",            RUBY_METHOD_FUNC(rb_cipher_aad_hex),            0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "tag",                RUBY_METHOD_FUNC(rb_cipher_tag),                0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "tag_hex",            RUBY_METHOD_FUNC(rb_cipher_tag_hex),            0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "tag_length=",        RUBY_METHOD_FUNC(rb_cipher_tag_length_eq),      1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "tag_length",         RUBY_METHOD_FUNC(rb_cipher_tag_length),         0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "gcm_tables=",        RUBY_METHOD_FUNC(rb_cipher_gcm_tables_eq),      1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "gcm_tables",         RUBY_METHOD_FUNC(rb_cipher_gcm_tables),         0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "mac=",               RUBY_METHOD_FUNC(rb_cipher_mac_eq),             1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "mac",                RUBY_METHOD_FUNC(rb_cipher_mac),                0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "mac_key=",           RUBY_METHOD_FUNC(rb_cipher_mac_key_eq),         1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "mac_key_hex=",       RUBY_METHOD_FUNC(rb_cipher_mac_key_hex_eq),     1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "mac_key",            RUBY_METHOD_FUNC(rb_cipher_mac_key),            0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "mac_key_hex",        RUBY_METHOD_FUNC(rb_cipher_mac_key_hex),        0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "block_mode=",        RUBY_METHOD_FUNC(rb_cipher_block_mode_eq),      1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "block_mode",         RUBY_METHOD_FUNC(rb_cipher_block_mode),         0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "padding=",           RUBY_METHOD_FUNC(rb_cipher_padding_eq),         1); /* in ciphers.cpp */
@@ -242,17 +294,34 @@ extern "C" void Init_cryptopp()
   rb_define_method(rb_cCryptoPP_Cipher, "block_size",          RUBY_METHOD_FUNC(rb_cipher_block_size),      1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "rounds=",             RUBY_METHOD_FUNC(rb_cipher_rounds_eq),       1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "rounds",              RUBY_METHOD_FUNC(rb_cipher_rounds),          0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "threads=",            RUBY_METHOD_FUNC(rb_cipher_threads_eq),      1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "threads",             RUBY_METHOD_FUNC(rb_cipher_threads),         0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "algorithm_name",      RUBY_METHOD_FUNC(rb_cipher_algorithm_name),  0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "implementation_name", RUBY_METHOD_FUNC(rb_cipher_implementation_name), 0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "block_mode_name",     RUBY_METHOD_FUNC(rb_cipher_block_mode_name), 0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "padding_name",        RUBY_METHOD_FUNC(rb_cipher_padding_name),    0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "rng_name",            RUBY_METHOD_FUNC(rb_cipher_rng_name),        0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "cipher_type",         RUBY_METHOD_FUNC(rb_cipher_cipher_type),     0); /* in ciphers.cpp */
-  rb_define_method(rb_cCryptoPP_Cipher, "encrypt",             RUBY_METHOD_FUNC(rb_cipher_encrypt),         0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt",             RUBY_METHOD_FUNC(rb_cipher_encrypt),        -1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "encrypt_hex",         RUBY_METHOD_FUNC(rb_cipher_encrypt_hex),     0); /* in ciphers.cpp */
-  rb_define_method(rb_cCryptoPP_Cipher, "decrypt",             RUBY_METHOD_FUNC(rb_cipher_decrypt),         0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt",             RUBY_METHOD_FUNC(rb_cipher_decrypt),        -1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "decrypt_hex",         RUBY_METHOD_FUNC(rb_cipher_decrypt_hex),     0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt!",            RUBY_METHOD_FUNC(rb_cipher_encrypt_bang),    1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt!",            RUBY_METHOD_FUNC(rb_cipher_decrypt_bang),    1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "encrypt_io",          RUBY_METHOD_FUNC(rb_cipher_encrypt_io),      2); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "decrypt_io",          RUBY_METHOD_FUNC(rb_cipher_decrypt_io),      2); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "update",              RUBY_METHOD_FUNC(rb_cipher_update),          1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_update",      RUBY_METHOD_FUNC(rb_cipher_decrypt_update),  1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "final",               RUBY_METHOD_FUNC(rb_cipher_final),           0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_batch",       RUBY_METHOD_FUNC(rb_cipher_encrypt_batch),  -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_batch",       RUBY_METHOD_FUNC(rb_cipher_decrypt_batch),  -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_sectors",     RUBY_METHOD_FUNC(rb_cipher_encrypt_sectors), 3); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_sectors",     RUBY_METHOD_FUNC(rb_cipher_decrypt_sectors), 3); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_range",       RUBY_METHOD_FUNC(rb_cipher_decrypt_range),   3); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "seek",                RUBY_METHOD_FUNC(rb_cipher_seek),            1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "position",            RUBY_METHOD_FUNC(rb_cipher_position),        0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "process_at",          RUBY_METHOD_FUNC(rb_cipher_process_at),      2); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "precompute_keystream", RUBY_METHOD_FUNC(rb_cipher_precompute_keystream), -1); /* in ciphers.cpp */
 
   rb_define_method(rb_cCryptoPP_Digest, "digest",              RUBY_METHOD_FUNC(rb_digest_digest),             0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "digest_hex",          RUBY_METHOD_FUNC(rb_digest_digest_hex),         0); /* in digests.cpp */
@@ -271,6 +340,7 @@ extern "C" void Init_cryptopp()
   rb_define_method(rb_cCryptoPP_Digest, "inspect",             RUBY_METHOD_FUNC(rb_digest_inspect),            0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "==",                  RUBY_METHOD_FUNC(rb_digest_equals),             1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "algorithm_name",      RUBY_METHOD_FUNC(rb_digest_algorithm_name),     0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "implementation_name", RUBY_METHOD_FUNC(rb_digest_implementation_name), 0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "clear",               RUBY_METHOD_FUNC(rb_digest_clear),              0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "validate",            RUBY_METHOD_FUNC(rb_digest_validate),           0); /* in digests.cpp */
 
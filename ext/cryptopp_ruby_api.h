@@ -33,6 +33,12 @@ extern VALUE rb_cCryptoPP_Digest_HMAC;
 #include "defs/hmacs.def"
 
 VALUE rb_module_cipher_factory(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_encrypt_many(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_decrypt_many(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_encrypt(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_decrypt(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_cipher_cache_size(VALUE self);
+VALUE rb_module_cipher_cache_size_eq(VALUE self, VALUE size);
 #define CIPHER_ALGORITHM_X(klass, r, n, s) \
 VALUE rb_cipher_ ## r ##_new(int argc, VALUE *argv, VALUE self);
 #include "defs/ciphers.def"
@@ -41,6 +47,22 @@ VALUE rb_cipher_iv_eq(VALUE self, VALUE iv);
 VALUE rb_cipher_iv_hex_eq(VALUE self, VALUE iv);
 VALUE rb_cipher_iv(VALUE self);
 VALUE rb_cipher_iv_hex(VALUE self);
+VALUE rb_cipher_aad_eq(VALUE self, VALUE aad);
+VALUE rb_cipher_aad_hex_eq(VALUE self, VALUE aad);
+VALUE rb_cipher_aad(VALUE self);
+VALUE rb_cipher_aad_hex(VALUE self);
+VALUE rb_cipher_tag(VALUE self);
+VALUE rb_cipher_tag_hex(VALUE self);
+VALUE rb_cipher_tag_length_eq(VALUE self, VALUE l);
+VALUE rb_cipher_tag_length(VALUE self);
+VALUE rb_cipher_gcm_tables_eq(VALUE self, VALUE t);
+VALUE rb_cipher_gcm_tables(VALUE self);
+VALUE rb_cipher_mac_eq(VALUE self, VALUE m);
+VALUE rb_cipher_mac(VALUE self);
+VALUE rb_cipher_mac_key_eq(VALUE self, VALUE key);
+VALUE rb_cipher_mac_key_hex_eq(VALUE self, VALUE key);
+VALUE rb_cipher_mac_key(VALUE self);
+VALUE rb_cipher_mac_key_hex(VALUE self);
 VALUE rb_cipher_block_mode_eq(VALUE self, VALUE m);
 VALUE rb_cipher_block_mode(VALUE self);
 VALUE rb_cipher_padding_eq(VALUE self, VALUE p);
@@ -71,14 +93,31 @@ VALUE rb_cipher_effective_key_length(VALUE self);
 VALUE rb_cipher_block_size(VALUE self);
 VALUE rb_cipher_rounds_eq(VALUE self, VALUE r);
 VALUE rb_cipher_rounds(VALUE self);
-VALUE rb_cipher_encrypt(VALUE self);
+VALUE rb_cipher_encrypt(int argc, VALUE *argv, VALUE self);
 VALUE rb_cipher_encrypt_hex(VALUE self);
-VALUE rb_cipher_decrypt(VALUE self);
+VALUE rb_cipher_decrypt(int argc, VALUE *argv, VALUE self);
 VALUE rb_cipher_decrypt_hex(VALUE self);
+VALUE rb_cipher_encrypt_bang(VALUE self, VALUE data);
+VALUE rb_cipher_decrypt_bang(VALUE self, VALUE data);
 VALUE rb_cipher_encrypt_io(VALUE self, VALUE in, VALUE out);
 VALUE rb_cipher_decrypt_io(VALUE self, VALUE in, VALUE out);
+VALUE rb_cipher_threads_eq(VALUE self, VALUE t);
+VALUE rb_cipher_threads(VALUE self);
+VALUE rb_cipher_update(VALUE self, VALUE data);
+VALUE rb_cipher_decrypt_update(VALUE self, VALUE data);
+VALUE rb_cipher_final(VALUE self);
+VALUE rb_cipher_encrypt_batch(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_decrypt_batch(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_encrypt_sectors(VALUE self, VALUE buffer, VALUE first_sector, VALUE sector_size);
+VALUE rb_cipher_decrypt_sectors(VALUE self, VALUE buffer, VALUE first_sector, VALUE sector_size);
+VALUE rb_cipher_decrypt_range(VALUE self, VALUE source, VALUE offset, VALUE length);
+VALUE rb_cipher_seek(VALUE self, VALUE p);
+VALUE rb_cipher_position(VALUE self);
+VALUE rb_cipher_process_at(VALUE self, VALUE p, VALUE data);
+VALUE rb_cipher_precompute_keystream(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_cipher_name(VALUE self, VALUE c);
 VALUE rb_cipher_algorithm_name(VALUE self);
+VALUE rb_cipher_implementation_name(VALUE self);
 VALUE rb_module_block_mode_name(VALUE self, VALUE m);
 VALUE rb_cipher_block_mode_name(VALUE self);
 VALUE rb_module_padding_name(VALUE self, VALUE p);
@@ -117,6 +156,7 @@ VALUE rb_module_digest_io_hex(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_digest_enabled(VALUE self, VALUE d);
 VALUE rb_module_digest_name(VALUE self, VALUE h);
 VALUE rb_digest_algorithm_name(VALUE self);
+VALUE rb_digest_implementation_name(VALUE self);
 VALUE rb_digest_clear(VALUE self);
 VALUE rb_digest_validate(VALUE self);
 VALUE rb_digest_digest_io(VALUE self, VALUE io);
@@ -136,4 +176,8 @@ VALUE rb_module_hmac_digest(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_hmac_digest_hex(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_hmac_list(VALUE self);
 
+VALUE rb_module_gvl_threshold(VALUE self);
+VALUE rb_module_gvl_threshold_eq(VALUE self, VALUE threshold);
+VALUE rb_module_cpu_features(VALUE self);
+
 #endif
@@ -34,20 +34,20 @@ static bool digest_is_hmac(HashEnum hash);
 static bool digest_is_non_hmac(HashEnum hash);
 static bool digest_enabled(HashEnum hash);
 static void digest_options(VALUE self, VALUE options);
-static JHash* digest_factory(VALUE algorithm);
 static VALUE wrap_digest_in_ruby(JHash* hash);
 static string digest_digest(VALUE self, bool hex);
 static string digest_plaintext(VALUE self, bool hex);
 static string digest_plaintext_eq(VALUE self, VALUE plaintext, bool hex);
 static string digest_calculate(VALUE self, bool hex);
 static string digest_digest_eq(VALUE self, VALUE digest, bool hex);
-static string module_digest(int argc, VALUE *argv, VALUE self, bool hex);
+static VALUE module_digest(int argc, VALUE *argv, VALUE self, bool hex);
 static string module_digest_io(int argc, VALUE *argv, VALUE self, bool hex);
 static string digest_digest_io(VALUE self, VALUE io, bool hex);
 static void digest_hmac_options(VALUE self, VALUE options);
 static string digest_hmac_key_eq(VALUE self, VALUE key, bool hex);
 static string digest_hmac_key(VALUE self, bool hex);
-static string module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex);
+static VALUE module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex);
+static int digest_hash(JHash* hash);
 
 static HashEnum digest_sym_to_const(VALUE c)
 {
@@ -118,6 +118,20 @@ static bool digest_is_non_hmac(HashEnum hash)
 }
 
 
+/* The part of digest_hash that may run without the GVL. */
+static void digest_hash_work(void* data, const volatile bool* interrupted)
+{
+  ((JHash*) data)->hash(interrupted);
+}
+
+/* Calculates a digest, releasing the GVL while doing so if the plaintext is
+ * large enough. Returns the tag to jump to if Ruby raised meanwhile. */
+static int digest_hash(JHash* hash)
+{
+  return runWithoutGVL(digest_hash_work, hash, hash->getPlaintextLength());
+}
+
+
 /* See if a hash algorithm is enabled. */
 static bool digest_enabled(HashEnum hash)
 {
@@ -174,8 +188,8 @@ static void digest_options(VALUE self, VALUE options)
 }
 
 
-/* Creates a new Digest object. */
-static JHash* digest_factory(VALUE algorithm)
+/* Creates a new Digest object. Also used by ciphers.cpp for MACs. */
+JHash* digest_factory(VALUE algorithm)
 {
   try {
     switch (digest_sym_to_const(algorithm)) {
@@ -350,8 +364,17 @@ VALUE rb_digest_update(VALUE self, VALUE plaintext)
   JHash *hash = NULL;
   Check_Type(plaintext, T_STRING);
   Data_Get_Struct(self, JHash, hash);
+  int state = 0;
   hash->updatePlaintext(string(StringValuePtr(plaintext), RSTRING_LEN(plaintext)));
-  hash->hash();
+  try {
+    state = digest_hash(hash);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
   return rb_tainted_str_new(hash->getHashtext().data(), hash->getHashtext().length());
 }
 
@@ -461,8 +484,17 @@ VALUE rb_digest_plaintext_hex_eq(VALUE self, VALUE plaintext)
 static string digest_calculate(VALUE self, bool hex)
 {
   JHash *hash = NULL;
+  int state = 0;
   Data_Get_Struct(self, JHash, hash);
-  hash->hash();
+  try {
+    state = digest_hash(hash);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
   return hash->getHashtext(hex);
 }
 
@@ -577,7 +609,7 @@ VALUE rb_digest_equals(VALUE self, VALUE compare)
 
 
 /* Singleton method for digesting good stuff. */
-static string module_digest(int argc, VALUE *argv, VALUE self, bool hex)
+static VALUE module_digest(int argc, VALUE *argv, VALUE self, bool hex)
 {
   JHash* hash = NULL;
   VALUE algorithm, plaintext, key;
@@ -595,18 +627,22 @@ static string module_digest(int argc, VALUE *argv, VALUE self, bool hex)
     Check_Type(plaintext, T_STRING);
   }
 
+  VALUE retval = Qnil;
+  int state = 0;
+
   try {
-    string retval;
     hash = digest_factory(algorithm);
     hash->setPlaintext(string(StringValuePtr(plaintext), RSTRING_LEN(plaintext)));
     if (digest_is_hmac(digest_sym_to_const(algorithm))) {
       ((JHMAC*) hash)->setKey(string(StringValuePtr(key), RSTRING_LEN(key)));
     }
-    hash->hash();
-    retval = hash->getHashtext(hex);
+    state = digest_hash(hash);
+    if (state == 0) {
+      string digest = hash->getHashtext(hex);
+      retval = rb_tainted_str_new(digest.data(), digest.length());
+    }
 
     delete hash;
-    return retval;
   }
   catch (Exception& e) {
     if (hash != NULL) {
@@ -614,6 +650,11 @@ static string module_digest(int argc, VALUE *argv, VALUE self, bool hex)
     }
     rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
   }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  return retval;
 }
 
 /**
@@ -624,8 +665,7 @@ static string module_digest(int argc, VALUE *argv, VALUE self, bool hex)
  */
 VALUE rb_module_digest(int argc, VALUE *argv, VALUE self)
 {
-  string retval = module_digest(argc, argv, self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return module_digest(argc, argv, self, false);
 }
 
 /**
@@ -636,8 +676,7 @@ VALUE rb_module_digest(int argc, VALUE *argv, VALUE self)
  */
 VALUE rb_module_digest_hex(int argc, VALUE *argv, VALUE self)
 {
-  string retval = module_digest(argc, argv, self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return module_digest(argc, argv, self, true);
 }
 
 
@@ -758,6 +797,22 @@ VALUE rb_digest_algorithm_name(VALUE self)
 }
 
 
+/**
+ * call-seq:
+ *     implementation_name => String
+ *
+ * Returns the name of the code path Crypto++ uses for the digest on this
+ * CPU, like "SHANI", "SSE2" or "C++". Crypto++ versions before 6.0 don't
+ * report this and return "unknown". See also CryptoPP.cpu_features.
+ */
+VALUE rb_digest_implementation_name(VALUE self)
+{
+  JHash *hash = NULL;
+  Data_Get_Struct(self, JHash, hash);
+  return rb_tainted_str_new2(hash->getImplementationName().c_str());
+}
+
+
 /**
  * Clears a Digest's plaintext and hashtext.
  */
@@ -1083,27 +1138,44 @@ VALUE rb_digest_hmac_key_length(VALUE self)
 
 
 /* Digest the plaintext. */
-static string module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex)
+static VALUE module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex)
 {
-  JHash *hash;
+  JHash *hash = NULL;
   VALUE algorithm, plaintext, key;
 
   rb_scan_args(argc, argv, "12", &algorithm, &plaintext, &key);
   Check_Type(plaintext, T_STRING);
-  {
-    string retval;
+  if (argc == 3) {
+    Check_Type(key, T_STRING);
+  }
+  VALUE retval = Qnil;
+  int state = 0;
+
+  try {
     hash = digest_factory(algorithm);
     hash->setPlaintext(string(StringValuePtr(plaintext), RSTRING_LEN(plaintext)));
     if (argc == 3) {
-      Check_Type(plaintext, T_STRING);
       ((JHMAC*) hash)->setKey(string(StringValuePtr(key), RSTRING_LEN(key)));
     }
-    hash->hash();
-    retval = hash->getHashtext(hex);
+    state = digest_hash(hash);
+    if (state == 0) {
+      string digest = hash->getHashtext(hex);
+      retval = rb_tainted_str_new(digest.data(), digest.length());
+    }
 
     delete hash;
-    return retval;
   }
+  catch (Exception& e) {
+    if (hash != NULL) {
+      delete hash;
+    }
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  return retval;
 }
 
 /**
@@ -1116,8 +1188,7 @@ static string module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex)
  */
 VALUE rb_module_hmac_digest(int argc, VALUE *argv, VALUE self)
 {
-  string retval = module_hmac_digest(argc, argv, self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return module_hmac_digest(argc, argv, self, false);
 }
 
 /**
@@ -1130,8 +1201,7 @@ VALUE rb_module_hmac_digest(int argc, VALUE *argv, VALUE self)
  */
 VALUE rb_module_hmac_digest_hex(int argc, VALUE *argv, VALUE self)
 {
-  string retval = module_hmac_digest(argc, argv, self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return module_hmac_digest(argc, argv, self, true);
 }
 
 
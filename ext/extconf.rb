@@ -21,11 +21,27 @@ ruby_version = RbConfig::CONFIG.values_at('MAJOR', 'MINOR', 'TEENY').join
 
 $defs.concat([
   "-DNDEBUG",
-  "-DCRYPTOPP_DISABLE_ASM",
   "-DRUBY_VERSION_CODE=#{ruby_version}",
   "-DEXT_VERSION_CODE=#{version}"
 ])
 
+# Crypto++ picks its assembly and SIMD code paths at runtime based on what
+# the CPU supports, but its headers have to agree with how the library was
+# built. Use --disable-asm for libraries built with CRYPTOPP_DISABLE_ASM.
+unless enable_config('asm', true)
+  $defs << "-DCRYPTOPP_DISABLE_ASM"
+end
+
+# The bitsliced DES and multi-block kernels are as wide as the SIMD
+# registers the compiler is allowed to use, which is SSE2 on x86-64 unless
+# told otherwise. Use --enable-native to build for this CPU, e.g. to get
+# AVX2. The RC6, Twofish, Camellia and CAST-256 kernels are only built with
+# AVX2, since they're no faster than Crypto++ with SSE2; without it those
+# four run through Crypto++ exactly as before.
+if enable_config('native', false)
+  $CXXFLAGS << " -march=native"
+end
+
 def error msg
   message msg + "\n"
   abort
@@ -77,5 +93,11 @@ if have_blocksize
   $defs << "-DHAVE_CRYPTOPP_SHA3_BLOCKSIZE"
 end
 
+# Used to release the GVL during long encryption and hashing jobs.
+have_func('rb_thread_call_without_gvl', 'ruby/thread.h')
+
+# Native threads for splitting large jobs up.
+have_library('pthread', 'pthread_create')
+
 create_makefile('cryptopp')
 
@@ -0,0 +1,227 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JAUTHSTREAM_T_H__
+#define __JAUTHSTREAM_T_H__
+
+#include "jbasiccipherinfo.h"
+
+// Stream ciphers that come with their own MAC, like ChaCha20-Poly1305.
+// These work like the authenticated block modes: itsAAD is authenticated
+// along with the message, the tag goes on the end of the ciphertext and
+// decrypting checks it. Since the output is longer than the input and the
+// tag covers the whole message, there's no working in place, seeking or
+// precomputed keystream.
+template <typename INFO, enum CipherEnum TYPE>
+class JAuthenticatedStream_Template : public JBasicCipherInfo<INFO, JStream>
+{
+  public:
+    JAuthenticatedStream_Template();
+    virtual ~JAuthenticatedStream_Template();
+
+    inline enum CipherEnum getCipherType() const;
+    inline unsigned int getBlockSize() const { return 0; }
+    string getImplementationName();
+
+    size_t processMessage(const byte* in, const size_t length, byte* out, const bool decrypting, const volatile bool* interrupted = NULL);
+    void processInPlace(byte* data, const size_t length, const bool decrypting, const volatile bool* interrupted = NULL);
+
+    bool encryptRubyIO(VALUE* in, VALUE* out);
+    bool decryptRubyIO(VALUE* in, VALUE* out);
+
+    void seek(const lword position);
+    bool isRandomAccess();
+    string processAt(const lword position, const string& data, const volatile bool* interrupted = NULL);
+    void precomputeKeystream(const size_t length, const bool background, const volatile bool* interrupted = NULL);
+
+  protected:
+    // Keyed objects, resynchronized with itsIV before each use.
+    virtual AuthenticatedSymmetricCipher* getEncryptionObject() = 0;
+    virtual AuthenticatedSymmetricCipher* getDecryptionObject() = 0;
+
+    AuthenticatedSymmetricCipher* getAuthenticatedCipher(const bool decrypting);
+    void invalidateCipherObjects();
+    BufferedTransformation* createStreamFilter(const bool decrypting, BufferedTransformation* sink);
+
+    AuthenticatedSymmetricCipher* itsEncryptionObject;
+    AuthenticatedSymmetricCipher* itsDecryptionObject;
+};
+
+template <typename INFO, enum CipherEnum TYPE>
+JAuthenticatedStream_Template<INFO, TYPE>::JAuthenticatedStream_Template()
+{
+  this->itsKeylength = INFO::DEFAULT_KEYLENGTH;
+
+  itsEncryptionObject = NULL;
+  itsDecryptionObject = NULL;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+JAuthenticatedStream_Template<INFO, TYPE>::~JAuthenticatedStream_Template()
+{
+  invalidateCipherObjects();
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+void JAuthenticatedStream_Template<INFO, TYPE>::invalidateCipherObjects()
+{
+  this->endStream();
+  delete itsEncryptionObject;
+  delete itsDecryptionObject;
+
+  itsEncryptionObject = NULL;
+  itsDecryptionObject = NULL;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+AuthenticatedSymmetricCipher* JAuthenticatedStream_Template<INFO, TYPE>::getAuthenticatedCipher(const bool decrypting)
+{
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
+
+  AuthenticatedSymmetricCipher*& cipher = decrypting ? itsDecryptionObject : itsEncryptionObject;
+
+  if (cipher == NULL) {
+    cipher = decrypting ? getDecryptionObject() : getEncryptionObject();
+    if (cipher == NULL) {
+      return NULL;
+    }
+  }
+
+  this->resynchronizeAuthenticated(*cipher);
+
+  return cipher;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+BufferedTransformation* JAuthenticatedStream_Template<INFO, TYPE>::createStreamFilter(const bool decrypting, BufferedTransformation* sink)
+{
+  AuthenticatedSymmetricCipher* cipher = NULL;
+
+  try {
+    cipher = getAuthenticatedCipher(decrypting);
+  }
+  catch (...) {
+    delete sink;
+    throw;
+  }
+
+  if (cipher == NULL) {
+    delete sink;
+    return NULL;
+  }
+
+  return this->createAuthenticatedFilter(*cipher, decrypting, sink);
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+string JAuthenticatedStream_Template<INFO, TYPE>::getImplementationName()
+{
+  if (itsEncryptionObject != NULL) {
+    return getAlgorithmProvider(*itsEncryptionObject);
+  }
+
+  string key(this->itsKey);
+  this->itsKey.resize(this->itsKeylength);
+  member_ptr<AuthenticatedSymmetricCipher> cipher;
+  try {
+    cipher.reset(getEncryptionObject());
+  }
+  catch (...) {
+    this->itsKey.swap(key);
+    throw;
+  }
+  this->itsKey.swap(key);
+
+  return cipher.get() == NULL ? "unknown" : getAlgorithmProvider(*cipher);
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+bool JAuthenticatedStream_Template<INFO, TYPE>::isRandomAccess()
+{
+  return false;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+void JAuthenticatedStream_Template<INFO, TYPE>::seek(const lword position)
+{
+  if (position > 0) {
+    throw JException(this->getCipherName() + " can't seek in its keystream");
+  }
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+string JAuthenticatedStream_Template<INFO, TYPE>::processAt(const lword position, const string& data, const volatile bool* interrupted)
+{
+  throw JException(this->getCipherName() + " authenticates whole messages; use encrypt and decrypt");
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+void JAuthenticatedStream_Template<INFO, TYPE>::precomputeKeystream(const size_t length, const bool background, const volatile bool* interrupted)
+{
+  throw JException(this->getCipherName() + " authenticates whole messages; use encrypt and decrypt");
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+CipherEnum JAuthenticatedStream_Template<INFO, TYPE>::getCipherType() const
+{
+  return TYPE;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+size_t JAuthenticatedStream_Template<INFO, TYPE>::processMessage(const byte* in, const size_t length, byte* out, const bool decrypting, const volatile bool* interrupted)
+{
+  AuthenticatedSymmetricCipher* cipher = getAuthenticatedCipher(decrypting);
+
+  if (cipher == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  if (decrypting) {
+    return this->decryptAuthenticated(*cipher, in, length, out, interrupted);
+  }
+  else {
+    return this->encryptAuthenticated(*cipher, in, length, out, interrupted);
+  }
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+void JAuthenticatedStream_Template<INFO, TYPE>::processInPlace(byte* data, const size_t length, const bool decrypting, const volatile bool* interrupted)
+{
+  throw JException(this->getCipherName() + " adds a tag to the ciphertext, so it can't work in place");
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+bool JAuthenticatedStream_Template<INFO, TYPE>::encryptRubyIO(VALUE* in, VALUE* out)
+{
+  AuthenticatedSymmetricCipher* cipher = getAuthenticatedCipher(false);
+
+  if (cipher == NULL) {
+    return false;
+  }
+
+  RubyIOSource(&in, true, this->createAuthenticatedFilter(*cipher, false, new RubyIOSink(&out)));
+
+  return true;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+bool JAuthenticatedStream_Template<INFO, TYPE>::decryptRubyIO(VALUE* in, VALUE* out)
+{
+  AuthenticatedSymmetricCipher* cipher = getAuthenticatedCipher(true);
+
+  if (cipher == NULL) {
+    return false;
+  }
+
+  RubyIOSource(&in, true, this->createAuthenticatedFilter(*cipher, true, new RubyIOSink(&out)));
+
+  return true;
+}
+
+#endif
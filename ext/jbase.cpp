@@ -11,7 +11,19 @@ JBase::JBase()
 {
   itsPlaintext = "";
   itsIV = "";
+  itsKey = "";
+  itsKeylength = 0;
   itsRNG = DEFAULT_RNG;
+  itsTagLength = MAX_TAG_LENGTH;
+  itsMAC = NULL;
+  itsStream = NULL;
+  itsStreamDecrypting = false;
+}
+
+JBase::~JBase()
+{
+  endStream();
+  delete itsMAC;
 }
 
 string JBase::getPlaintext(const bool hex) const
@@ -34,6 +46,26 @@ string JBase::getCiphertext(const bool hex) const
   }
 }
 
+const string& JBase::getRawPlaintext() const
+{
+  return itsPlaintext;
+}
+
+const string& JBase::getRawCiphertext() const
+{
+  return itsCiphertext;
+}
+
+size_t JBase::getPlaintextLength() const
+{
+  return itsPlaintext.length();
+}
+
+size_t JBase::getCiphertextLength() const
+{
+  return itsCiphertext.length();
+}
+
 string JBase::getKey(const bool hex) const
 {
   if (hex) {
@@ -71,6 +103,8 @@ void JBase::setCiphertext(const string ciphertext, const bool hex)
 
 unsigned int JBase::setKey(const string key, const bool hex)
 {
+  string previous = itsKey;
+
   if (hex) {
     itsKey = hex2bin(key);
   }
@@ -80,14 +114,24 @@ unsigned int JBase::setKey(const string key, const bool hex)
 
   setKeylength(itsKey.length());
 
+  if (itsKey != previous) {
+    invalidateCipherObjects();
+  }
+
   return itsKeylength;
 }
 
 unsigned int JBase::setKeylength(const unsigned int keylength)
 {
+  unsigned int previous = itsKeylength;
+
   itsKeylength = getValidKeylength(keylength);
   itsKey.resize(itsKeylength);
 
+  if (itsKeylength != previous) {
+    invalidateCipherObjects();
+  }
+
   return itsKeylength;
 }
 
@@ -170,3 +214,385 @@ void JBase::setRandIV(const unsigned int size)
 {
   itsIV = generateIV(size, itsRNG);
 }
+
+string JBase::getAAD(const bool hex) const
+{
+  if (hex) {
+    return bin2hex(itsAAD);
+  }
+  else {
+    return itsAAD;
+  }
+}
+
+void JBase::setAAD(const string aad, const bool hex)
+{
+  if (hex) {
+    itsAAD = hex2bin(aad);
+  }
+  else {
+    itsAAD = aad;
+  }
+}
+
+string JBase::getTag(const bool hex) const
+{
+  if (hex) {
+    return bin2hex(itsTag);
+  }
+  else {
+    return itsTag;
+  }
+}
+
+unsigned int JBase::getTagLength() const
+{
+  return itsTagLength;
+}
+
+unsigned int JBase::setTagLength(const unsigned int length)
+{
+  itsTagLength = checkBounds(length, MIN_TAG_LENGTH, MAX_TAG_LENGTH);
+  return itsTagLength;
+}
+
+JHMAC* JBase::getMAC() const
+{
+  return itsMAC;
+}
+
+void JBase::setMAC(JHMAC* mac)
+{
+  if (mac != itsMAC) {
+    delete itsMAC;
+    itsMAC = mac;
+  }
+}
+
+string JBase::getMACKey(const bool hex) const
+{
+  if (hex) {
+    return bin2hex(itsMACKey);
+  }
+  else {
+    return itsMACKey;
+  }
+}
+
+void JBase::setMACKey(const string key, const bool hex)
+{
+  if (hex) {
+    itsMACKey = hex2bin(key);
+  }
+  else {
+    itsMACKey = key;
+  }
+}
+
+bool JBase::resynchronize(SimpleKeyingInterface* cipher) const
+{
+  if (!cipher->IsResynchronizable()) {
+    return false;
+  }
+
+  SecByteBlock iv;
+  copyIV(iv, cipher->IVSize());
+  cipher->Resynchronize(iv.data(), (int) iv.size());
+
+  return true;
+}
+
+void JBase::copyIV(SecByteBlock& iv, const size_t size) const
+{
+  // the IV is zero-padded or truncated to whatever the cipher wants, the
+  // same as the old behaviour of handing itsIV.data() to the constructor
+  iv.CleanNew(size);
+  memcpy(iv.data(), itsIV.data(), STDMIN((size_t) itsIV.length(), size));
+}
+
+bool JBase::encrypt(const volatile bool* interrupted)
+{
+  string out(getMaxOutputLength(itsPlaintext.length(), false), '\0');
+
+  out.resize(processMessage((const byte*) itsPlaintext.data(), itsPlaintext.length(), out.empty() ? NULL : (byte*) &out[0], false, interrupted));
+  itsCiphertext.swap(out);
+
+  return true;
+}
+
+bool JBase::decrypt(const volatile bool* interrupted)
+{
+  string out(getMaxOutputLength(itsCiphertext.length(), true), '\0');
+
+  try {
+    out.resize(processMessage((const byte*) itsCiphertext.data(), itsCiphertext.length(), out.empty() ? NULL : (byte*) &out[0], true, interrupted));
+  }
+  catch (...) {
+    itsPlaintext.erase();
+    throw;
+  }
+
+  itsPlaintext.swap(out);
+
+  return true;
+}
+
+size_t JBase::getMaxOutputLength(const size_t length, const bool decrypting) const
+{
+  // padding adds at most a block and the tag goes on the end, while
+  // decrypting only ever takes away
+  if (decrypting) {
+    return length;
+  }
+  else {
+    return length + getBlockSize() + itsTagLength;
+  }
+}
+
+size_t JBase::encryptAuthenticated(AuthenticatedSymmetricCipher& cipher, const byte* in, const size_t length, byte* out, const volatile bool* interrupted)
+{
+  itsTag.erase();
+
+  ArraySink* sink = new ArraySink(out, getMaxOutputLength(length, false));
+  StringSource source(in, length, false, createAuthenticatedFilter(cipher, false, sink));
+  pumpAll(source, interrupted);
+
+  size_t written = (size_t) sink->TotalPutLength();
+  copyTag(out, written);
+
+  return written;
+}
+
+size_t JBase::decryptAuthenticated(AuthenticatedSymmetricCipher& cipher, const byte* in, const size_t length, byte* out, const volatile bool* interrupted)
+{
+  size_t written = 0;
+
+  try {
+    ArraySink* sink = new ArraySink(out, length);
+    StringSource source(in, length, false, createAuthenticatedFilter(cipher, true, sink));
+    pumpAll(source, interrupted);
+    written = (size_t) sink->TotalPutLength();
+  }
+  catch (...) {
+    // nothing unauthenticated is handed back
+    if (length > 0) {
+      memset(out, 0, length);
+    }
+    throw;
+  }
+
+  return written;
+}
+
+Filter* JBase::createAuthenticatedFilter(AuthenticatedSymmetricCipher& cipher, const bool decrypting, BufferedTransformation* attachment) const
+{
+  Filter* filter = NULL;
+
+  if (decrypting) {
+    filter = new AuthenticatedDecryptionFilter(cipher, attachment, AuthenticatedDecryptionFilter::DEFAULT_FLAGS, itsTagLength);
+  }
+  else {
+    filter = new AuthenticatedEncryptionFilter(cipher, attachment, false, itsTagLength);
+  }
+
+  filter->ChannelPut(AAD_CHANNEL, (const byte*) itsAAD.data(), itsAAD.length());
+
+  return filter;
+}
+
+void JBase::resynchronizeAuthenticated(AuthenticatedSymmetricCipher& cipher) const
+{
+  // a default nonce would be the same one for every message under the key
+  if (itsIV.empty()) {
+    throw JException("an IV is required in authenticated modes");
+  }
+
+  cipher.Resynchronize((const byte*) itsIV.data(), (int) itsIV.length());
+}
+
+void JBase::copyTag(const byte* ciphertext, const size_t length)
+{
+  itsTag.erase();
+
+  if (length >= itsTagLength) {
+    itsTag.assign((const char*) ciphertext + length - itsTagLength, itsTagLength);
+  }
+}
+
+MessageAuthenticationCode* JBase::createMACModule() const
+{
+  if (itsMAC == NULL) {
+    throw JException("no MAC has been set");
+  }
+
+  // an unkeyed HMAC is a tag anyone can compute
+  if (itsMACKey.empty()) {
+    throw JException("no MAC key has been set");
+  }
+
+  member_ptr<MessageAuthenticationCode> retval(itsMAC->createMAC(itsMACKey));
+
+  if (retval->DigestSize() < itsTagLength) {
+    throw JException("the tag length is longer than the MAC's digest");
+  }
+
+  // covering the IV stops it from being swapped out, which would otherwise
+  // change the first block of CBC plaintext without touching the tag
+  retval->Update((const byte*) itsIV.data(), itsIV.length());
+
+  return retval.release();
+}
+
+Filter* JBase::createMACFilter(MessageAuthenticationCode& mac, BufferedTransformation* attachment) const
+{
+  return new HashFilter(mac, attachment, true, itsTagLength);
+}
+
+void JBase::verifyMAC(const byte* ciphertext, const size_t length) const
+{
+  if (length < itsTagLength) {
+    throw JException("ciphertext is too short to hold a tag");
+  }
+
+  member_ptr<MessageAuthenticationCode> mac(createMACModule());
+  size_t messageLength = length - itsTagLength;
+
+  mac->Update(ciphertext, messageLength);
+  if (!mac->TruncatedVerify(ciphertext + messageLength, itsTagLength)) {
+    throw JException("MAC verification failed");
+  }
+}
+
+void JBase::checkMACUnset() const
+{
+  if (itsMAC != NULL) {
+    throw JException("encrypt-then-MAC needs the whole message at once; use encrypt and decrypt");
+  }
+}
+
+string JBase::update(const string& data, const bool decrypting)
+{
+  if (itsStream == NULL) {
+    checkMACUnset();
+    itsStreamOutput.erase();
+    itsStream = createStreamFilter(decrypting, new StringSink(itsStreamOutput));
+    if (itsStream == NULL) {
+      throw JException("could not create a cipher object for streaming");
+    }
+    itsStreamDecrypting = decrypting;
+  }
+  else if (itsStreamDecrypting != decrypting) {
+    throw JException("can't mix encryption and decryption in the same stream; call final first");
+  }
+
+  try {
+    itsStream->Put((const byte*) data.data(), data.length());
+  }
+  catch (...) {
+    endStream();
+    throw;
+  }
+
+  string retval;
+  retval.swap(itsStreamOutput);
+  return retval;
+}
+
+string JBase::final()
+{
+  if (itsStream == NULL) {
+    return "";
+  }
+
+  try {
+    itsStream->MessageEnd();
+  }
+  catch (...) {
+    endStream();
+    throw;
+  }
+
+  string retval;
+  retval.swap(itsStreamOutput);
+  endStream();
+  return retval;
+}
+
+void JBase::processBatch(const vector<string>& in, const vector<string>& keys, const vector<string>& ivs, vector<string>& out, const bool decrypting, const volatile bool* interrupted)
+{
+  if ((!keys.empty() && keys.size() != in.size()) || (!ivs.empty() && ivs.size() != in.size())) {
+    throw JException("the number of keys or IVs doesn't match the number of entries");
+  }
+
+  // the default just runs each entry through encrypt() or decrypt() in
+  // turn, which is still cheaper than doing so from Ruby since the cipher
+  // objects are only set up once per key
+  string plaintext, ciphertext, key(itsKey), iv(itsIV);
+  plaintext.swap(itsPlaintext);
+  ciphertext.swap(itsCiphertext);
+
+  out.resize(in.size());
+
+  try {
+    for (size_t i = 0; i < in.size(); ++i) {
+      if (!keys.empty()) {
+        setKey(keys[i]);
+      }
+      itsIV = ivs.empty() ? iv : ivs[i];
+
+      if (decrypting) {
+        itsCiphertext = in[i];
+        if (!decrypt(interrupted)) {
+          throw JException("could not create a cipher object");
+        }
+        out[i].swap(itsPlaintext);
+      }
+      else {
+        itsPlaintext = in[i];
+        if (!encrypt(interrupted)) {
+          throw JException("could not create a cipher object");
+        }
+        out[i].swap(itsCiphertext);
+      }
+    }
+  }
+  catch (...) {
+    if (!keys.empty()) {
+      setKey(key);
+    }
+    itsIV.swap(iv);
+    itsPlaintext.swap(plaintext);
+    itsCiphertext.swap(ciphertext);
+    throw;
+  }
+
+  if (!keys.empty()) {
+    setKey(key);
+  }
+  itsIV.swap(iv);
+  itsPlaintext.swap(plaintext);
+  itsCiphertext.swap(ciphertext);
+}
+
+bool JBase::applyKeystream(const byte* in, const size_t length, byte* out)
+{
+  // the MAC needs to see the ciphertext and a stream in progress has the
+  // cipher objects tied up, so both go the usual way
+  if (itsMAC != NULL || itsStream != NULL || length == 0) {
+    return false;
+  }
+
+  return itsKeystream.apply(itsIV, in, out, length);
+}
+
+bool JBase::isStreaming() const
+{
+  return itsStream != NULL;
+}
+
+void JBase::endStream()
+{
+  delete itsStream;
+  itsStream = NULL;
+  itsStreamOutput.erase();
+}
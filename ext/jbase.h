@@ -9,15 +9,21 @@
 #define __JBASE_H__
 
 #include <string>
+#include <vector>
 
 #include "jhelpers.h"
 #include "jconstants.h"
 #include "jsink.h"
+#include "jexception.h"
+#include "jthreads.h"
+#include "jhmac.h"
+#include "jkeystream.h"
 
 // Crypto++ headers...
 
 #include "hex.h"
 #include "files.h"
+#include "filters.h"
 
 using namespace CryptoPP;
 
@@ -25,10 +31,17 @@ class JBase
 {
   public:
     JBase();
-    virtual ~JBase() {};
+    virtual ~JBase();
 
     string getPlaintext(const bool hex = false) const;
     string getCiphertext(const bool hex = false) const;
+    size_t getPlaintextLength() const;
+    size_t getCiphertextLength() const;
+
+    // The plaintext and ciphertext themselves rather than copies, for
+    // handing straight over to Ruby.
+    const string& getRawPlaintext() const;
+    const string& getRawCiphertext() const;
     string getKey(const bool hex = false) const;
     unsigned int getKeylength() const;
 
@@ -46,6 +59,24 @@ class JBase
     void setIV(string iv, bool hex = false);
     void setRandIV(const unsigned int size);
 
+    // Additional authenticated data and tags for the authenticated modes.
+    // The tag is appended to the ciphertext and checked when decrypting.
+    string getAAD(const bool hex = false) const;
+    void setAAD(const string aad, const bool hex = false);
+    string getTag(const bool hex = false) const;
+    unsigned int getTagLength() const;
+    unsigned int setTagLength(const unsigned int length);
+
+    // Encrypt-then-MAC for ciphers and modes that aren't authenticated on
+    // their own. With a MAC set, encrypt appends an HMAC of the IV and the
+    // ciphertext truncated to the tag length, and decrypt checks it before
+    // decrypting anything. The cipher takes ownership of mac, NULL turns
+    // it off.
+    JHMAC* getMAC() const;
+    void setMAC(JHMAC* mac);
+    string getMACKey(const bool hex = false) const;
+    void setMACKey(const string key, const bool hex = false);
+
     virtual unsigned int getDefaultKeylength() const = 0;
     virtual unsigned int getMaxKeylength() const = 0;
     virtual unsigned int getMinKeylength() const = 0;
@@ -55,13 +86,101 @@ class JBase
     virtual enum CipherEnum getCipherType() const = 0;
     virtual string getCipherName() const = 0;
 
-    virtual bool encrypt() = 0;
-    virtual bool decrypt() = 0;
+    // The code path Crypto++ uses for this cipher on this CPU, see
+    // getAlgorithmProvider().
+    virtual string getImplementationName() = 0;
+
+    // interrupted may point at a flag that aborts the work when set, see
+    // runWithoutGVL().
+    bool encrypt(const volatile bool* interrupted = NULL);
+    bool decrypt(const volatile bool* interrupted = NULL);
+
+    // Encrypts or decrypts length bytes of in straight into out with the
+    // current key, IV and settings, returning the number of bytes written.
+    // Neither the plaintext nor the ciphertext attributes are touched, but
+    // the tag is. out needs room for getMaxOutputLength() bytes. A bad tag
+    // throws and leaves out zeroed.
+    virtual size_t processMessage(const byte* in, const size_t length, byte* out, const bool decrypting, const volatile bool* interrupted = NULL) = 0;
+    size_t getMaxOutputLength(const size_t length, const bool decrypting) const;
+
+    // Encrypts or decrypts length bytes of data over themselves. Only for
+    // settings where the output is always the same length as the input,
+    // i.e. stream ciphers and the CFB, CTR, OFB and CBC with CTS modes
+    // without a MAC. Throws otherwise.
+    virtual void processInPlace(byte* data, const size_t length, const bool decrypting, const volatile bool* interrupted = NULL) = 0;
 
     virtual bool encryptRubyIO(VALUE* in, VALUE* out) = 0;
     virtual bool decryptRubyIO(VALUE* in, VALUE* out) = 0;
 
+    // Incremental interface. update() feeds another chunk through a filter
+    // that lives until final() and returns whatever output it produced.
+    string update(const string& data, const bool decrypting = false);
+    string final();
+    bool isStreaming() const;
+
+    // Encrypts or decrypts every entry of in into the same position of out.
+    // Entry i is under keys[i] and uses ivs[i] as its IV, or the current key
+    // and itsIV where keys or ivs are empty. The key, plaintext, ciphertext
+    // and IV attributes are left as they were.
+    virtual void processBatch(const vector<string>& in, const vector<string>& keys, const vector<string>& ivs, vector<string>& out, const bool decrypting, const volatile bool* interrupted = NULL);
+
+    // Generates length bytes of keystream for the current key, IV and mode
+    // ahead of time, on a native thread if background is set. Messages up
+    // to that long are then encrypted and decrypted with a plain XOR until
+    // any of those change. Only for CTR, OFB and stream ciphers.
+    virtual void precomputeKeystream(const size_t length, const bool background, const volatile bool* interrupted = NULL) = 0;
+
   protected:
+    // Creates the filter used by update() and final(), writing into sink.
+    virtual BufferedTransformation* createStreamFilter(const bool decrypting, BufferedTransformation* sink) = 0;
+
+    // Throws away an unfinished update() stream.
+    void endStream();
+
+    // Called whenever something that goes into the key schedule changes.
+    // Subclasses that cache cipher objects drop them here so they get
+    // rebuilt on their next use.
+    virtual void invalidateCipherObjects() {};
+
+    // Rewinds a cached cipher to the start of a message using itsIV.
+    bool resynchronize(SimpleKeyingInterface* cipher) const;
+
+    // Copies itsIV into iv, zero-padded or truncated to size bytes.
+    void copyIV(SecByteBlock& iv, const size_t size) const;
+
+    // Encryption and decryption with an authenticated mode. itsAAD is fed in
+    // first and the tag goes at the end of the ciphertext. A bad tag throws
+    // and zeroes out.
+    size_t encryptAuthenticated(AuthenticatedSymmetricCipher& cipher, const byte* in, const size_t length, byte* out, const volatile bool* interrupted);
+    size_t decryptAuthenticated(AuthenticatedSymmetricCipher& cipher, const byte* in, const size_t length, byte* out, const volatile bool* interrupted);
+
+    // The filter used by the above, update() and the RubyIO methods.
+    Filter* createAuthenticatedFilter(AuthenticatedSymmetricCipher& cipher, const bool decrypting, BufferedTransformation* attachment) const;
+
+    // Authenticated modes take IVs of any length, so itsIV is used as is.
+    // There's no default, since every message needs a nonce of its own.
+    void resynchronizeAuthenticated(AuthenticatedSymmetricCipher& cipher) const;
+
+    // Copies the last itsTagLength bytes of a length byte ciphertext into
+    // itsTag.
+    void copyTag(const byte* ciphertext, const size_t length);
+
+    // The encrypt-then-MAC pieces. createMACModule returns an HMAC keyed
+    // with itsMACKey that has already been fed itsIV, createMACFilter puts
+    // the message through to attachment followed by the tag, and verifyMAC
+    // throws if the tag at the end of ciphertext is wrong.
+    MessageAuthenticationCode* createMACModule() const;
+    Filter* createMACFilter(MessageAuthenticationCode& mac, BufferedTransformation* attachment) const;
+    void verifyMAC(const byte* ciphertext, const size_t length) const;
+
+    // The MAC needs the whole message, so update() and the RubyIO methods
+    // call this to refuse to run with one.
+    void checkMACUnset() const;
+
+    // Puts in through the precomputed keystream into out if there's enough
+    // of it for itsIV.
+    bool applyKeystream(const byte* in, const size_t length, byte* out);
+
     string itsPlaintext;
     string itsCiphertext;
     string itsKey;
@@ -69,6 +188,19 @@ class JBase
 
     unsigned int itsKeylength;
     enum RNGEnum itsRNG;
+
+    string itsAAD;
+    string itsTag;
+    unsigned int itsTagLength;
+
+    JHMAC* itsMAC;
+    string itsMACKey;
+
+    BufferedTransformation* itsStream;
+    string itsStreamOutput;
+    bool itsStreamDecrypting;
+
+    JKeystream itsKeystream;
 };
 
 #define getKeyHex() getKey(true)
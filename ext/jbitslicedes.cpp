@@ -0,0 +1,513 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include <algorithm>
+
+#include "jbitslicedes.h"
+#include "jexception.h"
+
+// Crypto++ headers...
+
+#include "misc.h"
+
+#if ENABLED_BITSLICED_DES
+
+#define DES_BLOCK_SIZE 8
+
+// S-box truth tables for one DES: 16 rounds of 8 S-boxes with 4 output
+// bits, each given by 16 functions of the first two input bits, see
+// bitslice_sbox().
+#define DES_LEAVES_SIZE (16 * 8 * 4 * 16)
+
+// Fewer blocks than this are left to the table-driven cipher, since a pass
+// costs the same however many of its blocks are in use.
+#define BITSLICE_MIN_BLOCKS (BITSLICE_BLOCKS / 4)
+
+// The tables from FIPS 46-3, with bits numbered from 1 starting at the most
+// significant bit.
+static const byte DES_IP[64] = {
+  58, 50, 42, 34, 26, 18, 10, 2, 60, 52, 44, 36, 28, 20, 12, 4,
+  62, 54, 46, 38, 30, 22, 14, 6, 64, 56, 48, 40, 32, 24, 16, 8,
+  57, 49, 41, 33, 25, 17,  9, 1, 59, 51, 43, 35, 27, 19, 11, 3,
+  61, 53, 45, 37, 29, 21, 13, 5, 63, 55, 47, 39, 31, 23, 15, 7
+};
+
+static const byte DES_FP[64] = {
+  40, 8, 48, 16, 56, 24, 64, 32, 39, 7, 47, 15, 55, 23, 63, 31,
+  38, 6, 46, 14, 54, 22, 62, 30, 37, 5, 45, 13, 53, 21, 61, 29,
+  36, 4, 44, 12, 52, 20, 60, 28, 35, 3, 43, 11, 51, 19, 59, 27,
+  34, 2, 42, 10, 50, 18, 58, 26, 33, 1, 41,  9, 49, 17, 57, 25
+};
+
+static const byte DES_E[48] = {
+  32,  1,  2,  3,  4,  5,  4,  5,  6,  7,  8,  9,
+   8,  9, 10, 11, 12, 13, 12, 13, 14, 15, 16, 17,
+  16, 17, 18, 19, 20, 21, 20, 21, 22, 23, 24, 25,
+  24, 25, 26, 27, 28, 29, 28, 29, 30, 31, 32,  1
+};
+
+static const byte DES_P[32] = {
+  16,  7, 20, 21, 29, 12, 28, 17,  1, 15, 23, 26,  5, 18, 31, 10,
+   2,  8, 24, 14, 32, 27,  3,  9, 19, 13, 30,  6, 22, 11,  4, 25
+};
+
+static const byte DES_PC1[56] = {
+  57, 49, 41, 33, 25, 17,  9,  1, 58, 50, 42, 34, 26, 18,
+  10,  2, 59, 51, 43, 35, 27, 19, 11,  3, 60, 52, 44, 36,
+  63, 55, 47, 39, 31, 23, 15,  7, 62, 54, 46, 38, 30, 22,
+  14,  6, 61, 53, 45, 37, 29, 21, 13,  5, 28, 20, 12,  4
+};
+
+static const byte DES_PC2[48] = {
+  14, 17, 11, 24,  1,  5,  3, 28, 15,  6, 21, 10,
+  23, 19, 12,  4, 26,  8, 16,  7, 27, 20, 13,  2,
+  41, 52, 31, 37, 47, 55, 30, 40, 51, 45, 33, 48,
+  44, 49, 39, 56, 34, 53, 46, 42, 50, 36, 29, 32
+};
+
+static const byte DES_SHIFTS[16] = {
+  1, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1
+};
+
+static const byte DES_SBOX[8][64] = {
+  {
+    14,  4, 13,  1,  2, 15, 11,  8,  3, 10,  6, 12,  5,  9,  0,  7,
+     0, 15,  7,  4, 14,  2, 13,  1, 10,  6, 12, 11,  9,  5,  3,  8,
+     4,  1, 14,  8, 13,  6,  2, 11, 15, 12,  9,  7,  3, 10,  5,  0,
+    15, 12,  8,  2,  4,  9,  1,  7,  5, 11,  3, 14, 10,  0,  6, 13
+  },
+  {
+    15,  1,  8, 14,  6, 11,  3,  4,  9,  7,  2, 13, 12,  0,  5, 10,
+     3, 13,  4,  7, 15,  2,  8, 14, 12,  0,  1, 10,  6,  9, 11,  5,
+     0, 14,  7, 11, 10,  4, 13,  1,  5,  8, 12,  6,  9,  3,  2, 15,
+    13,  8, 10,  1,  3, 15,  4,  2, 11,  6,  7, 12,  0,  5, 14,  9
+  },
+  {
+    10,  0,  9, 14,  6,  3, 15,  5,  1, 13, 12,  7, 11,  4,  2,  8,
+    13,  7,  0,  9,  3,  4,  6, 10,  2,  8,  5, 14, 12, 11, 15,  1,
+    13,  6,  4,  9,  8, 15,  3,  0, 11,  1,  2, 12,  5, 10, 14,  7,
+     1, 10, 13,  0,  6,  9,  8,  7,  4, 15, 14,  3, 11,  5,  2, 12
+  },
+  {
+     7, 13, 14,  3,  0,  6,  9, 10,  1,  2,  8,  5, 11, 12,  4, 15,
+    13,  8, 11,  5,  6, 15,  0,  3,  4,  7,  2, 12,  1, 10, 14,  9,
+    10,  6,  9,  0, 12, 11,  7, 13, 15,  1,  3, 14,  5,  2,  8,  4,
+     3, 15,  0,  6, 10,  1, 13,  8,  9,  4,  5, 11, 12,  7,  2, 14
+  },
+  {
+     2, 12,  4,  1,  7, 10, 11,  6,  8,  5,  3, 15, 13,  0, 14,  9,
+    14, 11,  2, 12,  4,  7, 13,  1,  5,  0, 15, 10,  3,  9,  8,  6,
+     4,  2,  1, 11, 10, 13,  7,  8, 15,  9, 12,  5,  6,  3,  0, 14,
+    11,  8, 12,  7,  1, 14,  2, 13,  6, 15,  0,  9, 10,  4,  5,  3
+  },
+  {
+    12,  1, 10, 15,  9,  2,  6,  8,  0, 13,  3,  4, 14,  7,  5, 11,
+    10, 15,  4,  2,  7, 12,  9,  5,  6,  1, 13, 14,  0, 11,  3,  8,
+     9, 14, 15,  5,  2,  8, 12,  3,  7,  0,  4, 10,  1, 13, 11,  6,
+     4,  3,  2, 12,  9,  5, 15, 10, 11, 14,  1,  7,  6,  0,  8, 13
+  },
+  {
+     4, 11,  2, 14, 15,  0,  8, 13,  3, 12,  9,  7,  5, 10,  6,  1,
+    13,  0, 11,  7,  4,  9,  1, 10, 14,  3,  5, 12,  2, 15,  8,  6,
+     1,  4, 11, 13, 12,  3,  7, 14, 10, 15,  6,  8,  0,  5,  9,  2,
+     6, 11, 13,  8,  1,  4, 10,  7,  9,  5,  0, 15, 14,  2,  3, 12
+  },
+  {
+    13,  2,  8,  4,  6, 15, 11,  1, 10,  9,  3, 14,  5,  0, 12,  7,
+     1, 15, 13,  8, 10,  3,  7,  4, 12,  5,  6, 11,  0, 14,  9,  2,
+     7, 11,  4,  1,  9, 12, 14,  2,  0,  6, 10, 13, 15,  3,  5,  8,
+     2,  1, 14,  7,  4, 10,  8, 13, 15, 12,  9,  0,  3,  5,  6, 11
+  }
+};
+
+/* Builds the S-box truth tables for one DES with an 8 byte key. Each S-box
+ * output bit is split on its first two input bits into 16 functions of
+ * the other four, each of which is one of the 16 functions of two bits.
+ * The round key is XORed into the S-box input here, so it's already in
+ * the tables and never touches the data. */
+static void bitslice_des_schedule(const byte* key, const bool decrypting, byte* leaves)
+{
+  byte cd[56];
+  byte subkeys[16][48];
+
+  for (unsigned int i = 0; i < 56; ++i) {
+    unsigned int bit = DES_PC1[i] - 1;
+    cd[i] = (key[bit / 8] >> (7 - bit % 8)) & 1;
+  }
+
+  for (unsigned int round = 0; round < 16; ++round) {
+    for (unsigned int shift = 0; shift < DES_SHIFTS[round]; ++shift) {
+      byte c = cd[0], d = cd[28];
+      memmove(cd, cd + 1, 27);
+      memmove(cd + 28, cd + 29, 27);
+      cd[27] = c;
+      cd[55] = d;
+    }
+
+    // decryption is the same with the round keys the other way around
+    byte* subkey = subkeys[decrypting ? 15 - round : round];
+    for (unsigned int i = 0; i < 48; ++i) {
+      subkey[i] = cd[DES_PC2[i] - 1];
+    }
+  }
+
+  for (unsigned int round = 0; round < 16; ++round) {
+    for (unsigned int s = 0; s < 8; ++s) {
+      unsigned int k = 0;
+      for (unsigned int i = 0; i < 6; ++i) {
+        k = (k << 1) | subkeys[round][s * 6 + i];
+      }
+
+      for (unsigned int o = 0; o < 4; ++o) {
+        byte* leaf = leaves + ((round * 8 + s) * 4 + o) * 16;
+
+        for (unsigned int rest = 0; rest < 16; ++rest) {
+          leaf[rest] = 0;
+          for (unsigned int first = 0; first < 4; ++first) {
+            unsigned int x = ((first << 4) | rest) ^ k;
+            byte value = DES_SBOX[s][(((x >> 4) & 2) | (x & 1)) * 16 + ((x >> 1) & 15)];
+            leaf[rest] |= ((value >> (3 - o)) & 1) << first;
+          }
+        }
+      }
+    }
+  }
+}
+
+/* One S-box over BITSLICE_BLOCKS blocks. The 16 functions of the first two
+ * input bits are worked out once, the table picks one of them for each
+ * value of the last four, and a tree of multiplexers on those four bits
+ * picks the output. */
+static inline void bitslice_sbox(const byte* leaves, const JBitslice& a, const JBitslice& b, const JBitslice& c, const JBitslice& d, const JBitslice& e, const JBitslice& f, JBitslice* out)
+{
+  JBitslice fn[16];
+
+  // bit n of the index is the value for a = n >> 1, b = n & 1
+  fn[0] = a ^ a;
+  fn[15] = ~fn[0];
+  fn[12] = a;
+  fn[3] = ~a;
+  fn[10] = b;
+  fn[5] = ~b;
+  fn[8] = a & b;
+  fn[7] = ~fn[8];
+  fn[14] = a | b;
+  fn[1] = ~fn[14];
+  fn[6] = a ^ b;
+  fn[9] = ~fn[6];
+  fn[4] = a & fn[5];
+  fn[11] = ~fn[4];
+  fn[2] = fn[3] & b;
+  fn[13] = ~fn[2];
+
+  for (unsigned int o = 0; o < 4; ++o) {
+    const byte* leaf = leaves + o * 16;
+    JBitslice v[8];
+
+    for (unsigned int i = 0; i < 8; ++i) {
+      const JBitslice& lo = fn[leaf[2 * i]];
+      v[i] = lo ^ ((lo ^ fn[leaf[2 * i + 1]]) & f);
+    }
+    for (unsigned int i = 0; i < 4; ++i) {
+      v[i] = v[2 * i] ^ ((v[2 * i] ^ v[2 * i + 1]) & e);
+    }
+    for (unsigned int i = 0; i < 2; ++i) {
+      v[i] = v[2 * i] ^ ((v[2 * i] ^ v[2 * i + 1]) & d);
+    }
+    out[o] = v[0] ^ ((v[0] ^ v[1]) & c);
+  }
+}
+
+/* The 16 rounds of one DES. Afterwards l holds L16 and r holds R16. */
+static void bitslice_des(JBitslice* l, JBitslice* r, const byte* leaves)
+{
+  JBitslice out[32];
+
+  for (unsigned int round = 0; round < 16; ++round) {
+    for (unsigned int s = 0; s < 8; ++s) {
+      const byte* e = DES_E + s * 6;
+      bitslice_sbox(leaves + (round * 8 + s) * 64, r[e[0] - 1], r[e[1] - 1], r[e[2] - 1], r[e[3] - 1], r[e[4] - 1], r[e[5] - 1], out + s * 4);
+    }
+    for (unsigned int i = 0; i < 32; ++i) {
+      l[i] ^= out[DES_P[i] - 1];
+    }
+    std::swap(l, r);
+  }
+}
+
+/* Transposes a 64x64 bit matrix, so that bit 63 - j of word i swaps places
+ * with bit 63 - i of word j. */
+static void transpose64(word64* a)
+{
+  word64 mask = W64LIT(0x00000000ffffffff);
+
+  for (unsigned int j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+    for (unsigned int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+      word64 t = (a[k] ^ (a[k | j] >> j)) & mask;
+      a[k] ^= t;
+      a[k | j] ^= t << j;
+    }
+  }
+}
+
+/* Turns BITSLICE_BLOCKS blocks, read as big-endian words, into 64 bitsliced
+ * words in DES bit order, and back. words is overwritten either way. */
+static void bitslice_load(word64* words, JBitslice* state)
+{
+  word64 bits[64][BITSLICE_LANES];
+
+  for (unsigned int lane = 0; lane < BITSLICE_LANES; ++lane) {
+    transpose64(words + lane * 64);
+    for (unsigned int i = 0; i < 64; ++i) {
+      bits[i][lane] = words[lane * 64 + i];
+    }
+  }
+
+  memcpy(state, bits, sizeof(bits));
+}
+
+static void bitslice_store(const JBitslice* state, word64* words)
+{
+  word64 bits[64][BITSLICE_LANES];
+
+  memcpy(bits, state, sizeof(bits));
+
+  for (unsigned int lane = 0; lane < BITSLICE_LANES; ++lane) {
+    for (unsigned int i = 0; i < 64; ++i) {
+      words[lane * 64 + i] = bits[i][lane];
+    }
+    transpose64(words + lane * 64);
+  }
+}
+
+/* Runs passes DESes over state, with the initial and final permutations
+ * around the lot since they cancel out in between. */
+static void bitslice_des_chain(JBitslice* state, const byte* leaves, const unsigned int passes)
+{
+  JBitslice lr[64];
+
+  for (unsigned int i = 0; i < 64; ++i) {
+    lr[i] = state[DES_IP[i] - 1];
+  }
+
+  // each DES ends without the last swap, so its R16 and L16 are the next
+  // one's L0 and R0
+  JBitslice* l = lr;
+  JBitslice* r = lr + 32;
+  for (unsigned int i = 0; i < passes; ++i) {
+    bitslice_des(l, r, leaves + i * DES_LEAVES_SIZE);
+    std::swap(l, r);
+  }
+
+  JBitslice preoutput[64];
+  memcpy(preoutput, l, 32 * sizeof(JBitslice));
+  memcpy(preoutput + 32, r, 32 * sizeof(JBitslice));
+
+  for (unsigned int i = 0; i < 64; ++i) {
+    state[i] = preoutput[DES_FP[i] - 1];
+  }
+}
+
+JBitslicedDES::JBitslicedDES(const BlockCipher& cipher, const enum CipherEnum type, const byte* key, const size_t length)
+  : itsCipher((BlockCipher*) cipher.Clone()), itsType(type), itsPasses(0)
+{
+  schedule(key, length);
+}
+
+JBitslicedDES::JBitslicedDES(const JBitslicedDES& other)
+  : BlockCipher(other), itsCipher((BlockCipher*) other.itsCipher->Clone()), itsType(other.itsType), itsLeaves(other.itsLeaves), itsPasses(other.itsPasses), itsPre(other.itsPre), itsPost(other.itsPost)
+{
+}
+
+std::string JBitslicedDES::AlgorithmProvider() const
+{
+#if defined(__GNUC__) && defined(__AVX2__)
+  return "AVX2 bitsliced";
+#elif defined(__GNUC__) && defined(__SSE2__)
+  return "SSE2 bitsliced";
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+  return "NEON bitsliced";
+#else
+  return "C++ bitsliced";
+#endif
+}
+
+void JBitslicedDES::UncheckedSetKey(const byte* key, unsigned int length, const NameValuePairs& params)
+{
+  itsCipher->SetKey(key, length, params);
+  schedule(key, length);
+}
+
+void JBitslicedDES::schedule(const byte* key, const size_t length)
+{
+  const bool decrypting = !itsCipher->IsForwardTransformation();
+
+  itsPre.resize(0);
+  itsPost.resize(0);
+
+  switch (itsType) {
+    case DES_CIPHER:
+      itsPasses = 1;
+      itsLeaves.New(DES_LEAVES_SIZE);
+      bitslice_des_schedule(key, decrypting, itsLeaves);
+      break;
+
+    case DES_EDE2_CIPHER:
+    case DES_EDE3_CIPHER: {
+      // E(k3) D(k2) E(k1) and the other way around, with k3 = k1 for EDE2
+      const byte* k1 = key;
+      const byte* k2 = key + 8;
+      const byte* k3 = (itsType == DES_EDE3_CIPHER && length >= 24) ? key + 16 : key;
+
+      itsPasses = 3;
+      itsLeaves.New(3 * DES_LEAVES_SIZE);
+      bitslice_des_schedule(decrypting ? k3 : k1, decrypting, itsLeaves);
+      bitslice_des_schedule(k2, !decrypting, itsLeaves + DES_LEAVES_SIZE);
+      bitslice_des_schedule(decrypting ? k1 : k3, decrypting, itsLeaves + 2 * DES_LEAVES_SIZE);
+      break;
+    }
+
+    case DES_XEX3_CIPHER:
+      // DES-X whitens with the first key going in and the last coming out
+      itsPasses = 1;
+      itsLeaves.New(DES_LEAVES_SIZE);
+      bitslice_des_schedule(key + 8, decrypting, itsLeaves);
+      itsPre.Assign(key + (decrypting ? 16 : 0), DES_BLOCK_SIZE);
+      itsPost.Assign(key + (decrypting ? 0 : 16), DES_BLOCK_SIZE);
+      break;
+
+    default:
+      throw JException("bitsliced DES only does DES, DES-EDE2, DES-EDE3 and DES-XEX3");
+  }
+}
+
+void JBitslicedDES::ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const
+{
+  itsCipher->ProcessAndXorBlock(inBlock, xorBlock, outBlock);
+}
+
+/* Whether the output lands partway into blocks that are read going
+ * forwards, so that later blocks are worked out from earlier outputs. */
+static bool chained(const byte* blocks, const byte* outBlocks, const size_t length)
+{
+  return blocks != NULL && blocks < outBlocks && outBlocks < blocks + length;
+}
+
+size_t JBitslicedDES::AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const
+{
+  const size_t blocks = length / DES_BLOCK_SIZE;
+  const bool counter = (flags & BT_InBlockIsCounter) != 0;
+
+  // chained calls like CBC-MAC feed each block's output into the next, and
+  // so do OFB and CFB encryption by writing each output block over the
+  // input of the one after it, which a pass would have read already
+  if ((flags & BT_DontIncrementInOutPointers) || blocks < BITSLICE_MIN_BLOCKS ||
+    (!(flags & BT_ReverseDirection) && (chained(inBlocks, outBlocks, counter ? DES_BLOCK_SIZE : length) || chained(xorBlocks, outBlocks, length)))
+  ) {
+    return itsCipher->AdvancedProcessBlocks(inBlocks, xorBlocks, outBlocks, length, flags);
+  }
+  const size_t passes = blocks / BITSLICE_BLOCKS + (blocks % BITSLICE_BLOCKS >= BITSLICE_MIN_BLOCKS ? 1 : 0);
+  const size_t sliced = STDMIN(blocks, passes * BITSLICE_BLOCKS);
+  const size_t tail = blocks - sliced;
+
+  // the counter only ever has its last byte bumped, the same as
+  // BlockTransformation does it, and the mode takes care of the carry
+  byte tailCounter[DES_BLOCK_SIZE];
+  const byte* tailIn = inBlocks + sliced * DES_BLOCK_SIZE;
+  if (counter) {
+    memcpy(tailCounter, inBlocks, DES_BLOCK_SIZE);
+    tailCounter[DES_BLOCK_SIZE - 1] += (byte) sliced;
+    tailIn = tailCounter;
+  }
+  const byte* tailXor = xorBlocks == NULL ? NULL : xorBlocks + sliced * DES_BLOCK_SIZE;
+  byte* tailOut = outBlocks + sliced * DES_BLOCK_SIZE;
+
+  // going backwards is how CBC decryption works in place, where each
+  // block's output overwrites the ciphertext the next block XORs with, so
+  // passes go from the end too and read everything before writing
+  if (flags & BT_ReverseDirection) {
+    if (tail > 0) {
+      itsCipher->AdvancedProcessBlocks(tailIn, tailXor, tailOut, tail * DES_BLOCK_SIZE, flags);
+    }
+    for (size_t pass = passes; pass-- > 0;) {
+      size_t first = pass * BITSLICE_BLOCKS;
+      processPass(inBlocks, xorBlocks, outBlocks, first, STDMIN((size_t) BITSLICE_BLOCKS, sliced - first), flags);
+    }
+  }
+  else {
+    for (size_t pass = 0; pass < passes; ++pass) {
+      size_t first = pass * BITSLICE_BLOCKS;
+      processPass(inBlocks, xorBlocks, outBlocks, first, STDMIN((size_t) BITSLICE_BLOCKS, sliced - first), flags);
+    }
+    if (tail > 0) {
+      itsCipher->AdvancedProcessBlocks(tailIn, tailXor, tailOut, tail * DES_BLOCK_SIZE, flags);
+    }
+  }
+
+  if (counter) {
+    const_cast<byte*>(inBlocks)[DES_BLOCK_SIZE - 1] += (byte) blocks;
+  }
+
+  return length % DES_BLOCK_SIZE;
+}
+
+void JBitslicedDES::processPass(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, const size_t first, const size_t blocks, const word32 flags) const
+{
+  const bool counter = (flags & BT_InBlockIsCounter) != 0;
+  const bool xorInput = xorBlocks != NULL && (flags & BT_XorInput);
+  const bool xorOutput = xorBlocks != NULL && !xorInput;
+
+  word64 words[BITSLICE_BLOCKS];
+  byte xorCopy[BITSLICE_BLOCKS * DES_BLOCK_SIZE];
+  JBitslice state[64];
+  byte block[DES_BLOCK_SIZE];
+
+  for (size_t i = 0; i < blocks; ++i) {
+    if (counter) {
+      memcpy(block, inBlocks, DES_BLOCK_SIZE);
+      block[DES_BLOCK_SIZE - 1] += (byte) (first + i);
+    }
+    else {
+      memcpy(block, inBlocks + (first + i) * DES_BLOCK_SIZE, DES_BLOCK_SIZE);
+    }
+
+    if (xorInput) {
+      xorbuf(block, xorBlocks + (first + i) * DES_BLOCK_SIZE, DES_BLOCK_SIZE);
+    }
+    if (itsPre.size() > 0) {
+      xorbuf(block, itsPre, DES_BLOCK_SIZE);
+    }
+
+    words[i] = GetWord<word64>(false, BIG_ENDIAN_ORDER, block);
+  }
+  for (size_t i = blocks; i < BITSLICE_BLOCKS; ++i) {
+    words[i] = 0;
+  }
+
+  // the output may well be on top of the blocks XORed into it
+  if (xorOutput) {
+    memcpy(xorCopy, xorBlocks + first * DES_BLOCK_SIZE, blocks * DES_BLOCK_SIZE);
+  }
+
+  bitslice_load(words, state);
+  bitslice_des_chain(state, itsLeaves, itsPasses);
+  bitslice_store(state, words);
+
+  for (size_t i = 0; i < blocks; ++i) {
+    byte* out = outBlocks + (first + i) * DES_BLOCK_SIZE;
+
+    PutWord(false, BIG_ENDIAN_ORDER, out, words[i]);
+    if (itsPost.size() > 0) {
+      xorbuf(out, itsPost, DES_BLOCK_SIZE);
+    }
+    if (xorOutput) {
+      xorbuf(out, xorCopy + i * DES_BLOCK_SIZE, DES_BLOCK_SIZE);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,86 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JBITSLICEDES_H__
+#define __JBITSLICEDES_H__
+
+#include <string>
+
+#include "jconfig.h"
+#include "jconstants.h"
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+#include "secblock.h"
+#include "smartptr.h"
+
+using namespace CryptoPP;
+
+// A bitsliced word holds one bit from each of BITSLICE_BLOCKS blocks. With
+// GCC and clang that's a whole SIMD register, so the kernel is built for
+// whatever the compiler is allowed to use, i.e. SSE2 on any x86-64 and
+// AVX2 with --enable-native on a CPU that has it.
+#if defined(__GNUC__) && defined(__AVX2__)
+typedef word64 JBitslice __attribute__((vector_size(32)));
+#elif defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON))
+typedef word64 JBitslice __attribute__((vector_size(16)));
+#else
+typedef word64 JBitslice;
+#endif
+
+#define BITSLICE_LANES (sizeof(JBitslice) / sizeof(word64))
+#define BITSLICE_BLOCKS (64 * BITSLICE_LANES)
+
+// DES, two and three key triple DES and DES-X, with runs of blocks
+// encrypted BITSLICE_BLOCKS at a time by a bitsliced implementation of
+// DES rather than through the usual tables. The key goes into the S-box
+// truth tables when keying, so the rounds are nothing but logic gates on
+// SIMD registers. Single blocks and short runs go to cipher, a copy of a
+// table-driven Crypto++ object for the same algorithm and direction, which
+// is also what's rekeyed alongside this.
+class JBitslicedDES : public BlockCipher
+{
+  public:
+    JBitslicedDES(const BlockCipher& cipher, const enum CipherEnum type, const byte* key, const size_t length);
+    JBitslicedDES(const JBitslicedDES& other);
+
+    std::string AlgorithmName() const { return itsCipher->AlgorithmName(); }
+    std::string AlgorithmProvider() const;
+    Clonable* Clone() const { return new JBitslicedDES(*this); }
+
+    size_t MinKeyLength() const { return itsCipher->MinKeyLength(); }
+    size_t MaxKeyLength() const { return itsCipher->MaxKeyLength(); }
+    size_t DefaultKeyLength() const { return itsCipher->DefaultKeyLength(); }
+    size_t GetValidKeyLength(size_t keylength) const { return itsCipher->GetValidKeyLength(keylength); }
+    IV_Requirement IVRequirement() const { return NOT_RESYNCHRONIZABLE; }
+
+    unsigned int BlockSize() const { return 8; }
+    bool IsForwardTransformation() const { return itsCipher->IsForwardTransformation(); }
+
+    void ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const;
+    size_t AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const;
+
+  protected:
+    void UncheckedSetKey(const byte* key, unsigned int length, const NameValuePairs& params);
+
+  private:
+    void schedule(const byte* key, const size_t length);
+    void processPass(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, const size_t first, const size_t blocks, const word32 flags) const;
+
+    member_ptr<BlockCipher> itsCipher;
+    enum CipherEnum itsType;
+
+    // one set of S-box truth tables per DES in the chain, and the DES-X
+    // whitening keys
+    SecByteBlock itsLeaves;
+    unsigned int itsPasses;
+    SecByteBlock itsPre;
+    SecByteBlock itsPost;
+};
+
+#endif
@@ -6,17 +6,26 @@
  */
 
 #include "jcamellia.h"
+#include "jmultiblock.h"
 
 #if ENABLED_CAMELLIA_CIPHER
 
 BlockCipher* JCamellia::getEncryptionObject()
 {
+#if ENABLED_MULTIBLOCK && MULTIBLOCK_GATHER
+  return new JCamelliaMultiBlock(CamelliaEncryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new CamelliaEncryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 BlockCipher* JCamellia::getDecryptionObject()
 {
+#if ENABLED_MULTIBLOCK && MULTIBLOCK_GATHER
+  return new JCamelliaMultiBlock(CamelliaDecryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new CamelliaDecryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
@@ -6,17 +6,26 @@
  */
 
 #include "jcast256.h"
+#include "jmultiblock.h"
 
 #if ENABLED_CAST256_CIPHER
 
 BlockCipher* JCAST256::getEncryptionObject()
 {
+#if ENABLED_MULTIBLOCK && MULTIBLOCK_GATHER
+  return new JCAST256MultiBlock(CAST256Encryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new CAST256Encryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 BlockCipher* JCAST256::getDecryptionObject()
 {
+#if ENABLED_MULTIBLOCK && MULTIBLOCK_GATHER
+  return new JCAST256MultiBlock(CAST256Decryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new CAST256Decryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
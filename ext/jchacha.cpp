@@ -0,0 +1,73 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jchacha.h"
+
+#if ENABLED_CHACHA20_CIPHER
+SymmetricCipher* JChaCha20::getEncryptionObject()
+{
+  SecByteBlock iv;
+  copyIV(iv, ChaChaTLS_Info::IV_LENGTH);
+  return new ChaChaTLS::Encryption((byte*) itsKey.data(), itsKeylength, iv.data());
+}
+
+SymmetricCipher* JChaCha20::getDecryptionObject()
+{
+  return getEncryptionObject();
+}
+#endif
+
+#if ENABLED_XCHACHA20_CIPHER
+SymmetricCipher* JXChaCha20::getEncryptionObject()
+{
+  SecByteBlock iv;
+  copyIV(iv, XChaCha20_Info::IV_LENGTH);
+  return new XChaCha20::Encryption((byte*) itsKey.data(), itsKeylength, iv.data());
+}
+
+SymmetricCipher* JXChaCha20::getDecryptionObject()
+{
+  return getEncryptionObject();
+}
+#endif
+
+#if ENABLED_CHACHA20_POLY1305_CIPHER || ENABLED_XCHACHA20_POLY1305_CIPHER
+/* Keys cipher under a zero nonce, as Crypto++ won't key it without one.
+ * The real nonce is set by resynchronizeAuthenticated() before each use. */
+static AuthenticatedSymmetricCipher* chacha_poly1305_key(AuthenticatedSymmetricCipher* cipher, const string& key, const unsigned int keylength)
+{
+  member_ptr<AuthenticatedSymmetricCipher> retval(cipher);
+  SecByteBlock iv;
+  iv.CleanNew(retval->IVSize());
+  retval->SetKeyWithIV((const byte*) key.data(), keylength, iv.data(), iv.size());
+  return retval.release();
+}
+#endif
+
+#if ENABLED_CHACHA20_POLY1305_CIPHER
+AuthenticatedSymmetricCipher* JChaCha20Poly1305::getEncryptionObject()
+{
+  return chacha_poly1305_key(new ChaCha20Poly1305::Encryption, itsKey, itsKeylength);
+}
+
+AuthenticatedSymmetricCipher* JChaCha20Poly1305::getDecryptionObject()
+{
+  return chacha_poly1305_key(new ChaCha20Poly1305::Decryption, itsKey, itsKeylength);
+}
+#endif
+
+#if ENABLED_XCHACHA20_POLY1305_CIPHER
+AuthenticatedSymmetricCipher* JXChaCha20Poly1305::getEncryptionObject()
+{
+  return chacha_poly1305_key(new XChaCha20Poly1305::Encryption, itsKey, itsKeylength);
+}
+
+AuthenticatedSymmetricCipher* JXChaCha20Poly1305::getDecryptionObject()
+{
+  return chacha_poly1305_key(new XChaCha20Poly1305::Decryption, itsKey, itsKeylength);
+}
+#endif
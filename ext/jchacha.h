@@ -0,0 +1,69 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JCHACHA_H__
+#define __JCHACHA_H__
+
+#include "jconfig.h"
+
+#if ENABLED_CHACHA20_CIPHER || ENABLED_XCHACHA20_CIPHER || ENABLED_CHACHA20_POLY1305_CIPHER || ENABLED_XCHACHA20_POLY1305_CIPHER
+
+#include "jstream_t.h"
+#include "jauthstream_t.h"
+
+// Crypto++ headers...
+
+#include "chacha.h"
+#include "chachapoly.h"
+
+using namespace CryptoPP;
+
+// ChaCha20 is the RFC 8439 version with a 96-bit nonce and a 32-bit block
+// counter, so seek can reach anywhere in the first 256G of keystream.
+// XChaCha20 takes a 192-bit nonce, which is big enough to be picked at
+// random. As of Crypto++ 8.2 both generate several blocks of keystream at
+// a time with SSE2, AVX2, NEON or Altivec where the CPU has them.
+#if ENABLED_CHACHA20_CIPHER
+class JChaCha20 : public JStream_Template<ChaChaTLS_Info, CHACHA20_CIPHER>
+{
+  protected:
+    SymmetricCipher* getEncryptionObject();
+    SymmetricCipher* getDecryptionObject();
+};
+#endif
+
+#if ENABLED_XCHACHA20_CIPHER
+class JXChaCha20 : public JStream_Template<XChaCha20_Info, XCHACHA20_CIPHER>
+{
+  protected:
+    SymmetricCipher* getEncryptionObject();
+    SymmetricCipher* getDecryptionObject();
+};
+#endif
+
+// The AEAD constructions from RFC 8439 and its XChaCha20 variant, with a
+// 16 byte Poly1305 tag.
+#if ENABLED_CHACHA20_POLY1305_CIPHER
+class JChaCha20Poly1305 : public JAuthenticatedStream_Template<ChaCha20Poly1305_Info, CHACHA20_POLY1305_CIPHER>
+{
+  protected:
+    AuthenticatedSymmetricCipher* getEncryptionObject();
+    AuthenticatedSymmetricCipher* getDecryptionObject();
+};
+#endif
+
+#if ENABLED_XCHACHA20_POLY1305_CIPHER
+class JXChaCha20Poly1305 : public JAuthenticatedStream_Template<XChaCha20Poly1305_Info, XCHACHA20_POLY1305_CIPHER>
+{
+  protected:
+    AuthenticatedSymmetricCipher* getEncryptionObject();
+    AuthenticatedSymmetricCipher* getDecryptionObject();
+};
+#endif
+
+#endif
+#endif
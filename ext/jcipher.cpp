@@ -6,11 +6,142 @@
  */
 
 #include "jcipher.h"
+#include "jmultibuffer.h"
+
+// Crypto++ headers...
+
+#include "smartptr.h"
+
+struct JBatchJob
+{
+  const JCipher* owner;
+  const BlockCipher* cipher;
+  enum ModeEnum mode;
+  bool decrypting;
+  StreamTransformationFilter::BlockPaddingScheme padding;
+  const string* iv;
+  const vector<string>* in;
+  const vector<string>* keys;
+  const vector<string>* ivs;
+  vector<string>* out;
+  vector<size_t> bounds;
+  const volatile bool* interrupted;
+};
+
+/* Copies an entry's IV into iv, zero-padded or truncated to size bytes. */
+static void batch_iv(JBatchJob* job, const size_t i, byte* iv, const size_t size)
+{
+  const string& from = job->ivs->empty() ? *job->iv : (*job->ivs)[i];
+  memset(iv, 0, size);
+  memcpy(iv, from.data(), STDMIN((size_t) from.length(), size));
+}
+
+/* CBC encryption of entries begin through end - 1 under a single key.
+ * Groups of entries have their whole blocks encrypted side by side with
+ * encryptCBCMultiBuffer(), then each entry's last partial block and padding
+ * go through mode, chained from where that left off. */
+static void batch_cbc_multi_buffer(JBatchJob* job, CipherModeBase& mode, const BlockCipher& cipher, const size_t begin, const size_t end)
+{
+  size_t blockSize = cipher.BlockSize();
+  SecByteBlock ivs(MULTI_BUFFER_LANES * blockSize);
+  const byte* in[MULTI_BUFFER_LANES];
+  byte* out[MULTI_BUFFER_LANES];
+  size_t blocks[MULTI_BUFFER_LANES];
+
+  for (size_t first = begin; first < end; first += MULTI_BUFFER_LANES) {
+    if (job->interrupted != NULL && *job->interrupted) {
+      throw JException("operation interrupted");
+    }
+
+    unsigned int count = (unsigned int) STDMIN((size_t) MULTI_BUFFER_LANES, end - first);
+
+    for (unsigned int k = 0; k < count; ++k) {
+      const string& entry = (*job->in)[first + k];
+      string& result = (*job->out)[first + k];
+
+      blocks[k] = entry.length() / blockSize;
+      result.resize(blocks[k] * blockSize);
+      in[k] = (const byte*) entry.data();
+      out[k] = result.empty() ? NULL : (byte*) &result[0];
+      batch_iv(job, first + k, ivs + k * blockSize, blockSize);
+    }
+
+    encryptCBCMultiBuffer(cipher, in, out, blocks, ivs, count);
+
+    for (unsigned int k = 0; k < count; ++k) {
+      const string& entry = (*job->in)[first + k];
+      size_t bulk = blocks[k] * blockSize;
+
+      mode.Resynchronize(ivs + k * blockSize, (int) blockSize);
+      StringSource source((const byte*) entry.data() + bulk, entry.length() - bulk, false, new StreamTransformationFilter(mode, new StringSink((*job->out)[first + k]), job->padding));
+      pumpAll(source, job->interrupted);
+    }
+  }
+}
+
+/* Runs entries begin through end - 1 of a batch through mode. If the job
+ * has keys, cipher is the object mode is bound to and gets rekeyed for each
+ * entry. */
+static void batch_process(JBatchJob* job, CipherModeBase& mode, BlockCipher* cipher, const size_t begin, const size_t end)
+{
+  // with one key schedule for everything, CBC messages can be encrypted
+  // side by side
+  if (job->mode == CBC_MODE && !job->decrypting && job->keys->empty()) {
+    batch_cbc_multi_buffer(job, mode, cipher != NULL ? *cipher : *job->cipher, begin, end);
+    return;
+  }
+
+  SecByteBlock iv;
+
+  for (size_t i = begin; i < end; ++i) {
+    if (job->interrupted != NULL && *job->interrupted) {
+      throw JException("operation interrupted");
+    }
+
+    if (!job->keys->empty()) {
+      job->owner->rekey(*cipher, (*job->keys)[i]);
+    }
+
+    if (mode.IsResynchronizable()) {
+      iv.New(mode.IVSize());
+      batch_iv(job, i, iv.data(), iv.size());
+      mode.Resynchronize(iv.data(), (int) iv.size());
+    }
+
+    string& out = (*job->out)[i];
+    out.erase();
+    StringSource source((*job->in)[i], false, new StreamTransformationFilter(mode, new StringSink(out), job->padding));
+    pumpAll(source, job->interrupted);
+  }
+}
+
+/* Processes one thread's share of a batch on its own copy of the cipher. */
+static void batch_segment(void* data, const unsigned int index)
+{
+  JBatchJob* job = (JBatchJob*) data;
+  size_t begin = job->bounds[index];
+  size_t end = job->bounds[index + 1];
+
+  if (begin >= end) {
+    return;
+  }
+
+  member_ptr<BlockCipher> cipher((BlockCipher*) job->cipher->Clone());
+  member_ptr<CipherModeBase> mode(JCipher::createMode(*cipher, job->mode, job->decrypting));
+
+  if (mode.get() == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  batch_process(job, *mode, cipher.get(), begin, end);
+}
 
 JCipher::JCipher()
 {
   itsMode = ECB_MODE;
   itsPadding = ZEROS_PADDING;
+  itsThreads = 1;
+  itsGCMTables = GCM_2K_Tables;
 }
 
 string JCipher::getModeName() const
@@ -33,6 +164,14 @@ string JCipher::getModeName(const enum ModeEnum mode)
       return "CTR";
     case OFB_MODE:
       return "OFB";
+    case GCM_MODE:
+      return "GCM";
+    case EAX_MODE:
+      return "EAX";
+    case OCB_MODE:
+      return "OCB";
+    case XTS_MODE:
+      return "XTS";
   }
 
   return "Unknown";
@@ -45,8 +184,21 @@ enum ModeEnum JCipher::getMode() const
 
 void JCipher::setMode(const enum ModeEnum mode)
 {
+  bool xts = (itsMode == XTS_MODE);
+
+  if (mode != itsMode) {
+    itsKeystream.clear();
+  }
+
   itsMode = mode;
   itsPadding = DEFAULT_PADDING;
+
+  // XTS keys are a data key and a tweak key back to back, so the valid
+  // lengths change and the objects get keyed with a different key
+  if (xts != (mode == XTS_MODE)) {
+    invalidateCipherObjects();
+    setKeylength(itsKeylength);
+  }
 }
 
 string JCipher::getPaddingName() const
@@ -90,6 +242,9 @@ enum PaddingEnum JCipher::setPadding(const enum PaddingEnum padding)
   if (padding == NO_PADDING && (itsMode == ECB_MODE || itsMode == CBC_MODE)) {
     return itsPadding;
   }
+  else if (padding != NO_PADDING && padding != DEFAULT_PADDING && (isAuthenticatedMode(itsMode) || itsMode == XTS_MODE)) {
+    return itsPadding;
+  }
   else if ((padding == PKCS_PADDING || padding == ONE_AND_ZEROS_PADDING) && (itsMode == CBC_CTS_MODE || itsMode == CTR_MODE || itsMode == OFB_MODE || itsMode == CFB_MODE)) {
     return itsPadding;
   }
@@ -106,7 +261,456 @@ unsigned int JCipher::getRounds() const
 
 unsigned int JCipher::setRounds(const unsigned int rounds)
 {
+  unsigned int previous = itsRounds;
+
   itsRounds = getValidRounds(rounds);
 
+  if (itsRounds != previous) {
+    invalidateCipherObjects();
+  }
+
   return itsRounds;
 }
+
+unsigned int JCipher::getThreads() const
+{
+  return itsThreads;
+}
+
+unsigned int JCipher::setThreads(const unsigned int threads)
+{
+  itsThreads = checkBounds(threads, 1, MAX_THREADS);
+
+  return itsThreads;
+}
+
+string JCipher::getGCMTablesName() const
+{
+  switch (itsGCMTables) {
+    case GCM_64K_Tables:
+      return "64K";
+    default:
+      return "2K";
+  }
+}
+
+GCM_TablesOption JCipher::getGCMTables() const
+{
+  return itsGCMTables;
+}
+
+GCM_TablesOption JCipher::setGCMTables(const GCM_TablesOption tables)
+{
+  if (tables != itsGCMTables) {
+    itsGCMTables = tables;
+    invalidateCipherObjects();
+  }
+  return itsGCMTables;
+}
+
+CipherModeBase* JCipher::createMode(BlockCipher& cipher, const enum ModeEnum mode, const bool decrypting)
+{
+  // the real IV gets set later with Resynchronize()
+  SecByteBlock iv;
+  iv.CleanNew(cipher.BlockSize());
+
+  if (decrypting) {
+    switch (mode) {
+      case ECB_MODE:
+        return new ECB_Mode_ExternalCipher::Decryption(cipher);
+
+      case CBC_MODE:
+        return new CBC_Mode_ExternalCipher::Decryption(cipher, iv.data());
+
+      case CBC_CTS_MODE:
+        return new CBC_CTS_Mode_ExternalCipher::Decryption(cipher, iv.data());
+
+      case CFB_MODE:
+        return new CFB_Mode_ExternalCipher::Decryption(cipher, iv.data());
+
+      case CTR_MODE:
+        return new CTR_Mode_ExternalCipher::Decryption(cipher, iv.data());
+
+      case OFB_MODE:
+        return new OFB_Mode_ExternalCipher::Decryption(cipher, iv.data());
+
+      default:
+        return NULL;
+    }
+  }
+  else {
+    switch (mode) {
+      case ECB_MODE:
+        return new ECB_Mode_ExternalCipher::Encryption(cipher);
+
+      case CBC_MODE:
+        return new CBC_Mode_ExternalCipher::Encryption(cipher, iv.data());
+
+      case CBC_CTS_MODE:
+        return new CBC_CTS_Mode_ExternalCipher::Encryption(cipher, iv.data());
+
+      case CFB_MODE:
+        return new CFB_Mode_ExternalCipher::Encryption(cipher, iv.data());
+
+      case CTR_MODE:
+        return new CTR_Mode_ExternalCipher::Encryption(cipher, iv.data());
+
+      case OFB_MODE:
+        return new OFB_Mode_ExternalCipher::Encryption(cipher, iv.data());
+
+      default:
+        return NULL;
+    }
+  }
+}
+
+bool JCipher::decryptsForward(const enum ModeEnum mode)
+{
+  switch (mode) {
+    case CFB_MODE:
+    case CTR_MODE:
+    case OFB_MODE:
+    case GCM_MODE:
+    case EAX_MODE:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+bool JCipher::isAuthenticatedMode(const enum ModeEnum mode)
+{
+  return mode == GCM_MODE || mode == EAX_MODE || mode == OCB_MODE;
+}
+
+bool JCipher::preservesLength(const enum ModeEnum mode)
+{
+  switch (mode) {
+    case CBC_CTS_MODE:
+    case CFB_MODE:
+    case CTR_MODE:
+    case OFB_MODE:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+AlgorithmParameters JCipher::getKeyParameters() const
+{
+  // ciphers with a fixed number of rounds have itsRounds set to 0
+  if (itsRounds > 0) {
+    return MakeParameters(Name::Rounds(), (int) itsRounds, false);
+  }
+  else {
+    return AlgorithmParameters();
+  }
+}
+
+void JCipher::rekey(BlockCipher& cipher, const string& key) const
+{
+  cipher.SetKey((const byte*) key.data(), key.length(), getKeyParameters());
+}
+
+AuthenticatedSymmetricCipher* JCipher::createAuthenticatedMode(const BlockCipher& cipher, const BlockCipher* inverse, const bool decrypting) const
+{
+  member_ptr<AuthenticatedSymmetricCipher> retval;
+
+  switch (itsMode) {
+    case GCM_MODE:
+      retval.reset(new JGCM(cipher, itsGCMTables, !decrypting));
+      break;
+
+    case EAX_MODE:
+      retval.reset(new JEAX(cipher, !decrypting));
+      break;
+
+    case OCB_MODE:
+#if HAVE_JOCB
+      if (decrypting && inverse == NULL) {
+        return NULL;
+      }
+      retval.reset(new JOCB(cipher, decrypting ? inverse : NULL));
+      break;
+#else
+      throw JException("OCB mode needs Crypto++ 6.0 or later");
+#endif
+
+    default:
+      return NULL;
+  }
+
+  // keying needs an IV, the real one gets set later with
+  // resynchronizeAuthenticated()
+  SecByteBlock iv;
+  iv.CleanNew(retval->IVSize());
+  retval->SetKey((const byte*) itsKey.data(), itsKeylength, getKeyParameters()(Name::IV(), ConstByteArrayParameter(iv.data(), iv.size()), false));
+
+  return retval.release();
+}
+
+void JCipher::resynchronizeAuthenticatedMode(AuthenticatedSymmetricCipher& cipher) const
+{
+#if HAVE_JOCB
+  // OCB mixes the tag length into the nonce
+  if (itsMode == OCB_MODE) {
+    static_cast<JOCB&>(cipher).setTagLength(itsTagLength);
+  }
+#endif
+
+  resynchronizeAuthenticated(cipher);
+}
+
+unsigned int JCipher::getParallelThreads(const size_t length) const
+{
+  return (unsigned int) STDMIN((size_t) itsThreads, length / PARALLEL_MIN_SEGMENT_SIZE);
+}
+
+bool JCipher::encryptInParallel(const BlockCipher& cipher, const byte* in, const size_t length, byte* out, const volatile bool* interrupted) const
+{
+  unsigned int threads = getParallelThreads(length);
+
+  if (itsMode != CTR_MODE || threads < 2) {
+    return false;
+  }
+
+  SecByteBlock iv;
+  copyIV(iv, cipher.BlockSize());
+
+  processCTRInParallel(cipher, iv.data(), 0, in, out, length, threads, interrupted);
+
+  return true;
+}
+
+bool JCipher::decryptInParallel(const BlockCipher& cipher, CipherModeBase& mode, const byte* in, const size_t length, byte* out, size_t& written, const volatile bool* interrupted) const
+{
+  size_t blockSize = cipher.BlockSize();
+  SecByteBlock iv;
+
+  switch (itsMode) {
+    case CTR_MODE:
+      written = length;
+      return encryptInParallel(cipher, in, length, out, interrupted);
+
+    case ECB_MODE:
+      return processECBInParallel(cipher, mode, in, length, out, written, true, interrupted);
+
+    case CBC_MODE:
+    case CBC_CTS_MODE:
+    case CFB_MODE:
+    {
+      // the last couple of blocks are left to the usual filter so padding
+      // and ciphertext stealing are handled as before
+      size_t tail = 2 * blockSize + length % blockSize;
+
+      if (length <= tail) {
+        return false;
+      }
+
+      size_t bulk = length - tail;
+      unsigned int threads = getParallelThreads(bulk);
+
+      if (threads < 2) {
+        return false;
+      }
+
+      copyIV(iv, blockSize);
+      decryptChainedInParallel(cipher, itsMode, iv.data(), in, out, bulk, threads, interrupted);
+
+      mode.Resynchronize(in + bulk - blockSize, (int) blockSize);
+      ArraySink* sink = new ArraySink(out + bulk, tail);
+      StringSource source(in + bulk, tail, false, new StreamTransformationFilter(mode, sink, (StreamTransformationFilter::BlockPaddingScheme) itsPadding));
+      pumpAll(source, interrupted);
+      written = bulk + (size_t) sink->TotalPutLength();
+
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+bool JCipher::processECBInParallel(const BlockCipher& cipher, CipherModeBase& mode, const byte* in, const size_t length, byte* out, size_t& written, const bool decrypting, const volatile bool* interrupted) const
+{
+  unsigned int threads = getParallelThreads(length);
+
+  if (itsMode != ECB_MODE || threads < 2) {
+    return false;
+  }
+
+  size_t blockSize = cipher.BlockSize();
+  size_t bulk = (length - 1) / blockSize * blockSize;
+  size_t tail = 0;
+
+  // the member function hides the one in jparallel.h
+  ::processECBInParallel(cipher, in, out, bulk, threads, interrupted);
+  processDirect(mode, in + bulk, length - bulk, out + bulk, tail, decrypting, interrupted);
+  written = bulk + tail;
+
+  return true;
+}
+
+bool JCipher::processDirect(CipherModeBase& mode, const byte* in, const size_t length, byte* out, size_t& written, const bool decrypting, const volatile bool* interrupted) const
+{
+  switch (itsMode) {
+    case CFB_MODE:
+    case CTR_MODE:
+    case OFB_MODE:
+      // any length goes and there's no padding
+      processAll(mode, in, out, length, interrupted);
+      written = length;
+      return true;
+
+    case ECB_MODE:
+    case CBC_MODE:
+      break;
+
+    default:
+      return false;
+  }
+
+  size_t blockSize = mode.MandatoryBlockSize();
+  size_t remainder = length % blockSize;
+  enum PaddingEnum padding = (itsPadding == DEFAULT_PADDING) ? PKCS_PADDING : itsPadding;
+
+  if (decrypting) {
+    if (remainder != 0 || (length == 0 && (padding == PKCS_PADDING || padding == ONE_AND_ZEROS_PADDING))) {
+      throw InvalidCiphertext("StreamTransformationFilter: ciphertext length is not a multiple of block size");
+    }
+
+    processAll(mode, in, out, length, interrupted);
+    written = length;
+
+    // zeroes are never taken off, since there's no telling them apart from
+    // the message
+    if (padding == PKCS_PADDING) {
+      byte pad = out[length - 1];
+      if (pad < 1 || pad > blockSize) {
+        throw InvalidCiphertext("StreamTransformationFilter: invalid PKCS #7 block padding found");
+      }
+      for (size_t i = length - pad; i < length; ++i) {
+        if (out[i] != pad) {
+          throw InvalidCiphertext("StreamTransformationFilter: invalid PKCS #7 block padding found");
+        }
+      }
+      written = length - pad;
+    }
+    else if (padding == ONE_AND_ZEROS_PADDING) {
+      size_t end = length;
+      while (end > length - blockSize + 1 && out[end - 1] == 0) {
+        --end;
+      }
+      if (out[end - 1] != 0x80) {
+        throw InvalidCiphertext("StreamTransformationFilter: invalid ones-and-zeros padding found");
+      }
+      written = end - 1;
+    }
+
+    return true;
+  }
+
+  size_t bulk = length - remainder;
+  processAll(mode, in, out, bulk, interrupted);
+  written = bulk;
+
+  if (remainder == 0 && (padding == NO_PADDING || padding == ZEROS_PADDING)) {
+    return true;
+  }
+  else if (padding == NO_PADDING) {
+    throw InvalidDataFormat("StreamTransformationFilter: plaintext length is not a multiple of block size and NO_PADDING is specified");
+  }
+
+  SecByteBlock last(blockSize);
+  memcpy(last.data(), in + bulk, remainder);
+
+  if (padding == PKCS_PADDING) {
+    memset(last.data() + remainder, (int) (blockSize - remainder), blockSize - remainder);
+  }
+  else {
+    last[remainder] = (padding == ONE_AND_ZEROS_PADDING) ? 0x80 : 0;
+    memset(last.data() + remainder + 1, 0, blockSize - remainder - 1);
+  }
+
+  mode.ProcessData(out + bulk, last.data(), blockSize);
+  written += blockSize;
+
+  return true;
+}
+
+BufferedTransformation* JCipher::createDecryptionFilter(const BlockCipher& cipher, CipherModeBase& mode, BufferedTransformation* attachment) const
+{
+  if (itsThreads > 1 && (itsMode == CBC_MODE || itsMode == CBC_CTS_MODE || itsMode == CFB_MODE)) {
+    SecByteBlock iv;
+    copyIV(iv, cipher.BlockSize());
+    return new JParallelDecryptionFilter(cipher, mode, itsMode, iv.data(), itsThreads, (StreamTransformationFilter::BlockPaddingScheme) itsPadding, attachment);
+  }
+  else {
+    return new StreamTransformationFilter(mode, attachment, (StreamTransformationFilter::BlockPaddingScheme) itsPadding);
+  }
+}
+
+void JCipher::processBlockBatch(const BlockCipher& cipher, CipherModeBase& mode, const vector<string>& in, const vector<string>& keys, const vector<string>& ivs, vector<string>& out, const bool decrypting, const volatile bool* interrupted) const
+{
+  if ((!keys.empty() && keys.size() != in.size()) || (!ivs.empty() && ivs.size() != in.size())) {
+    throw JException("the number of keys or IVs doesn't match the number of entries");
+  }
+
+  // keys are cut or padded to a valid length the same way setKey() does
+  vector<string> validKeys(keys);
+  for (size_t i = 0; i < validKeys.size(); ++i) {
+    validKeys[i].resize(getValidKeylength(validKeys[i].length()));
+  }
+
+  JBatchJob job;
+  job.owner = this;
+  job.cipher = &cipher;
+  job.mode = itsMode;
+  job.decrypting = decrypting;
+  job.padding = (StreamTransformationFilter::BlockPaddingScheme) itsPadding;
+  job.iv = &itsIV;
+  job.in = &in;
+  job.keys = &validKeys;
+  job.ivs = &ivs;
+  job.out = &out;
+  job.interrupted = interrupted;
+
+  out.resize(in.size());
+
+  size_t total = 0;
+  for (size_t i = 0; i < in.size(); ++i) {
+    total += in[i].length();
+  }
+
+  unsigned int threads = (unsigned int) STDMIN((size_t) getParallelThreads(total), in.size());
+
+  if (threads < 2) {
+    if (keys.empty()) {
+      batch_process(&job, mode, NULL, 0, in.size());
+    }
+    else {
+      // the cached cipher objects are left alone and a copy is rekeyed
+      job.bounds.push_back(0);
+      job.bounds.push_back(in.size());
+      batch_segment(&job, 0);
+    }
+    return;
+  }
+
+  // entries are handed out in runs of about the same number of bytes
+  size_t done = 0;
+  job.bounds.push_back(0);
+  for (size_t i = 0; i < in.size() && job.bounds.size() < threads; ++i) {
+    done += in[i].length();
+    if (done * threads >= total * job.bounds.size()) {
+      job.bounds.push_back(i + 1);
+    }
+  }
+  while (job.bounds.size() <= threads) {
+    job.bounds.push_back(in.size());
+  }
+
+  runInParallel(batch_segment, &job, threads);
+}
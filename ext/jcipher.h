@@ -9,6 +9,11 @@
 #define __JCIPHER_H__
 
 #include "jbase.h"
+#include "jparallel.h"
+#include "jgcm.h"
+#include "jeax.h"
+#include "jocb.h"
+#include "jxts.h"
 
 // Crypto++ headers...
 
@@ -33,10 +38,100 @@ class JCipher : public JBase
     unsigned int setRounds(const unsigned int rounds);
     virtual unsigned int getValidRounds(const unsigned int rounds) const = 0;
 
+    unsigned int getThreads() const;
+    unsigned int setThreads(const unsigned int threads);
+
+    // The size of the GHASH tables used in GCM mode, 2K or 64K.
+    string getGCMTablesName() const;
+    GCM_TablesOption getGCMTables() const;
+    GCM_TablesOption setGCMTables(const GCM_TablesOption tables);
+
+    // Encrypts or decrypts in as consecutive sectors of sectorSize bytes in
+    // XTS mode, the first of which is sector number firstSector. The
+    // sectors are spread over itsThreads threads if there are enough of
+    // them.
+    virtual void processSectors(const string& in, string& out, const word64 firstSector, const size_t sectorSize, const bool decrypting, const volatile bool* interrupted = NULL) = 0;
+
+    // Decrypts in, which is the part of a CTR mode ciphertext starting at
+    // byte offset, without going through anything before it. The cipher's
+    // plaintext and ciphertext are left alone.
+    virtual void decryptRange(const string& in, string& out, const lword offset, const volatile bool* interrupted = NULL) = 0;
+
+    // Builds a mode object around cipher with an all zero IV.
+    static CipherModeBase* createMode(BlockCipher& cipher, const enum ModeEnum mode, const bool decrypting);
+
+    // CFB, CTR, OFB, GCM and EAX decrypt with the forward direction of the
+    // cipher.
+    static bool decryptsForward(const enum ModeEnum mode);
+
+    // Whether mode is one of the authenticated modes, which go through
+    // createAuthenticatedMode() rather than createMode().
+    static bool isAuthenticatedMode(const enum ModeEnum mode);
+
+    // Whether mode always produces as many bytes as it's given, so
+    // processInPlace() can use it: CFB, CTR, OFB and CBC with CTS.
+    static bool preservesLength(const enum ModeEnum mode);
+
+    // Sets a new key of a valid length on a copy of one of the cipher
+    // objects, keeping the rounds and whatever else the cipher was created
+    // with. Must be safe to call from any thread.
+    void rekey(BlockCipher& cipher, const string& key) const;
+
   protected:
+    // Extra parameters for keying a block cipher the same way
+    // getEncryptionObject() does, such as the rounds.
+    virtual AlgorithmParameters getKeyParameters() const;
+
+    // Builds and keys the authenticated mode object for itsMode around a
+    // copy of cipher, which is always the encryption object. inverse is the
+    // decryption object, given when decrypting in modes that don't
+    // decryptsForward(), i.e. OCB.
+    AuthenticatedSymmetricCipher* createAuthenticatedMode(const BlockCipher& cipher, const BlockCipher* inverse, const bool decrypting) const;
+
+    // Sets the IV on an authenticated mode object along with anything else
+    // the mode needs per message.
+    void resynchronizeAuthenticatedMode(AuthenticatedSymmetricCipher& cipher) const;
+
+    // How many threads a job of length bytes gets, 1 or 0 meaning it isn't
+    // worth splitting up.
+    unsigned int getParallelThreads(const size_t length) const;
+
+    // Encrypt or decrypt in over itsThreads threads if the mode allows it.
+    // Return false without doing anything if it doesn't or the job is too
+    // small. cipher is the block cipher mode is bound to.
+    // decryptInParallel sets written to the length of the plaintext.
+    bool encryptInParallel(const BlockCipher& cipher, const byte* in, const size_t length, byte* out, const volatile bool* interrupted) const;
+    bool decryptInParallel(const BlockCipher& cipher, CipherModeBase& mode, const byte* in, const size_t length, byte* out, size_t& written, const volatile bool* interrupted) const;
+
+    // The ECB version of the above, for either direction. Everything but
+    // the last block is split up, and that one goes through processDirect()
+    // for the padding.
+    bool processECBInParallel(const BlockCipher& cipher, CipherModeBase& mode, const byte* in, const size_t length, byte* out, size_t& written, const bool decrypting, const volatile bool* interrupted) const;
+
+    // Encrypts or decrypts in into out by calling ProcessData() on mode
+    // directly and doing the padding here, rather than building a
+    // StreamTransformationFilter chain for a message that's already in
+    // memory. The result is the same as the filter's. Returns false without
+    // doing anything for CBC with CTS, which is left to the filter.
+    bool processDirect(CipherModeBase& mode, const byte* in, const size_t length, byte* out, size_t& written, const bool decrypting, const volatile bool* interrupted) const;
+
+    // The filter used for decrypting a RubyIO, which decrypts in parallel
+    // where it can.
+    BufferedTransformation* createDecryptionFilter(const BlockCipher& cipher, CipherModeBase& mode, BufferedTransformation* attachment) const;
+
+    // The block cipher version of processBatch(). Entries are run through
+    // mode one after the other, or spread over itsThreads threads with
+    // their own copies of cipher if the batch is big enough. Per entry keys
+    // are always applied to copies so the cached objects stay as they are,
+    // one full rekey() per entry; key schedules aren't interleaved across
+    // entries.
+    void processBlockBatch(const BlockCipher& cipher, CipherModeBase& mode, const vector<string>& in, const vector<string>& keys, const vector<string>& ivs, vector<string>& out, const bool decrypting, const volatile bool* interrupted) const;
+
     enum ModeEnum itsMode;
     enum PaddingEnum itsPadding;
     unsigned int itsRounds;
+    unsigned int itsThreads;
+    GCM_TablesOption itsGCMTables;
 };
 
 #endif
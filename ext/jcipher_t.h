@@ -15,17 +15,25 @@ class JCipher_Template : public JBasicCipherInfo<INFO, JCipher>
 {
   public:
     JCipher_Template();
+    virtual ~JCipher_Template();
 
+    unsigned int getValidKeylength(const unsigned int length) const;
     inline unsigned int getValidRounds(const unsigned int rounds) const;
     inline enum CipherEnum getCipherType() const;
     inline unsigned int getBlockSize() const;
+    string getImplementationName();
 
-    bool encrypt();
-    bool decrypt();
+    size_t processMessage(const byte* in, const size_t length, byte* out, const bool decrypting, const volatile bool* interrupted = NULL);
+    void processInPlace(byte* data, const size_t length, const bool decrypting, const volatile bool* interrupted = NULL);
 
     bool encryptRubyIO(VALUE* in, VALUE* out);
     bool decryptRubyIO(VALUE* in, VALUE* out);
 
+    void processBatch(const vector<string>& in, const vector<string>& keys, const vector<string>& ivs, vector<string>& out, const bool decrypting, const volatile bool* interrupted = NULL);
+    void processSectors(const string& in, string& out, const word64 firstSector, const size_t sectorSize, const bool decrypting, const volatile bool* interrupted = NULL);
+    void decryptRange(const string& in, string& out, const lword offset, const volatile bool* interrupted = NULL);
+    void precomputeKeystream(const size_t length, const bool background, const volatile bool* interrupted = NULL);
+
     /* These are deprecated. They were used before using RubyIO. Use them
        if you're using this code in something other than the CryptoPP Ruby
        extension... */
@@ -33,8 +41,51 @@ class JCipher_Template : public JBasicCipherInfo<INFO, JCipher>
 //     bool decryptFile(const string in, const string out);
 
   protected:
+    // For ciphers with versions built for their default number of rounds.
+    static const unsigned int DEFAULT_ROUND_COUNT = DEFAULT_ROUNDS;
+
     virtual BlockCipher* getEncryptionObject() = 0;
     virtual BlockCipher* getDecryptionObject() = 0;
+
+    // Calls getEncryptionObject() or getDecryptionObject(), which only get
+    // the data half of the key in XTS mode.
+    BlockCipher* createCipherObject(const bool decrypting);
+
+    // The key schedules and mode objects are built lazily and kept around
+    // between calls until the key, key length or rounds change. The mode
+    // objects are rebuilt on their own if only the block mode changes.
+    CipherModeBase* getEncryptionMode();
+    CipherModeBase* getDecryptionMode();
+    BlockCipher* getDecryptionModeCipher() const;
+
+    // The same for the authenticated modes, resynchronized with itsIV.
+    AuthenticatedSymmetricCipher* getAuthenticatedMode(const bool decrypting);
+
+    // processMessage() for the plain block modes, with or without a MAC.
+    size_t encryptMessage(const byte* in, const size_t length, byte* out, const volatile bool* interrupted);
+    size_t decryptMessage(const byte* in, const size_t length, byte* out, const volatile bool* interrupted);
+
+    // Decrypts in into out with a plain block mode.
+    size_t decryptUnauthenticated(CipherModeBase& cipher, const byte* in, const size_t length, byte* out, const volatile bool* interrupted);
+
+    // Runs in through XTS with the data and tweak objects, starting with
+    // the 16 byte tweak value.
+    void processXTSUnits(const byte* in, const size_t length, byte* out, const byte* tweak, const size_t sectorSize, const bool decrypting, const unsigned int threads, const volatile bool* interrupted);
+
+    void invalidateCipherObjects();
+    BufferedTransformation* createStreamFilter(const bool decrypting, BufferedTransformation* sink);
+
+    BlockCipher* itsEncryptionObject;
+    BlockCipher* itsDecryptionObject;
+    BlockCipher* itsTweakObject;
+    CipherModeBase* itsEncryptionMode;
+    CipherModeBase* itsDecryptionMode;
+    enum ModeEnum itsEncryptionModeType;
+    enum ModeEnum itsDecryptionModeType;
+    AuthenticatedSymmetricCipher* itsEncryptionAuthenticatedMode;
+    AuthenticatedSymmetricCipher* itsDecryptionAuthenticatedMode;
+    enum ModeEnum itsEncryptionAuthenticatedModeType;
+    enum ModeEnum itsDecryptionAuthenticatedModeType;
 };
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
@@ -42,283 +93,704 @@ JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::JCipher_Te
 {
   this->itsKeylength = INFO::DEFAULT_KEYLENGTH;
   this->itsRounds = DEFAULT_ROUNDS;
+
+  itsEncryptionObject = NULL;
+  itsDecryptionObject = NULL;
+  itsTweakObject = NULL;
+  itsEncryptionMode = NULL;
+  itsDecryptionMode = NULL;
+  itsEncryptionModeType = UNKNOWN_MODE;
+  itsDecryptionModeType = UNKNOWN_MODE;
+  itsEncryptionAuthenticatedMode = NULL;
+  itsDecryptionAuthenticatedMode = NULL;
+  itsEncryptionAuthenticatedModeType = UNKNOWN_MODE;
+  itsDecryptionAuthenticatedModeType = UNKNOWN_MODE;
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-unsigned int JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getValidRounds(const unsigned int rounds) const
+JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::~JCipher_Template()
 {
-  return checkBounds(rounds, MIN_ROUNDS, MAX_ROUNDS);
+  invalidateCipherObjects();
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-CipherEnum JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getCipherType() const
+void JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::invalidateCipherObjects()
 {
-  return TYPE;
+  // an unfinished stream refers to the mode objects, and the mode objects
+  // hold references to the block ciphers, so they go in that order
+  this->endStream();
+  this->itsKeystream.clear();
+  delete itsEncryptionAuthenticatedMode;
+  delete itsDecryptionAuthenticatedMode;
+  delete itsEncryptionMode;
+  delete itsDecryptionMode;
+  delete itsEncryptionObject;
+  delete itsDecryptionObject;
+  delete itsTweakObject;
+
+  itsEncryptionObject = NULL;
+  itsDecryptionObject = NULL;
+  itsTweakObject = NULL;
+  itsEncryptionMode = NULL;
+  itsDecryptionMode = NULL;
+  itsEncryptionModeType = UNKNOWN_MODE;
+  itsDecryptionModeType = UNKNOWN_MODE;
+  itsEncryptionAuthenticatedMode = NULL;
+  itsDecryptionAuthenticatedMode = NULL;
+  itsEncryptionAuthenticatedModeType = UNKNOWN_MODE;
+  itsDecryptionAuthenticatedModeType = UNKNOWN_MODE;
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-unsigned int JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getBlockSize() const
+unsigned int JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getValidKeylength(const unsigned int length) const
 {
-  return INFO::BLOCKSIZE;
+  // XTS takes two keys of the same length
+  if (this->itsMode == XTS_MODE) {
+    return 2 * INFO::StaticGetValidKeyLength(length / 2);
+  }
+  else {
+    return INFO::StaticGetValidKeyLength(length);
+  }
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::encrypt()
+BlockCipher* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::createCipherObject(const bool decrypting)
 {
-  BlockCipher* bc = NULL;
-  CipherModeBase* cipher = NULL;
+  if (this->itsMode != XTS_MODE) {
+    return decrypting ? getDecryptionObject() : getEncryptionObject();
+  }
 
-  bc = getEncryptionObject();
+  // the tweak key at the back is simply left out
+  unsigned int keylength = this->itsKeylength;
+  BlockCipher* retval = NULL;
 
-  if (bc != NULL) {
-    switch (this->itsMode) {
-      case ECB_MODE:
-        cipher = new ECB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  this->itsKeylength = keylength / 2;
+  try {
+    retval = decrypting ? getDecryptionObject() : getEncryptionObject();
+  }
+  catch (...) {
+    this->itsKeylength = keylength;
+    throw;
+  }
+  this->itsKeylength = keylength;
 
-      case CBC_MODE:
-        cipher = new CBC_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  return retval;
+}
 
-      case CBC_CTS_MODE:
-        cipher = new CBC_CTS_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+CipherModeBase* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getEncryptionMode()
+{
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
 
-      case CFB_MODE:
-        cipher = new CFB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  if (itsEncryptionMode == NULL || itsEncryptionModeType != this->itsMode) {
+    delete itsEncryptionMode;
+    itsEncryptionMode = NULL;
+    itsEncryptionModeType = UNKNOWN_MODE;
 
-      case CTR_MODE:
-        cipher = new CTR_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+    if (itsEncryptionObject == NULL) {
+      itsEncryptionObject = createCipherObject(false);
+      if (itsEncryptionObject == NULL) {
+        return NULL;
+      }
+    }
 
-      case OFB_MODE:
-        cipher = new OFB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+    itsEncryptionMode = this->createMode(*itsEncryptionObject, this->itsMode, false);
+    if (itsEncryptionMode == NULL) {
+      return NULL;
+    }
 
-      default:
-        return false;
+    itsEncryptionModeType = this->itsMode;
+  }
+
+  this->resynchronize(itsEncryptionMode);
+
+  return itsEncryptionMode;
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+CipherModeBase* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getDecryptionMode()
+{
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
+
+  if (itsDecryptionMode == NULL || itsDecryptionModeType != this->itsMode) {
+    delete itsDecryptionMode;
+    itsDecryptionMode = NULL;
+    itsDecryptionModeType = UNKNOWN_MODE;
+
+    BlockCipher* bc = NULL;
+
+    if (this->decryptsForward(this->itsMode)) {
+      if (itsEncryptionObject == NULL) {
+        itsEncryptionObject = createCipherObject(false);
+      }
+      bc = itsEncryptionObject;
+    }
+    else {
+      if (itsDecryptionObject == NULL) {
+        itsDecryptionObject = createCipherObject(true);
+      }
+      bc = itsDecryptionObject;
     }
 
-    this->itsCiphertext.erase();
-    StringSource(this->itsPlaintext, true, new StreamTransformationFilter(*cipher, new StringSink(this->itsCiphertext), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+    if (bc == NULL) {
+      return NULL;
+    }
 
-    delete bc;
+    itsDecryptionMode = this->createMode(*bc, this->itsMode, true);
+    if (itsDecryptionMode == NULL) {
+      return NULL;
+    }
+
+    itsDecryptionModeType = this->itsMode;
+  }
+
+  this->resynchronize(itsDecryptionMode);
+
+  return itsDecryptionMode;
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+BlockCipher* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getDecryptionModeCipher() const
+{
+  if (this->decryptsForward(itsDecryptionModeType)) {
+    return itsEncryptionObject;
   }
   else {
-    return false;
+    return itsDecryptionObject;
   }
+}
 
-  if (cipher != NULL) {
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+AuthenticatedSymmetricCipher* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getAuthenticatedMode(const bool decrypting)
+{
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
+  else if (this->itsMAC != NULL) {
+    throw JException("authenticated block modes can't be combined with a MAC");
+  }
+
+  AuthenticatedSymmetricCipher*& cipher = decrypting ? itsDecryptionAuthenticatedMode : itsEncryptionAuthenticatedMode;
+  enum ModeEnum& type = decrypting ? itsDecryptionAuthenticatedModeType : itsEncryptionAuthenticatedModeType;
+
+  if (cipher == NULL || type != this->itsMode) {
     delete cipher;
+    cipher = NULL;
+    type = UNKNOWN_MODE;
+
+    if (itsEncryptionObject == NULL) {
+      itsEncryptionObject = createCipherObject(false);
+      if (itsEncryptionObject == NULL) {
+        return NULL;
+      }
+    }
+
+    BlockCipher* inverse = NULL;
+
+    if (decrypting && !this->decryptsForward(this->itsMode)) {
+      if (itsDecryptionObject == NULL) {
+        itsDecryptionObject = createCipherObject(true);
+        if (itsDecryptionObject == NULL) {
+          return NULL;
+        }
+      }
+      inverse = itsDecryptionObject;
+    }
+
+    cipher = this->createAuthenticatedMode(*itsEncryptionObject, inverse, decrypting);
+    if (cipher == NULL) {
+      return NULL;
+    }
+
+    type = this->itsMode;
   }
 
-  return true;
+  this->resynchronizeAuthenticatedMode(*cipher);
+
+  return cipher;
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::decrypt()
+BufferedTransformation* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::createStreamFilter(const bool decrypting, BufferedTransformation* sink)
 {
-  BlockCipher* bc = NULL;
-  CipherModeBase* cipher = NULL;
+  if (this->itsMode == XTS_MODE) {
+    delete sink;
+    throw JException("XTS works on whole data units; use encrypt, decrypt or the sector methods");
+  }
 
-  switch (this->itsMode) {
-    case ECB_MODE:
-    case CBC_MODE:
-    case CBC_CTS_MODE:
-      bc = getDecryptionObject();
-    break;
+  if (this->isAuthenticatedMode(this->itsMode)) {
+    AuthenticatedSymmetricCipher* cipher = NULL;
 
-    case CFB_MODE:
-    case CTR_MODE:
-    case OFB_MODE:
-      bc = getEncryptionObject();
-    break;
+    try {
+      cipher = getAuthenticatedMode(decrypting);
+    }
+    catch (...) {
+      delete sink;
+      throw;
+    }
 
-    default:
-      return false;
+    if (cipher == NULL) {
+      delete sink;
+      return NULL;
+    }
+
+    return this->createAuthenticatedFilter(*cipher, decrypting, sink);
   }
 
-  if (bc != NULL) {
-    switch (this->itsMode) {
-      case ECB_MODE:
-        cipher = new ECB_Mode_ExternalCipher::Decryption(*bc);
-      break;
+  CipherModeBase* cipher = NULL;
 
-      case CBC_MODE:
-        cipher = new CBC_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  try {
+    cipher = decrypting ? getDecryptionMode() : getEncryptionMode();
+  }
+  catch (...) {
+    delete sink;
+    throw;
+  }
 
-      case CBC_CTS_MODE:
-        cipher = new CBC_CTS_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  if (cipher == NULL) {
+    delete sink;
+    return NULL;
+  }
 
-      case CFB_MODE:
-        cipher = new CFB_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  return new StreamTransformationFilter(*cipher, sink, (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding);
+}
 
-      case CTR_MODE:
-        cipher = new CTR_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+unsigned int JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getValidRounds(const unsigned int rounds) const
+{
+  return checkBounds(rounds, MIN_ROUNDS, MAX_ROUNDS);
+}
 
-      case OFB_MODE:
-        cipher = new OFB_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+CipherEnum JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getCipherType() const
+{
+  return TYPE;
+}
 
-      default:
-        return false;
-    }
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+unsigned int JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getBlockSize() const
+{
+  return INFO::BLOCKSIZE;
+}
 
-    this->itsPlaintext.erase();
-    StringSource(this->itsCiphertext, true, new StreamTransformationFilter(*cipher, new StringSink(this->itsPlaintext), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+string JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getImplementationName()
+{
+  if (itsEncryptionObject != NULL) {
+    return getAlgorithmProvider(*itsEncryptionObject);
+  }
 
-    delete bc;
+  // the implementation doesn't depend on the key, so a throwaway object
+  // keyed with zeroes does if no key has been set yet
+  string key(this->itsKey);
+  this->itsKey.resize(this->itsKeylength);
+  member_ptr<BlockCipher> cipher;
+  try {
+    cipher.reset(createCipherObject(false));
   }
-  else {
-    return false;
+  catch (...) {
+    this->itsKey.swap(key);
+    throw;
   }
+  this->itsKey.swap(key);
 
-  if (cipher != NULL) {
-    delete cipher;
+  return cipher.get() == NULL ? "unknown" : getAlgorithmProvider(*cipher);
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+size_t JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::processMessage(const byte* in, const size_t length, byte* out, const bool decrypting, const volatile bool* interrupted)
+{
+  if (this->itsMode == XTS_MODE) {
+    // the whole message is one data unit with the IV as its tweak
+    SecByteBlock tweak;
+    this->copyIV(tweak, 16);
+    processXTSUnits(in, length, out, tweak.data(), length, decrypting, 1, interrupted);
+    return length;
   }
 
-  return true;
+  if (this->isAuthenticatedMode(this->itsMode)) {
+    AuthenticatedSymmetricCipher* cipher = getAuthenticatedMode(decrypting);
+
+    if (cipher == NULL) {
+      throw JException("could not create a cipher object");
+    }
+
+    if (decrypting) {
+      return this->decryptAuthenticated(*cipher, in, length, out, interrupted);
+    }
+    else {
+      return this->encryptAuthenticated(*cipher, in, length, out, interrupted);
+    }
+  }
+
+  if (this->applyKeystream(in, length, out)) {
+    return length;
+  }
+
+  if (decrypting) {
+    return decryptMessage(in, length, out, interrupted);
+  }
+  else {
+    return encryptMessage(in, length, out, interrupted);
+  }
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::encryptRubyIO(VALUE* in, VALUE* out)
+void JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::processInPlace(byte* data, const size_t length, const bool decrypting, const volatile bool* interrupted)
 {
-  BlockCipher* bc = NULL;
-  CipherModeBase* cipher = NULL;
+  if (!this->preservesLength(this->itsMode) || this->itsMAC != NULL) {
+    throw JException("messages can only be processed in place in CFB, CTR, OFB or CBC with CTS mode without a MAC");
+  }
 
-  bc = getEncryptionObject();
+  if (this->applyKeystream(data, length, data)) {
+    return;
+  }
 
-  if (bc != NULL) {
-    switch (this->itsMode) {
-      case ECB_MODE:
-        cipher = new ECB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  CipherModeBase* cipher = decrypting ? getDecryptionMode() : getEncryptionMode();
 
-      case CBC_MODE:
-        cipher = new CBC_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  if (cipher == NULL) {
+    throw JException("could not create a cipher object");
+  }
 
-      case CBC_CTS_MODE:
-        cipher = new CBC_CTS_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  // CTR segments don't depend on each other, but chained decryption reads
+  // the ciphertext block before each segment, which may already be gone
+  if (this->encryptInParallel(decrypting ? *getDecryptionModeCipher() : *itsEncryptionObject, data, length, data, interrupted)) {
+    return;
+  }
 
-      case CFB_MODE:
-        cipher = new CFB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  size_t bulk = length;
 
-      case CTR_MODE:
-        cipher = new CTR_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  if (this->itsMode == CBC_CTS_MODE) {
+    // the filter holds back the last two blocks for ciphertext stealing,
+    // which would leave its output trailing behind its input, so only
+    // those go through it and by way of a copy
+    size_t blockSize = getBlockSize();
+    size_t tail = blockSize + (length % blockSize == 0 ? blockSize : length % blockSize);
+    bulk = length > tail ? length - tail : 0;
+  }
 
-      case OFB_MODE:
-        cipher = new OFB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  processAll(*cipher, data, data, bulk, interrupted);
 
-      default:
-        return false;
+  if (bulk < length) {
+    string tail;
+    StringSource(data + bulk, length - bulk, true, new StreamTransformationFilter(*cipher, new StringSink(tail), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+
+    if (tail.length() != length - bulk) {
+      throw JException("ciphertext stealing changed the length of the message");
     }
 
-    try {
-      RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+    memcpy(data + bulk, tail.data(), tail.length());
+  }
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+size_t JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::encryptMessage(const byte* in, const size_t length, byte* out, const volatile bool* interrupted)
+{
+  CipherModeBase* cipher = getEncryptionMode();
+
+  if (cipher == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  size_t written = 0;
+
+  if (this->itsMAC != NULL) {
+    member_ptr<MessageAuthenticationCode> mac(this->createMACModule());
+
+    if (this->processDirect(*cipher, in, length, out, written, false, interrupted)) {
+      mac->Update(out, written);
+      mac->TruncatedFinal(out + written, this->itsTagLength);
+      written += this->itsTagLength;
     }
-    catch (RubyIOStore::OpenErr e) {
-      delete bc;
-      if (cipher != NULL)
-        delete cipher;
-      throw e;
+    else {
+      // the ciphertext is MACed as it comes out of the cipher rather than
+      // in a second pass over the finished message
+      ArraySink* sink = new ArraySink(out, this->getMaxOutputLength(length, false));
+      StringSource source(in, length, false, new StreamTransformationFilter(*cipher, this->createMACFilter(*mac, sink), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+      pumpAll(source, interrupted);
+      written = (size_t) sink->TotalPutLength();
     }
 
-    delete bc;
+    this->copyTag(out, written);
+
+    return written;
   }
-  else {
-    return false;
+
+  if (this->encryptInParallel(*itsEncryptionObject, in, length, out, interrupted)) {
+    return length;
   }
 
-  if (cipher != NULL) {
-    delete cipher;
+  if (this->processECBInParallel(*itsEncryptionObject, *cipher, in, length, out, written, false, interrupted)) {
+    return written;
   }
 
-  return true;
+  if (this->processDirect(*cipher, in, length, out, written, false, interrupted)) {
+    return written;
+  }
+
+  ArraySink* sink = new ArraySink(out, this->getMaxOutputLength(length, false));
+  StringSource source(in, length, false, new StreamTransformationFilter(*cipher, sink, (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+  pumpAll(source, interrupted);
+
+  return (size_t) sink->TotalPutLength();
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::decryptRubyIO(VALUE* in, VALUE* out)
+size_t JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::decryptMessage(const byte* in, const size_t length, byte* out, const volatile bool* interrupted)
 {
-  BlockCipher* bc = NULL;
-  CipherModeBase* cipher = NULL;
+  CipherModeBase* cipher = getDecryptionMode();
 
-  switch (this->itsMode) {
-    case ECB_MODE:
-    case CBC_MODE:
-    case CBC_CTS_MODE:
-      bc = getDecryptionObject();
-    break;
+  if (cipher == NULL) {
+    throw JException("could not create a cipher object");
+  }
 
-    case CFB_MODE:
-    case CTR_MODE:
-    case OFB_MODE:
-      bc = getEncryptionObject();
-    break;
+  if (this->itsMAC != NULL) {
+    // nothing gets decrypted unless the tag checks out, and then the tag is
+    // simply left off
+    this->verifyMAC(in, length);
+    return decryptUnauthenticated(*cipher, in, length - this->itsTagLength, out, interrupted);
+  }
 
-    default:
-      return false;
+  return decryptUnauthenticated(*cipher, in, length, out, interrupted);
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+size_t JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::decryptUnauthenticated(CipherModeBase& cipher, const byte* in, const size_t length, byte* out, const volatile bool* interrupted)
+{
+  size_t written = 0;
+
+  if (this->decryptInParallel(*getDecryptionModeCipher(), cipher, in, length, out, written, interrupted)) {
+    return written;
   }
 
-  if (bc != NULL) {
-    switch (this->itsMode) {
-      case ECB_MODE:
-        cipher = new ECB_Mode_ExternalCipher::Decryption(*bc);
-      break;
+  if (this->processDirect(cipher, in, length, out, written, true, interrupted)) {
+    return written;
+  }
 
-      case CBC_MODE:
-        cipher = new CBC_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  ArraySink* sink = new ArraySink(out, length);
+  StringSource source(in, length, false, new StreamTransformationFilter(cipher, sink, (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+  pumpAll(source, interrupted);
 
-      case CBC_CTS_MODE:
-        cipher = new CBC_CTS_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  return (size_t) sink->TotalPutLength();
+}
 
-      case CFB_MODE:
-        cipher = new CFB_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+void JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::processXTSUnits(const byte* in, const size_t length, byte* out, const byte* tweak, const size_t sectorSize, const bool decrypting, const unsigned int threads, const volatile bool* interrupted)
+{
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
 
-      case CTR_MODE:
-        cipher = new CTR_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  // IEEE 1619 and SP 800-38E both rule out the same key for data and tweaks
+  const size_t half = this->itsKeylength / 2;
+  if (this->itsKey.compare(0, half, this->itsKey, half, half) == 0) {
+    throw JException("the data and tweak halves of an XTS key must differ");
+  }
 
-      case OFB_MODE:
-        cipher = new OFB_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  BlockCipher*& cipher = decrypting ? itsDecryptionObject : itsEncryptionObject;
 
-      default:
-        return false;
+  if (cipher == NULL) {
+    cipher = createCipherObject(decrypting);
+    if (cipher == NULL) {
+      throw JException("could not create a cipher object");
     }
+  }
 
-    try {
-      RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+  if (itsTweakObject == NULL) {
+    member_ptr<BlockCipher> tweakCipher(createCipherObject(false));
+    if (tweakCipher.get() == NULL) {
+      throw JException("could not create a cipher object");
     }
-    catch (RubyIOStore::OpenErr e) {
-      delete bc;
-      if (cipher != NULL)
-        delete cipher;
-      throw e;
+    this->rekey(*tweakCipher, this->itsKey.substr(this->itsKeylength / 2));
+    itsTweakObject = tweakCipher.release();
+  }
+
+  if (length > 0) {
+    processXTS(*cipher, *itsTweakObject, tweak, in, out, length, sectorSize, decrypting, threads, interrupted);
+  }
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+void JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::processSectors(const string& in, string& out, const word64 firstSector, const size_t sectorSize, const bool decrypting, const volatile bool* interrupted)
+{
+  if (this->itsMode != XTS_MODE) {
+    throw JException("sectors can only be processed in XTS mode");
+  }
+
+  // the tweak is the sector number as a 128-bit little-endian number
+  byte tweak[16];
+  memset(tweak, 0, sizeof(tweak));
+  PutWord(false, LITTLE_ENDIAN_ORDER, tweak, firstSector);
+
+  // every thread needs at least one whole sector
+  size_t threads = this->getParallelThreads(in.length());
+  if (sectorSize > 0) {
+    threads = STDMIN(threads, in.length() / sectorSize);
+  }
+
+  out.resize(in.length());
+  if (in.length() > 0) {
+    processXTSUnits((const byte*) in.data(), in.length(), (byte*) &out[0], tweak, sectorSize, decrypting, (unsigned int) STDMAX(threads, (size_t) 1), interrupted);
+  }
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+void JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::processBatch(const vector<string>& in, const vector<string>& keys, const vector<string>& ivs, vector<string>& out, const bool decrypting, const volatile bool* interrupted)
+{
+  // every message gets its own tag, which JBase already takes care of, and
+  // XTS messages are simply one data unit each
+  if (this->isAuthenticatedMode(this->itsMode) || this->itsMAC != NULL || this->itsMode == XTS_MODE) {
+    JBase::processBatch(in, keys, ivs, out, decrypting, interrupted);
+    return;
+  }
+
+  if (decrypting) {
+    CipherModeBase* cipher = getDecryptionMode();
+
+    if (cipher == NULL) {
+      throw JException("could not create a cipher object");
     }
 
-    delete bc;
+    this->processBlockBatch(*getDecryptionModeCipher(), *cipher, in, keys, ivs, out, true, interrupted);
   }
   else {
+    CipherModeBase* cipher = getEncryptionMode();
+
+    if (cipher == NULL) {
+      throw JException("could not create a cipher object");
+    }
+
+    this->processBlockBatch(*itsEncryptionObject, *cipher, in, keys, ivs, out, false, interrupted);
+  }
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+void JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::decryptRange(const string& in, string& out, const lword offset, const volatile bool* interrupted)
+{
+  if (this->itsMode != CTR_MODE) {
+    throw JException("ranges can only be decrypted in CTR mode");
+  }
+  else if (this->itsMAC != NULL) {
+    throw JException("ranges can't be decrypted with a MAC set since the MAC covers the whole message");
+  }
+
+  CipherModeBase* cipher = getDecryptionMode();
+
+  if (cipher == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  unsigned int threads = this->getParallelThreads(in.length());
+
+  if (threads >= 2) {
+    SecByteBlock iv;
+    this->copyIV(iv, INFO::BLOCKSIZE);
+
+    out.resize(in.length());
+    processCTRInParallel(*getDecryptionModeCipher(), iv.data(), offset, (const byte*) in.data(), (byte*) &out[0], in.length(), threads, interrupted);
+    return;
+  }
+
+  // the counter is worked out from the offset, so nothing before the range
+  // is ever run through the cipher
+  cipher->Seek(offset);
+
+  out.erase();
+  StringSource source(in, false, new StreamTransformationFilter(*cipher, new StringSink(out), StreamTransformationFilter::NO_PADDING));
+  pumpAll(source, interrupted);
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+void JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::precomputeKeystream(const size_t length, const bool background, const volatile bool* interrupted)
+{
+  if (this->itsMode != CTR_MODE && this->itsMode != OFB_MODE) {
+    throw JException("keystream can only be precomputed in CTR and OFB modes");
+  }
+
+  if (getEncryptionMode() == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  // the keystream gets its own copies so a background fill doesn't get in
+  // the way of anything else done with the cipher in the meantime
+  member_ptr<BlockCipher> cipher((BlockCipher*) itsEncryptionObject->Clone());
+  member_ptr<CipherModeBase> mode(this->createMode(*cipher, this->itsMode, false));
+
+  if (mode.get() == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  this->resynchronize(mode.get());
+
+  BlockCipher* blockCipher = cipher.release();
+  this->itsKeystream.start(mode.release(), blockCipher, this->itsIV, length, background, interrupted);
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::encryptRubyIO(VALUE* in, VALUE* out)
+{
+  this->checkMACUnset();
+
+  if (this->itsMode == XTS_MODE) {
+    throw JException("XTS works on whole data units; use encrypt, decrypt or the sector methods");
+  }
+
+  if (this->isAuthenticatedMode(this->itsMode)) {
+    AuthenticatedSymmetricCipher* cipher = getAuthenticatedMode(false);
+
+    if (cipher == NULL) {
+      return false;
+    }
+
+    RubyIOSource(&in, true, this->createAuthenticatedFilter(*cipher, false, new RubyIOSink(&out)));
+
+    return true;
+  }
+
+  CipherModeBase* cipher = getEncryptionMode();
+
+  if (cipher == NULL) {
     return false;
   }
 
-  if (cipher != NULL) {
-    delete cipher;
+  RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+
+  return true;
+}
+
+template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
+bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::decryptRubyIO(VALUE* in, VALUE* out)
+{
+  this->checkMACUnset();
+
+  if (this->itsMode == XTS_MODE) {
+    throw JException("XTS works on whole data units; use encrypt, decrypt or the sector methods");
   }
 
+  if (this->isAuthenticatedMode(this->itsMode)) {
+    AuthenticatedSymmetricCipher* cipher = getAuthenticatedMode(true);
+
+    if (cipher == NULL) {
+      return false;
+    }
+
+    RubyIOSource(&in, true, this->createAuthenticatedFilter(*cipher, true, new RubyIOSink(&out)));
+
+    return true;
+  }
+
+  CipherModeBase* cipher = getDecryptionMode();
+
+  if (cipher == NULL) {
+    return false;
+  }
+
+  RubyIOSource(&in, true, this->createDecryptionFilter(*getDecryptionModeCipher(), *cipher, new RubyIOSink(&out)));
+
   return true;
 }
 
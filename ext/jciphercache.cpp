@@ -0,0 +1,108 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jciphercache.h"
+
+// How many ciphers the shared cache holds on to by default.
+#define DEFAULT_CIPHER_CACHE_SIZE 64
+
+bool JCipherCacheKey::operator==(const JCipherCacheKey& other) const
+{
+  // the cheap fields first, so most misses never look at the key bytes
+  return algorithm == other.algorithm &&
+    key.size() == other.key.size() &&
+    mode == other.mode &&
+    padding == other.padding &&
+    rounds == other.rounds &&
+    key == other.key;
+}
+
+JCipherCache::JCipherCache(const size_t capacity)
+{
+  itsSize = 0;
+  itsCapacity = capacity;
+  pthread_mutex_init(&itsMutex, NULL);
+}
+
+JCipherCache::~JCipherCache()
+{
+  clear();
+  pthread_mutex_destroy(&itsMutex);
+}
+
+JBase* JCipherCache::checkout(const JCipherCacheKey& key)
+{
+  JBase* retval = NULL;
+
+  pthread_mutex_lock(&itsMutex);
+  for (list<Entry>::iterator i = itsEntries.begin(); i != itsEntries.end(); ++i) {
+    if (i->first == key) {
+      retval = i->second;
+      itsEntries.erase(i);
+      --itsSize;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&itsMutex);
+
+  return retval;
+}
+
+void JCipherCache::checkin(const JCipherCacheKey& key, JBase* cipher)
+{
+  pthread_mutex_lock(&itsMutex);
+  itsEntries.push_front(Entry(key, cipher));
+  ++itsSize;
+  trim(itsCapacity);
+  pthread_mutex_unlock(&itsMutex);
+}
+
+size_t JCipherCache::getCapacity() const
+{
+  return itsCapacity;
+}
+
+size_t JCipherCache::setCapacity(const size_t capacity)
+{
+  pthread_mutex_lock(&itsMutex);
+  itsCapacity = capacity;
+  trim(itsCapacity);
+  pthread_mutex_unlock(&itsMutex);
+
+  return itsCapacity;
+}
+
+size_t JCipherCache::getSize() const
+{
+  pthread_mutex_lock(&itsMutex);
+  size_t retval = itsSize;
+  pthread_mutex_unlock(&itsMutex);
+
+  return retval;
+}
+
+void JCipherCache::clear()
+{
+  pthread_mutex_lock(&itsMutex);
+  trim(0);
+  pthread_mutex_unlock(&itsMutex);
+}
+
+void JCipherCache::trim(const size_t capacity)
+{
+  while (itsSize > capacity) {
+    delete itsEntries.back().second;
+    itsEntries.pop_back();
+    --itsSize;
+  }
+}
+
+JCipherCache& getCipherCache()
+{
+  static JCipherCache cache(DEFAULT_CIPHER_CACHE_SIZE);
+  return cache;
+}
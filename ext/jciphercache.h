@@ -0,0 +1,79 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JCIPHERCACHE_H__
+#define __JCIPHERCACHE_H__
+
+#include <list>
+#include <string>
+#include <pthread.h>
+
+// Crypto++ headers...
+
+#include "secblock.h"
+
+#include "jbase.h"
+#include "jconstants.h"
+
+using namespace std;
+
+// What a cached cipher was set up with. key holds the raw key bytes, which
+// the cached cipher keeps a copy of anyway, and is wiped when the key goes
+// away. Modes and paddings are UNKNOWN and rounds 0 for the cipher's
+// defaults.
+struct JCipherCacheKey
+{
+  enum CipherEnum algorithm;
+  enum ModeEnum mode;
+  enum PaddingEnum padding;
+  unsigned int rounds;
+  SecByteBlock key;
+
+  bool operator==(const JCipherCacheKey& other) const;
+};
+
+// A bounded least recently used cache of keyed ciphers for the one-shot
+// CryptoPP.encrypt and CryptoPP.decrypt, so a repeated key skips creating a
+// cipher and expanding the key schedule. A cipher is taken out of the cache
+// while it's in use and put back afterwards, so it's never shared between
+// threads. All of the methods may be called from any thread.
+class JCipherCache
+{
+  public:
+    JCipherCache(const size_t capacity);
+    ~JCipherCache();
+
+    // Removes the most recently used cipher for key and returns it, or
+    // returns NULL if there isn't one.
+    JBase* checkout(const JCipherCacheKey& key);
+
+    // Puts a cipher back as the most recently used, deleting the least
+    // recently used if the cache is full. The cache owns cipher afterwards.
+    void checkin(const JCipherCacheKey& key, JBase* cipher);
+
+    size_t getCapacity() const;
+    size_t setCapacity(const size_t capacity);
+    size_t getSize() const;
+    void clear();
+
+  private:
+    typedef pair<JCipherCacheKey, JBase*> Entry;
+
+    // Deletes entries from the back until there are at most capacity left.
+    // The mutex has to be held.
+    void trim(const size_t capacity);
+
+    list<Entry> itsEntries;
+    size_t itsSize;
+    size_t itsCapacity;
+    mutable pthread_mutex_t itsMutex;
+};
+
+// The cache shared by CryptoPP.encrypt and CryptoPP.decrypt.
+JCipherCache& getCipherCache();
+
+#endif
@@ -38,12 +38,40 @@
 #define ENABLED_TEA_CIPHER                            1
 #define ENABLED_TWOFISH_CIPHER                        1
 
+// Long runs of DES, DES-EDE2, DES-EDE3 and DES-XEX3 blocks are done by the
+// bitsliced kernel in jbitslicedes.cpp rather than Crypto++'s tables.
+#define ENABLED_BITSLICED_DES                         1
+
+// RC5, RC6 and SAFER at their default number of rounds run through the
+// unrolled versions in jfixedrounds.h.
+#define ENABLED_FIXED_ROUNDS                          1
+
+// Long runs of Serpent and SHACAL-2 blocks are done several at a time by the
+// SIMD kernels in jmultiblock.cpp. SHACAL-2 encryption only uses its kernel
+// when Crypto++ has nothing faster than plain C++ for it, e.g. no SHA-NI.
+// RC6, Twofish, Camellia and CAST-256 have kernels too, but they are only
+// compiled in where the compiler targets AVX2, i.e. with extconf.rb's
+// --enable-native on a CPU that has it. The default SSE2 build leaves those
+// four to Crypto++.
+#define ENABLED_MULTIBLOCK                            1
+
 #define ENABLED_ARC4_CIPHER                           1
 #define ENABLED_MARC4_CIPHER                          1
 #define ENABLED_PANAMA_LITTLE_ENDIAN_CIPHER           1
 #define ENABLED_PANAMA_BIG_ENDIAN_CIPHER              1
 #define ENABLED_SEAL_LITTLE_ENDIAN_CIPHER             1
 #define ENABLED_SEAL_BIG_ENDIAN_CIPHER                1
+#if CRYPTOPP_VERSION >= 810
+#define ENABLED_CHACHA20_CIPHER                       1
+#define ENABLED_XCHACHA20_CIPHER                      1
+#define ENABLED_CHACHA20_POLY1305_CIPHER              1
+#define ENABLED_XCHACHA20_POLY1305_CIPHER             1
+#else
+#define ENABLED_CHACHA20_CIPHER                       0
+#define ENABLED_XCHACHA20_CIPHER                      0
+#define ENABLED_CHACHA20_POLY1305_CIPHER              0
+#define ENABLED_XCHACHA20_POLY1305_CIPHER             0
+#endif
 
 #define ENABLED_HAVAL_HASH                            0
 #define ENABLED_HAVAL3_HASH                           0
@@ -24,6 +24,13 @@ enum CipherEnum {
   SEAL_LITTLE_ENDIAN_CIPHER,
   SEAL_BIG_ENDIAN_CIPHER,
 
+  // Stream ciphers from Crypto++ 8.1...
+
+  CHACHA20_CIPHER,
+  XCHACHA20_CIPHER,
+  CHACHA20_POLY1305_CIPHER,
+  XCHACHA20_POLY1305_CIPHER,
+
   // Block Ciphers...
 
   THREEWAY_CIPHER,
@@ -67,7 +74,7 @@ enum CipherEnum {
 // it's a stream cipher; otherwise, it's a block cipher...
 
 #define IS_BLOCK_CIPHER(x) (x >= THREEWAY_CIPHER && x <= SHACAL2_CIPHER)
-#define IS_STREAM_CIPHER(x) (x >= ARC4_CIPHER && x <= SEAL_BIG_ENDIAN_CIPHER)
+#define IS_STREAM_CIPHER(x) (x >= ARC4_CIPHER && x <= XCHACHA20_POLY1305_CIPHER)
 #define VALID_CIPHER(x) (x >= ARC4_CIPHER && x <= SHACAL2_CIPHER)
 
 
@@ -80,7 +87,11 @@ enum ModeEnum {
 #  include "defs/block_modes.def"
 };
 
-#define VALID_MODE(x) (x > UNKNOWN_MODE && x <= OFB_MODE)
+#define VALID_MODE(x) (x > UNKNOWN_MODE && x <= XTS_MODE)
+
+// Tag lengths in bytes for the authenticated modes.
+#define MIN_TAG_LENGTH 4
+#define MAX_TAG_LENGTH 16
 
 
 // Block cipher padding used in JCipher...
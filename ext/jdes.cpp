@@ -6,17 +6,26 @@
  */
 
 #include "jdes.h"
+#include "jbitslicedes.h"
 
 #if ENABLED_DES_CIPHER
 
 BlockCipher* JDES::getEncryptionObject()
 {
+#if ENABLED_BITSLICED_DES
+  return new JBitslicedDES(DESEncryption((byte*) itsKey.data(), itsKeylength), DES_CIPHER, (byte*) itsKey.data(), itsKeylength);
+#else
   return new DESEncryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 BlockCipher* JDES::getDecryptionObject()
 {
+#if ENABLED_BITSLICED_DES
+  return new JBitslicedDES(DESDecryption((byte*) itsKey.data(), itsKeylength), DES_CIPHER, (byte*) itsKey.data(), itsKeylength);
+#else
   return new DESDecryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
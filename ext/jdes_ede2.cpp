@@ -6,17 +6,26 @@
  */
 
 #include "jdes_ede2.h"
+#include "jbitslicedes.h"
 
 #if ENABLED_DES_EDE2_CIPHER
 
 BlockCipher* JDES_EDE2::getEncryptionObject()
 {
+#if ENABLED_BITSLICED_DES
+  return new JBitslicedDES(DES_EDE2_Encryption((byte*) itsKey.data(), itsKeylength), DES_EDE2_CIPHER, (byte*) itsKey.data(), itsKeylength);
+#else
   return new DES_EDE2_Encryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 BlockCipher* JDES_EDE2::getDecryptionObject()
 {
+#if ENABLED_BITSLICED_DES
+  return new JBitslicedDES(DES_EDE2_Decryption((byte*) itsKey.data(), itsKeylength), DES_EDE2_CIPHER, (byte*) itsKey.data(), itsKeylength);
+#else
   return new DES_EDE2_Decryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
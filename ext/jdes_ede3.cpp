@@ -6,17 +6,26 @@
  */
 
 #include "jdes_ede3.h"
+#include "jbitslicedes.h"
 
 #if ENABLED_DES_EDE3_CIPHER
 
 BlockCipher* JDES_EDE3::getEncryptionObject()
 {
+#if ENABLED_BITSLICED_DES
+  return new JBitslicedDES(DES_EDE3_Encryption((byte*) itsKey.data(), itsKeylength), DES_EDE3_CIPHER, (byte*) itsKey.data(), itsKeylength);
+#else
   return new DES_EDE3_Encryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 BlockCipher* JDES_EDE3::getDecryptionObject()
 {
+#if ENABLED_BITSLICED_DES
+  return new JBitslicedDES(DES_EDE3_Decryption((byte*) itsKey.data(), itsKeylength), DES_EDE3_CIPHER, (byte*) itsKey.data(), itsKeylength);
+#else
   return new DES_EDE3_Decryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
@@ -6,17 +6,26 @@
  */
 
 #include "jdes_xex3.h"
+#include "jbitslicedes.h"
 
 #if ENABLED_DES_XEX3_CIPHER
 
 BlockCipher* JDES_XEX3::getEncryptionObject()
 {
+#if ENABLED_BITSLICED_DES
+  return new JBitslicedDES(DES_XEX3_Encryption((byte*) itsKey.data(), itsKeylength), DES_XEX3_CIPHER, (byte*) itsKey.data(), itsKeylength);
+#else
   return new DES_XEX3_Encryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 BlockCipher* JDES_XEX3::getDecryptionObject()
 {
+#if ENABLED_BITSLICED_DES
+  return new JBitslicedDES(DES_XEX3_Decryption((byte*) itsKey.data(), itsKeylength), DES_XEX3_CIPHER, (byte*) itsKey.data(), itsKeylength);
+#else
   return new DES_XEX3_Decryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
@@ -0,0 +1,18 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jeax.h"
+
+JCMAC::JCMAC(const BlockCipher& cipher)
+  : m_cipher((BlockCipher*) cipher.Clone())
+{
+}
+
+JEAX::JEAX(const BlockCipher& cipher, const bool encrypting)
+  : m_cmac(cipher), m_encrypting(encrypting)
+{
+}
@@ -0,0 +1,56 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JEAX_H__
+#define __JEAX_H__
+
+#include <string>
+
+// Crypto++ headers...
+
+#include "eax.h"
+
+using namespace CryptoPP;
+
+// Like JGCM, EAX and the CMAC it's built on around any block cipher object
+// rather than a type fixed at compile time. Each works on its own copy of
+// the cipher.
+class JCMAC : public CMAC_Base
+{
+  public:
+    JCMAC(const BlockCipher& cipher);
+
+    std::string AlgorithmName() const { return "CMAC(" + m_cipher->AlgorithmName() + ")"; }
+    size_t MinKeyLength() const { return m_cipher->MinKeyLength(); }
+    size_t MaxKeyLength() const { return m_cipher->MaxKeyLength(); }
+    size_t DefaultKeyLength() const { return m_cipher->DefaultKeyLength(); }
+    size_t GetValidKeyLength(size_t keylength) const { return m_cipher->GetValidKeyLength(keylength); }
+    IV_Requirement IVRequirement() const { return NOT_RESYNCHRONIZABLE; }
+
+  protected:
+    BlockCipher& AccessCipher() { return *m_cipher; }
+
+  private:
+    member_ptr<BlockCipher> m_cipher;
+};
+
+class JEAX : public EAX_Base
+{
+  public:
+    JEAX(const BlockCipher& cipher, const bool encrypting);
+
+    bool IsForwardTransformation() const { return m_encrypting; }
+
+  protected:
+    CMAC_Base& AccessMAC() { return m_cmac; }
+
+  private:
+    JCMAC m_cmac;
+    bool m_encrypting;
+};
+
+#endif
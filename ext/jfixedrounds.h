@@ -0,0 +1,359 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JFIXEDROUNDS_H__
+#define __JFIXEDROUNDS_H__
+
+#include <string>
+
+#include "jconfig.h"
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+#include "misc.h"
+#include "secblock.h"
+#include "smartptr.h"
+
+using namespace CryptoPP;
+
+// RC5, RC6 and SAFER take their number of rounds when keyed, so Crypto++
+// runs them with a loop counter it only knows at runtime. These are the
+// same ciphers with the rounds as a template parameter, which get built for
+// the defaults that JCipher_Template already has. The rounds are expanded
+// recursively at compile time, so each block goes through straight-line
+// code with no loop at all. Anything else about the cipher, like its name
+// and key lengths, comes from cipher, a copy of the Crypto++ object for
+// the same algorithm and direction.
+class JFixedRoundsCipher : public BlockCipher
+{
+  public:
+    JFixedRoundsCipher(const BlockCipher& cipher);
+    JFixedRoundsCipher(const JFixedRoundsCipher& other);
+
+    std::string AlgorithmName() const { return itsCipher->AlgorithmName(); }
+    std::string AlgorithmProvider() const { return "C++ unrolled"; }
+
+    size_t MinKeyLength() const { return itsCipher->MinKeyLength(); }
+    size_t MaxKeyLength() const { return itsCipher->MaxKeyLength(); }
+    size_t DefaultKeyLength() const { return itsCipher->DefaultKeyLength(); }
+    size_t GetValidKeyLength(size_t keylength) const { return itsCipher->GetValidKeyLength(keylength); }
+    IV_Requirement IVRequirement() const { return NOT_RESYNCHRONIZABLE; }
+
+    unsigned int BlockSize() const { return itsCipher->BlockSize(); }
+    bool IsForwardTransformation() const { return itsCipher->IsForwardTransformation(); }
+
+  protected:
+    void UncheckedSetKey(const byte* key, unsigned int length, const NameValuePairs& params);
+    virtual void schedule(const byte* key, const size_t length) = 0;
+
+    member_ptr<BlockCipher> itsCipher;
+};
+
+// The RC5 and RC6 key schedule, which fills size words of table.
+void rcKeySchedule(const byte* key, const size_t length, word32* table, const unsigned int size);
+
+extern const byte SAFER_EXP[256];
+extern const byte SAFER_LOG[256];
+
+// Round ROUND of ROUNDS and everything after it. Decryption counts ROUND
+// up the same way but uses the round keys from the end.
+template <unsigned int ROUND, unsigned int ROUNDS>
+struct JRC5Rounds
+{
+  static inline void encrypt(word32& a, word32& b, const word32* s)
+  {
+    a = rotlMod(a ^ b, b) + s[2 * ROUND + 2];
+    b = rotlMod(a ^ b, a) + s[2 * ROUND + 3];
+    JRC5Rounds<ROUND + 1, ROUNDS>::encrypt(a, b, s);
+  }
+
+  static inline void decrypt(word32& a, word32& b, const word32* s)
+  {
+    b = rotrMod(b - s[2 * (ROUNDS - ROUND) + 1], a) ^ a;
+    a = rotrMod(a - s[2 * (ROUNDS - ROUND)], b) ^ b;
+    JRC5Rounds<ROUND + 1, ROUNDS>::decrypt(a, b, s);
+  }
+};
+
+template <unsigned int ROUNDS>
+struct JRC5Rounds<ROUNDS, ROUNDS>
+{
+  static inline void encrypt(word32& a, word32& b, const word32* s) {}
+  static inline void decrypt(word32& a, word32& b, const word32* s) {}
+};
+
+// RC6 rotates its four words a place each round. Passing them on in the
+// new order rather than moving them around leaves that to the compiler.
+template <unsigned int ROUND, unsigned int ROUNDS>
+struct JRC6Rounds
+{
+  static inline void encrypt(word32& a, word32& b, word32& c, word32& d, const word32* s)
+  {
+    word32 t = rotlFixed(b * (2 * b + 1), 5);
+    word32 u = rotlFixed(d * (2 * d + 1), 5);
+    a = rotlMod(a ^ t, u) + s[2 * ROUND + 2];
+    c = rotlMod(c ^ u, t) + s[2 * ROUND + 3];
+    JRC6Rounds<ROUND + 1, ROUNDS>::encrypt(b, c, d, a, s);
+  }
+
+  static inline void decrypt(word32& a, word32& b, word32& c, word32& d, const word32* s)
+  {
+    word32 u = rotlFixed(c * (2 * c + 1), 5);
+    word32 t = rotlFixed(a * (2 * a + 1), 5);
+    b = rotrMod(b - s[2 * (ROUNDS - ROUND) + 1], t) ^ u;
+    d = rotrMod(d - s[2 * (ROUNDS - ROUND)], u) ^ t;
+    JRC6Rounds<ROUND + 1, ROUNDS>::decrypt(d, a, b, c, s);
+  }
+};
+
+template <unsigned int ROUNDS>
+struct JRC6Rounds<ROUNDS, ROUNDS>
+{
+  static inline void encrypt(word32& a, word32& b, word32& c, word32& d, const word32* s) {}
+  static inline void decrypt(word32& a, word32& b, word32& c, word32& d, const word32* s) {}
+};
+
+template <unsigned int ROUND, unsigned int ROUNDS>
+struct JSAFERRounds
+{
+  static inline void pht(byte& x, byte& y)
+  {
+    y += x;
+    x += y;
+  }
+
+  static inline void ipht(byte& x, byte& y)
+  {
+    x -= y;
+    y -= x;
+  }
+
+  static inline void encrypt(byte* v, const byte* k)
+  {
+    const byte* key = k + 16 * ROUND;
+
+    v[0] = SAFER_EXP[v[0] ^ key[0]] + key[8];
+    v[1] = SAFER_LOG[(byte) (v[1] + key[1])] ^ key[9];
+    v[2] = SAFER_LOG[(byte) (v[2] + key[2])] ^ key[10];
+    v[3] = SAFER_EXP[v[3] ^ key[3]] + key[11];
+    v[4] = SAFER_EXP[v[4] ^ key[4]] + key[12];
+    v[5] = SAFER_LOG[(byte) (v[5] + key[5])] ^ key[13];
+    v[6] = SAFER_LOG[(byte) (v[6] + key[6])] ^ key[14];
+    v[7] = SAFER_EXP[v[7] ^ key[7]] + key[15];
+
+    pht(v[0], v[1]); pht(v[2], v[3]); pht(v[4], v[5]); pht(v[6], v[7]);
+    pht(v[0], v[2]); pht(v[4], v[6]); pht(v[1], v[3]); pht(v[5], v[7]);
+    pht(v[0], v[4]); pht(v[1], v[5]); pht(v[2], v[6]); pht(v[3], v[7]);
+
+    byte t = v[1]; v[1] = v[4]; v[4] = v[2]; v[2] = t;
+    t = v[3]; v[3] = v[5]; v[5] = v[6]; v[6] = t;
+
+    JSAFERRounds<ROUND + 1, ROUNDS>::encrypt(v, k);
+  }
+
+  static inline void decrypt(byte* v, const byte* k)
+  {
+    const byte* key = k + 16 * (ROUNDS - 1 - ROUND);
+
+    byte t = v[1]; v[1] = v[2]; v[2] = v[4]; v[4] = t;
+    t = v[3]; v[3] = v[6]; v[6] = v[5]; v[5] = t;
+
+    ipht(v[0], v[4]); ipht(v[1], v[5]); ipht(v[2], v[6]); ipht(v[3], v[7]);
+    ipht(v[0], v[2]); ipht(v[4], v[6]); ipht(v[1], v[3]); ipht(v[5], v[7]);
+    ipht(v[0], v[1]); ipht(v[2], v[3]); ipht(v[4], v[5]); ipht(v[6], v[7]);
+
+    v[7] = SAFER_LOG[(byte) (v[7] - key[15])] ^ key[7];
+    v[6] = SAFER_EXP[v[6] ^ key[14]] - key[6];
+    v[5] = SAFER_EXP[v[5] ^ key[13]] - key[5];
+    v[4] = SAFER_LOG[(byte) (v[4] - key[12])] ^ key[4];
+    v[3] = SAFER_LOG[(byte) (v[3] - key[11])] ^ key[3];
+    v[2] = SAFER_EXP[v[2] ^ key[10]] - key[2];
+    v[1] = SAFER_EXP[v[1] ^ key[9]] - key[1];
+    v[0] = SAFER_LOG[(byte) (v[0] - key[8])] ^ key[0];
+
+    JSAFERRounds<ROUND + 1, ROUNDS>::decrypt(v, k);
+  }
+};
+
+template <unsigned int ROUNDS>
+struct JSAFERRounds<ROUNDS, ROUNDS>
+{
+  static inline void encrypt(byte* v, const byte* k) {}
+  static inline void decrypt(byte* v, const byte* k) {}
+};
+
+template <unsigned int ROUNDS>
+class JRC5FixedRounds : public JFixedRoundsCipher
+{
+  public:
+    JRC5FixedRounds(const BlockCipher& cipher, const byte* key, const size_t length)
+      : JFixedRoundsCipher(cipher)
+    {
+      schedule(key, length);
+    }
+
+    Clonable* Clone() const { return new JRC5FixedRounds(*this); }
+
+    void ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const
+    {
+      word32 a = GetWord<word32>(false, LITTLE_ENDIAN_ORDER, inBlock);
+      word32 b = GetWord<word32>(false, LITTLE_ENDIAN_ORDER, inBlock + 4);
+
+      if (itsCipher->IsForwardTransformation()) {
+        a += itsTable[0];
+        b += itsTable[1];
+        JRC5Rounds<0, ROUNDS>::encrypt(a, b, itsTable);
+      }
+      else {
+        JRC5Rounds<0, ROUNDS>::decrypt(a, b, itsTable);
+        b -= itsTable[1];
+        a -= itsTable[0];
+      }
+
+      PutWord(false, LITTLE_ENDIAN_ORDER, outBlock, a, xorBlock);
+      PutWord(false, LITTLE_ENDIAN_ORDER, outBlock + 4, b, xorBlock == NULL ? NULL : xorBlock + 4);
+    }
+
+  protected:
+    void schedule(const byte* key, const size_t length)
+    {
+      rcKeySchedule(key, length, itsTable, itsTable.size());
+    }
+
+  private:
+    FixedSizeSecBlock<word32, 2 * (ROUNDS + 1)> itsTable;
+};
+
+template <unsigned int ROUNDS>
+class JRC6FixedRounds : public JFixedRoundsCipher
+{
+  public:
+    JRC6FixedRounds(const BlockCipher& cipher, const byte* key, const size_t length)
+      : JFixedRoundsCipher(cipher)
+    {
+      schedule(key, length);
+    }
+
+    Clonable* Clone() const { return new JRC6FixedRounds(*this); }
+
+    void ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const
+    {
+      word32 v[4];
+
+      for (unsigned int i = 0; i < 4; ++i) {
+        v[i] = GetWord<word32>(false, LITTLE_ENDIAN_ORDER, inBlock + 4 * i);
+      }
+
+      // each round moves the words a place along, forwards when
+      // encrypting and backwards when decrypting
+      unsigned int first;
+
+      if (itsCipher->IsForwardTransformation()) {
+        v[1] += itsTable[0];
+        v[3] += itsTable[1];
+        JRC6Rounds<0, ROUNDS>::encrypt(v[0], v[1], v[2], v[3], itsTable);
+        first = ROUNDS % 4;
+        v[first] += itsTable[2 * ROUNDS + 2];
+        v[(first + 2) % 4] += itsTable[2 * ROUNDS + 3];
+      }
+      else {
+        v[2] -= itsTable[2 * ROUNDS + 3];
+        v[0] -= itsTable[2 * ROUNDS + 2];
+        JRC6Rounds<0, ROUNDS>::decrypt(v[0], v[1], v[2], v[3], itsTable);
+        first = (4 - ROUNDS % 4) % 4;
+        v[(first + 1) % 4] -= itsTable[0];
+        v[(first + 3) % 4] -= itsTable[1];
+      }
+
+      for (unsigned int i = 0; i < 4; ++i) {
+        PutWord(false, LITTLE_ENDIAN_ORDER, outBlock + 4 * i, v[(first + i) % 4], xorBlock == NULL ? NULL : xorBlock + 4 * i);
+      }
+    }
+
+  protected:
+    void schedule(const byte* key, const size_t length)
+    {
+      rcKeySchedule(key, length, itsTable, itsTable.size());
+    }
+
+  private:
+    FixedSizeSecBlock<word32, 2 * ROUNDS + 4> itsTable;
+};
+
+// SAFER K and SK only differ in their key schedules.
+template <unsigned int ROUNDS>
+class JSAFERFixedRounds : public JFixedRoundsCipher
+{
+  public:
+    JSAFERFixedRounds(const BlockCipher& cipher, const bool strengthened, const byte* key, const size_t length)
+      : JFixedRoundsCipher(cipher), itsStrengthened(strengthened)
+    {
+      schedule(key, length);
+    }
+
+    Clonable* Clone() const { return new JSAFERFixedRounds(*this); }
+
+    void ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const
+    {
+      const byte* last = itsKeys + 16 * ROUNDS;
+      byte v[8];
+
+      memcpy(v, inBlock, 8);
+
+      if (itsCipher->IsForwardTransformation()) {
+        JSAFERRounds<0, ROUNDS>::encrypt(v, itsKeys);
+        v[0] ^= last[0]; v[1] += last[1]; v[2] += last[2]; v[3] ^= last[3];
+        v[4] ^= last[4]; v[5] += last[5]; v[6] += last[6]; v[7] ^= last[7];
+      }
+      else {
+        v[0] ^= last[0]; v[1] -= last[1]; v[2] -= last[2]; v[3] ^= last[3];
+        v[4] ^= last[4]; v[5] -= last[5]; v[6] -= last[6]; v[7] ^= last[7];
+        JSAFERRounds<0, ROUNDS>::decrypt(v, itsKeys);
+      }
+
+      if (xorBlock != NULL) {
+        xorbuf(outBlock, v, xorBlock, 8);
+      }
+      else {
+        memcpy(outBlock, v, 8);
+      }
+    }
+
+  protected:
+    void schedule(const byte* key, const size_t length)
+    {
+      const byte* key2 = length == 8 ? key : key + 8;
+      byte* k = itsKeys;
+      byte ka[9], kb[9];
+
+      ka[8] = kb[8] = 0;
+      for (unsigned int j = 0; j < 8; ++j) {
+        ka[8] ^= ka[j] = rotlFixed(key[j], 5);
+        kb[8] ^= kb[j] = *k++ = key2[j];
+      }
+
+      for (unsigned int i = 1; i <= ROUNDS; ++i) {
+        for (unsigned int j = 0; j < 9; ++j) {
+          ka[j] = rotlFixed(ka[j], 6);
+          kb[j] = rotlFixed(kb[j], 6);
+        }
+        for (unsigned int j = 0; j < 8; ++j) {
+          *k++ = ka[itsStrengthened ? (j + 2 * i - 1) % 9 : j] + SAFER_EXP[SAFER_EXP[18 * i + j + 1]];
+        }
+        for (unsigned int j = 0; j < 8; ++j) {
+          *k++ = kb[itsStrengthened ? (j + 2 * i) % 9 : j] + SAFER_EXP[SAFER_EXP[18 * i + j + 10]];
+        }
+      }
+    }
+
+  private:
+    bool itsStrengthened;
+    FixedSizeSecBlock<byte, 8 * (1 + 2 * ROUNDS)> itsKeys;
+};
+
+#endif
@@ -0,0 +1,13 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jgcm.h"
+
+JGCM::JGCM(const BlockCipher& cipher, const GCM_TablesOption tables, const bool encrypting)
+  : m_cipher((BlockCipher*) cipher.Clone()), m_tables(tables), m_encrypting(encrypting)
+{
+}
@@ -0,0 +1,37 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JGCM_H__
+#define __JGCM_H__
+
+// Crypto++ headers...
+
+#include "gcm.h"
+
+using namespace CryptoPP;
+
+// Crypto++ only comes with GCM bound to a block cipher type at compile time
+// through GCM<>. This is GCM around any 128-bit block cipher object instead,
+// working on its own copy of the cipher.
+class JGCM : public GCM_Base
+{
+  public:
+    JGCM(const BlockCipher& cipher, const GCM_TablesOption tables, const bool encrypting);
+
+    bool IsForwardTransformation() const { return m_encrypting; }
+
+  protected:
+    GCM_TablesOption GetTablesOption() const { return m_tables; }
+    BlockCipher& AccessBlockCipher() { return *m_cipher; }
+
+  private:
+    member_ptr<BlockCipher> m_cipher;
+    GCM_TablesOption m_tables;
+    bool m_encrypting;
+};
+
+#endif
@@ -35,6 +35,11 @@ string JHash::getPlaintext(bool hex) const
   }
 }
 
+size_t JHash::getPlaintextLength() const
+{
+  return itsPlaintext.length();
+}
+
 string JHash::getHashtext(bool hex) const
 {
   if (hex) {
@@ -55,6 +60,16 @@ unsigned int JHash::getDigestSize() const
   }
 }
 
+string JHash::getImplementationName() const
+{
+  if (itsHashModule != NULL) {
+    return getAlgorithmProvider(*itsHashModule);
+  }
+  else {
+    return "unknown";
+  }
+}
+
 void JHash::setPlaintext(const string plaintext, bool hex)
 {
   if (hex) {
@@ -11,6 +11,7 @@
 #include "jsink.h"
 #include "jhelpers.h"
 #include "jconstants.h"
+#include "jthreads.h"
 
 
 using namespace CryptoPP;
@@ -22,8 +23,10 @@ class JHash
     virtual ~JHash();
 
     string getPlaintext(bool hex = false) const;
+    size_t getPlaintextLength() const;
     string getHashtext(bool hex = true) const;
     unsigned int getDigestSize() const;
+    string getImplementationName() const;
     virtual enum HashEnum getHashType() const = 0;
 
     void setPlaintext(string plaintext, bool hex = false);
@@ -33,7 +36,9 @@ class JHash
 
     void clear();
 
-    virtual bool hash() = 0;
+    // interrupted may point at a flag that aborts the work when set, see
+    // runWithoutGVL().
+    virtual bool hash(const volatile bool* interrupted = NULL) = 0;
     virtual bool validate() = 0;
     virtual bool validate(string plaintext, string hashtext) = 0;
 
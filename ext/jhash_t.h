@@ -20,7 +20,7 @@ class JHash_Template : public JHash
   public:
     JHash_Template(string plaintext = "");
     enum HashEnum getHashType() const;
-    bool hash();
+    bool hash(const volatile bool* interrupted = NULL);
     bool validate();
     bool validate(string plaintext, string hashtext);
     string hashRubyIO(VALUE* in, bool hex = true);
@@ -46,11 +46,19 @@ HashEnum JHash_Template<HASH, TYPE>::getHashType() const
 }
 
 template <typename HASH, enum HashEnum TYPE>
-bool JHash_Template<HASH, TYPE>::hash()
+bool JHash_Template<HASH, TYPE>::hash(const volatile bool* interrupted)
 {
   itsHashtext.erase();
 
-  StringSource s(itsPlaintext, true, new HashFilter(*itsHashModule, new StringSink(itsHashtext)));
+  StringSource s(itsPlaintext, false, new HashFilter(*itsHashModule, new StringSink(itsHashtext)));
+  try {
+    pumpAll(s, interrupted);
+  }
+  catch (...) {
+    // don't leave a half-hashed message in the hash module
+    itsHashModule->Restart();
+    throw;
+  }
   return true;
 }
 
@@ -88,3 +88,12 @@ unsigned int checkBounds(unsigned int length, unsigned int min, unsigned int max
     return (length + multiple - 1) - ((length + multiple - 1) % multiple);
   }
 }
+
+string getAlgorithmProvider(const Algorithm& algorithm)
+{
+#if CRYPTOPP_VERSION >= 600
+  return algorithm.AlgorithmProvider();
+#else
+  return "unknown";
+#endif
+}
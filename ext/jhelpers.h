@@ -35,4 +35,9 @@ string generateIV(const unsigned int size, const enum RNGEnum rng = DEFAULT_RNG)
 
 unsigned int checkBounds(unsigned int length, unsigned int min, unsigned int max, unsigned short int multiple = 1);
 
+// The name of the code path Crypto++ picked for algorithm on this CPU, like
+// "AESNI", "SSE2" or "C++". Crypto++ only reports this as of 6.0, so older
+// versions get "unknown".
+string getAlgorithmProvider(const CryptoPP::Algorithm& algorithm);
+
 #endif
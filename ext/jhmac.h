@@ -26,6 +26,10 @@ class JHMAC : public JHash
     unsigned int setKeylength(const unsigned int keylength);
     unsigned int setKey(const string key, const bool hex = false);
 
+    // A new HMAC object of the same type keyed with key, for use outside of
+    // this object such as encrypt-then-MAC on ciphers.
+    virtual MessageAuthenticationCode* createMAC(const string& key) const = 0;
+
   protected:
     string itsKey;
     unsigned int itsKeylength;
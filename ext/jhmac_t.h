@@ -22,10 +22,11 @@ class JHMAC_Template : public JHMAC
   public:
     JHMAC_Template(string plaintext = "");
     inline enum HashEnum getHashType() const;
-    bool hash();
+    bool hash(const volatile bool* interrupted = NULL);
     bool validate();
     bool validate(string plaintext, string hashtext);
     string hashRubyIO(VALUE* in, bool hex = true);
+    MessageAuthenticationCode* createMAC(const string& key) const;
 };
 
 template <typename HASH, enum HashEnum TYPE>
@@ -41,11 +42,19 @@ HashEnum JHMAC_Template<HASH, TYPE>::getHashType() const
 }
 
 template <typename HASH, enum HashEnum TYPE>
-bool JHMAC_Template<HASH, TYPE>::hash()
+bool JHMAC_Template<HASH, TYPE>::hash(const volatile bool* interrupted)
 {
   ((HMAC<HASH>*) itsHashModule)->SetKey((byte*) itsKey.data(), itsKeylength);
   itsHashtext.erase();
-  StringSource s(itsPlaintext, true, new HashFilter(*itsHashModule, new StringSink(itsHashtext)));
+  StringSource s(itsPlaintext, false, new HashFilter(*itsHashModule, new StringSink(itsHashtext)));
+  try {
+    pumpAll(s, interrupted);
+  }
+  catch (...) {
+    // don't leave a half-hashed message in the hash module
+    itsHashModule->Restart();
+    throw;
+  }
   return true;
 }
 
@@ -90,4 +99,10 @@ string JHMAC_Template<HASH, TYPE>::hashRubyIO(VALUE* in, bool hex)
   return retval;
 }
 
+template <typename HASH, enum HashEnum TYPE>
+MessageAuthenticationCode* JHMAC_Template<HASH, TYPE>::createMAC(const string& key) const
+{
+  return new HMAC<HASH>((const byte*) key.data(), key.length());
+}
+
 #endif
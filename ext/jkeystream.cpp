@@ -0,0 +1,175 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jkeystream.h"
+#include "jexception.h"
+#include "jthreads.h"
+
+// Crypto++ headers...
+
+#include "misc.h"
+
+JKeystream::JKeystream()
+{
+  itsRunning = false;
+  itsCancelled = false;
+  itsFailed = false;
+  itsDone = false;
+  itsWoken = false;
+  pthread_mutex_init(&itsMutex, NULL);
+  pthread_cond_init(&itsCond, NULL);
+}
+
+JKeystream::~JKeystream()
+{
+  itsCancelled = true;
+  wait();
+  pthread_mutex_destroy(&itsMutex);
+  pthread_cond_destroy(&itsCond);
+}
+
+void* JKeystream::run(void* ptr)
+{
+  JKeystream* keystream = (JKeystream*) ptr;
+
+  try {
+    keystream->fill(&keystream->itsCancelled);
+  }
+  catch (...) {
+    keystream->itsFailed = true;
+  }
+
+  pthread_mutex_lock(&keystream->itsMutex);
+  keystream->itsDone = true;
+  pthread_cond_signal(&keystream->itsCond);
+  pthread_mutex_unlock(&keystream->itsMutex);
+
+  return NULL;
+}
+
+void JKeystream::fill(const volatile bool* interrupted)
+{
+  // the keystream is simply what the cipher does to zeroes
+  memset(itsKeystream.data(), 0, itsKeystream.size());
+
+  for (size_t done = 0; done < itsKeystream.size(); done += PARALLEL_CHUNK_SIZE) {
+    if (interrupted != NULL && *interrupted) {
+      throw JException("operation interrupted");
+    }
+    size_t chunk = STDMIN((size_t) PARALLEL_CHUNK_SIZE, itsKeystream.size() - done);
+    itsCipher->ProcessString(itsKeystream.data() + done, chunk);
+  }
+}
+
+/* Waits for the background fill to finish or for Ruby to want the thread
+ * back, returning non-NULL in the first case. */
+void* JKeystream::waitDone(void* ptr)
+{
+  JKeystream* keystream = (JKeystream*) ptr;
+  bool done;
+
+  pthread_mutex_lock(&keystream->itsMutex);
+  while (!keystream->itsDone && !keystream->itsWoken) {
+    pthread_cond_wait(&keystream->itsCond, &keystream->itsMutex);
+  }
+  keystream->itsWoken = false;
+  done = keystream->itsDone;
+  pthread_mutex_unlock(&keystream->itsMutex);
+
+  return done ? ptr : NULL;
+}
+
+void JKeystream::wake(void* ptr)
+{
+  JKeystream* keystream = (JKeystream*) ptr;
+
+  pthread_mutex_lock(&keystream->itsMutex);
+  keystream->itsWoken = true;
+  pthread_cond_signal(&keystream->itsCond);
+  pthread_mutex_unlock(&keystream->itsMutex);
+}
+
+/* Joins the background thread. Waiting for a whole fill is done without the
+ * GVL where possible, so it doesn't hold up every other Ruby thread, and
+ * the fill is only cancelled if Ruby actually raises in the meantime. A
+ * cancelled fill stops within a chunk, which isn't worth giving up the GVL
+ * for. */
+void JKeystream::wait()
+{
+  if (!itsRunning) {
+    return;
+  }
+
+  if (!itsCancelled && !waitWithoutGVL(waitDone, wake, this)) {
+    itsCancelled = true;
+  }
+
+  pthread_join(itsThread, NULL);
+  itsRunning = false;
+}
+
+void JKeystream::start(StreamTransformation* cipher, BlockCipher* blockCipher, const string& iv, const size_t length, const bool background, const volatile bool* interrupted)
+{
+  clear();
+
+  itsBlockCipher.reset(blockCipher);
+  itsCipher.reset(cipher);
+  itsKeystream.New(length);
+  itsIV = iv;
+  itsCancelled = false;
+  itsDone = false;
+  itsWoken = false;
+
+  if (background) {
+    itsRunning = (pthread_create(&itsThread, NULL, run, this) == 0);
+    if (itsRunning) {
+      return;
+    }
+  }
+
+  try {
+    fill(interrupted);
+  }
+  catch (...) {
+    clear();
+    throw;
+  }
+}
+
+void JKeystream::clear()
+{
+  itsCancelled = true;
+  wait();
+
+  // the mode object goes before the block cipher it refers to
+  itsCipher.reset();
+  itsBlockCipher.reset();
+  itsKeystream.New(0);
+  itsIV.erase();
+  itsFailed = false;
+}
+
+bool JKeystream::apply(const string& iv, const byte* in, byte* out, const size_t length)
+{
+  if (itsKeystream.size() == 0) {
+    return false;
+  }
+
+  wait();
+
+  if (itsFailed) {
+    clear();
+    return false;
+  }
+  else if (length > itsKeystream.size() || iv != itsIV) {
+    return false;
+  }
+
+  xorbuf(out, in, itsKeystream.data(), length);
+
+  return true;
+}
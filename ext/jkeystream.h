@@ -0,0 +1,73 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JKEYSTREAM_H__
+#define __JKEYSTREAM_H__
+
+#include <string>
+#include <pthread.h>
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+#include "secblock.h"
+#include "smartptr.h"
+
+using namespace std;
+using namespace CryptoPP;
+
+// Keystream generated ahead of time for CTR, OFB and the stream ciphers,
+// where the keystream doesn't depend on the message. A message of up to
+// the precomputed length is then encrypted or decrypted with a single XOR.
+// The keystream is only good for the IV it was generated under, so that's
+// kept alongside it; anything else it depends on has to clear() it.
+class JKeystream
+{
+  public:
+    JKeystream();
+    ~JKeystream();
+
+    // Generates length bytes of keystream with cipher, which is taken over
+    // along with blockCipher, the block cipher a mode object refers to if
+    // there is one. With background set this happens on a native thread
+    // and start() returns right away.
+    void start(StreamTransformation* cipher, BlockCipher* blockCipher, const string& iv, const size_t length, const bool background, const volatile bool* interrupted = NULL);
+
+    // Stops a background fill and drops the keystream.
+    void clear();
+
+    // XORs in with the keystream into out if there's at least length bytes
+    // of it for iv, waiting for a background fill first. Returns false
+    // without touching out otherwise.
+    bool apply(const string& iv, const byte* in, byte* out, const size_t length);
+
+  private:
+    static void* run(void* ptr);
+    static void* waitDone(void* ptr);
+    static void wake(void* ptr);
+    void fill(const volatile bool* interrupted);
+    void wait();
+
+    member_ptr<BlockCipher> itsBlockCipher;
+    member_ptr<StreamTransformation> itsCipher;
+    SecByteBlock itsKeystream;
+    string itsIV;
+
+    pthread_t itsThread;
+    bool itsRunning;
+    volatile bool itsCancelled;
+    bool itsFailed;
+
+    // itsDone is set once the background fill is finished, and itsWoken
+    // when Ruby wants a thread waiting for it back
+    pthread_mutex_t itsMutex;
+    pthread_cond_t itsCond;
+    bool itsDone;
+    bool itsWoken;
+};
+
+#endif
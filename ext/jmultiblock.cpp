@@ -0,0 +1,1159 @@
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jmultiblock.h"
+#include "jfixedrounds.h"
+
+#if ENABLED_MULTIBLOCK
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Crypto++ headers...
+
+#include "cast.h"
+
+/* Rotates every lane by the same number of bits, bits < 32. These work on
+ * a plain word32 as well, for the key schedules. */
+template <class T>
+static inline T lanes_rotl(const T& x, const unsigned int bits)
+{
+  return (x << bits) | (x >> ((32 - bits) & 31));
+}
+
+template <class T>
+static inline T lanes_rotr(const T& x, const unsigned int bits)
+{
+  return (x >> bits) | (x << ((32 - bits) & 31));
+}
+
+/* Rotates each lane by the low five bits of the same lane of bits. */
+static inline JLanes lanes_rotlv(const JLanes& x, const JLanes& bits)
+{
+  const JLanes n = bits & 31;
+  return (x << n) | (x >> ((32 - n) & 31));
+}
+
+static inline JLanes lanes_rotrv(const JLanes& x, const JLanes& bits)
+{
+  const JLanes n = bits & 31;
+  return (x >> n) | (x << ((32 - n) & 31));
+}
+
+/* Looks each lane of index up in table, one lane at a time. This works on
+ * a plain word32 as well. */
+template <class T>
+static inline T lanes_lookup(const word32* table, const T& index)
+{
+  word32 lanes[sizeof(T) / sizeof(word32)];
+  T x;
+
+  memcpy(lanes, &index, sizeof(T));
+  for (size_t i = 0; i < sizeof(T) / sizeof(word32); ++i) {
+    lanes[i] = table[lanes[i]];
+  }
+  memcpy(&x, lanes, sizeof(T));
+  return x;
+}
+
+#if defined(__GNUC__) && defined(__AVX2__)
+/* AVX2 gathers all eight lanes at once. */
+static inline JLanes lanes_lookup(const word32* table, const JLanes& index)
+{
+  return (JLanes) _mm256_i32gather_epi32((const int*) table, (__m256i) index, 4);
+}
+#endif
+
+JMultiBlockCipher::JMultiBlockCipher(const BlockCipher& cipher, const ByteOrder order)
+  : itsCipher((BlockCipher*) cipher.Clone()), itsOrder(order)
+{
+}
+
+JMultiBlockCipher::JMultiBlockCipher(const JMultiBlockCipher& other)
+  : BlockCipher(other), itsCipher((BlockCipher*) other.itsCipher->Clone()), itsOrder(other.itsOrder)
+{
+}
+
+std::string JMultiBlockCipher::AlgorithmProvider() const
+{
+#if defined(__GNUC__) && defined(__AVX2__)
+  return "AVX2 8-way";
+#elif defined(__GNUC__) && defined(__SSE2__)
+  return "SSE2 4-way";
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+  return "NEON 4-way";
+#elif defined(__GNUC__)
+  return "C++ 4-way";
+#else
+  return "C++";
+#endif
+}
+
+void JMultiBlockCipher::UncheckedSetKey(const byte* key, unsigned int length, const NameValuePairs& params)
+{
+  itsCipher->SetKey(key, length, params);
+  schedule(key, length);
+}
+
+void JMultiBlockCipher::ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const
+{
+  itsCipher->ProcessAndXorBlock(inBlock, xorBlock, outBlock);
+}
+
+/* Whether the output lands partway into blocks that are read going
+ * forwards, so that later blocks are worked out from earlier outputs. */
+static bool chained(const byte* blocks, const byte* outBlocks, const size_t length)
+{
+  return blocks != NULL && blocks < outBlocks && outBlocks < blocks + length;
+}
+
+size_t JMultiBlockCipher::AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const
+{
+  const size_t blockSize = BlockSize();
+  const size_t blocks = length / blockSize;
+  const bool counter = (flags & BT_InBlockIsCounter) != 0;
+
+  // chained calls like CBC-MAC, OFB and CFB encryption feed each block's
+  // output into the next, which a pass would have read already
+  if ((flags & BT_DontIncrementInOutPointers) || blocks < MULTIBLOCK_LANES ||
+    (!(flags & BT_ReverseDirection) && (chained(inBlocks, outBlocks, counter ? blockSize : length) || chained(xorBlocks, outBlocks, length)))
+  ) {
+    return itsCipher->AdvancedProcessBlocks(inBlocks, xorBlocks, outBlocks, length, flags);
+  }
+
+  const size_t passes = blocks / MULTIBLOCK_LANES;
+  const size_t sliced = passes * MULTIBLOCK_LANES;
+  const size_t tail = blocks - sliced;
+
+  // the counter only ever has its last byte bumped, the same as
+  // BlockTransformation does it, and the mode takes care of the carry
+  byte tailCounter[4 * MULTIBLOCK_MAX_WORDS];
+  const byte* tailIn = inBlocks + sliced * blockSize;
+  if (counter) {
+    memcpy(tailCounter, inBlocks, blockSize);
+    tailCounter[blockSize - 1] += (byte) sliced;
+    tailIn = tailCounter;
+  }
+  const byte* tailXor = xorBlocks == NULL ? NULL : xorBlocks + sliced * blockSize;
+  byte* tailOut = outBlocks + sliced * blockSize;
+
+  // going backwards is how CBC decryption works in place, where each
+  // block's output overwrites the ciphertext the next block XORs with, so
+  // passes go from the end too and read everything before writing
+  if (flags & BT_ReverseDirection) {
+    if (tail > 0) {
+      itsCipher->AdvancedProcessBlocks(tailIn, tailXor, tailOut, tail * blockSize, flags);
+    }
+    for (size_t pass = passes; pass-- > 0;) {
+      processPass(inBlocks, xorBlocks, outBlocks, pass * MULTIBLOCK_LANES, MULTIBLOCK_LANES, flags);
+    }
+  }
+  else {
+    for (size_t pass = 0; pass < passes; ++pass) {
+      processPass(inBlocks, xorBlocks, outBlocks, pass * MULTIBLOCK_LANES, MULTIBLOCK_LANES, flags);
+    }
+    if (tail > 0) {
+      itsCipher->AdvancedProcessBlocks(tailIn, tailXor, tailOut, tail * blockSize, flags);
+    }
+  }
+
+  if (counter) {
+    const_cast<byte*>(inBlocks)[blockSize - 1] += (byte) blocks;
+  }
+
+  return length % blockSize;
+}
+
+void JMultiBlockCipher::processPass(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, const size_t first, const size_t blocks, const word32 flags) const
+{
+  const size_t blockSize = BlockSize();
+  const size_t words = blockSize / 4;
+  const bool counter = (flags & BT_InBlockIsCounter) != 0;
+  const bool xorInput = xorBlocks != NULL && (flags & BT_XorInput);
+  const bool xorOutput = xorBlocks != NULL && !xorInput;
+
+  // word j of block i goes in lane i of state[j]
+  word32 lanes[MULTIBLOCK_MAX_WORDS][MULTIBLOCK_LANES];
+  JLanes state[MULTIBLOCK_MAX_WORDS];
+  byte xorCopy[MULTIBLOCK_LANES * 4 * MULTIBLOCK_MAX_WORDS];
+  byte block[4 * MULTIBLOCK_MAX_WORDS];
+
+  for (size_t i = 0; i < blocks; ++i) {
+    const byte* in = inBlocks + (first + i) * blockSize;
+
+    if (counter) {
+      memcpy(block, inBlocks, blockSize);
+      block[blockSize - 1] += (byte) (first + i);
+      in = block;
+    }
+    if (xorInput) {
+      xorbuf(block, in, xorBlocks + (first + i) * blockSize, blockSize);
+      in = block;
+    }
+
+    for (size_t j = 0; j < words; ++j) {
+      lanes[j][i] = GetWord<word32>(false, itsOrder, in + 4 * j);
+    }
+  }
+  memcpy(state, lanes, words * sizeof(JLanes));
+
+  // the output may well be on top of the blocks XORed into it
+  if (xorOutput) {
+    memcpy(xorCopy, xorBlocks + first * blockSize, blocks * blockSize);
+  }
+
+  processLanes(state);
+  memcpy(lanes, state, words * sizeof(JLanes));
+
+  for (size_t i = 0; i < blocks; ++i) {
+    byte* out = outBlocks + (first + i) * blockSize;
+    const byte* x = xorOutput ? xorCopy + i * blockSize : NULL;
+
+    for (size_t j = 0; j < words; ++j) {
+      PutWord(false, itsOrder, out + 4 * j, lanes[j][i], x == NULL ? NULL : x + 4 * j);
+    }
+  }
+}
+
+// Serpent's S-boxes and their inverses on x[0] to x[3], the least
+// significant bit of each nibble first, with x[4] as scratch. They're the
+// same for a word of key as for a register of blocks. Each leaves its
+// output in a different order, which the last line puts back.
+
+template <class T>
+static inline void serpent_s0(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x3; x3 |= x0; x0 ^= x4; x4 ^= x2; x4 = ~x4; x3 ^= x1;
+  x1 &= x0; x1 ^= x4; x2 ^= x0; x0 ^= x3; x4 |= x0; x0 ^= x2;
+  x2 &= x1; x3 ^= x2; x1 = ~x1; x2 ^= x4; x1 ^= x2;
+  x[0] = x2; x[1] = x1; x[2] = x3; x[3] = x0;
+}
+
+template <class T>
+static inline void serpent_s1(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x1; x1 ^= x0; x0 ^= x3; x3 = ~x3; x4 &= x1; x0 |= x1;
+  x3 ^= x2; x0 ^= x3; x1 ^= x3; x3 ^= x4; x1 |= x4; x4 ^= x2;
+  x2 &= x0; x2 ^= x1; x1 |= x0; x0 = ~x0; x0 ^= x2; x4 ^= x1;
+  x[0] = x4; x[1] = x2; x[2] = x3; x[3] = x0;
+}
+
+template <class T>
+static inline void serpent_s2(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x3 = ~x3; x1 ^= x0; x4 = x0; x0 &= x2; x0 ^= x3; x3 |= x4;
+  x2 ^= x1; x3 ^= x1; x1 &= x0; x0 ^= x2; x2 &= x3; x3 |= x1;
+  x0 = ~x0; x3 ^= x0; x4 ^= x0; x0 ^= x2; x1 |= x2;
+  x[0] = x4; x[1] = x1; x[2] = x0; x[3] = x3;
+}
+
+template <class T>
+static inline void serpent_s3(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x1; x1 ^= x3; x3 |= x0; x4 &= x0; x0 ^= x2; x2 ^= x1;
+  x1 &= x3; x2 ^= x3; x0 |= x4; x4 ^= x3; x1 ^= x0; x0 &= x3;
+  x3 &= x4; x3 ^= x2; x4 |= x1; x2 &= x1; x4 ^= x3; x0 ^= x3;
+  x3 ^= x2;
+  x[0] = x3; x[1] = x4; x[2] = x1; x[3] = x0;
+}
+
+template <class T>
+static inline void serpent_s4(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x3; x3 &= x0; x0 ^= x4; x3 ^= x2; x2 |= x4; x0 ^= x1;
+  x4 ^= x3; x2 |= x0; x2 ^= x1; x1 &= x0; x1 ^= x4; x4 &= x2;
+  x2 ^= x3; x4 ^= x0; x3 |= x1; x1 = ~x1; x3 ^= x0;
+  x[0] = x1; x[1] = x2; x[2] = x3; x[3] = x4;
+}
+
+template <class T>
+static inline void serpent_s5(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x1; x1 |= x0; x2 ^= x1; x3 = ~x3; x4 ^= x0; x0 ^= x2;
+  x1 &= x4; x4 |= x3; x4 ^= x0; x0 &= x3; x1 ^= x3; x3 ^= x2;
+  x0 ^= x1; x2 &= x4; x1 ^= x2; x2 &= x0; x3 ^= x2;
+  x[0] = x4; x[1] = x0; x[2] = x1; x[3] = x3;
+}
+
+template <class T>
+static inline void serpent_s6(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x1; x3 ^= x0; x1 ^= x2; x2 ^= x0; x0 &= x3; x1 |= x3;
+  x4 = ~x4; x0 ^= x1; x1 ^= x2; x3 ^= x4; x4 ^= x0; x2 &= x0;
+  x4 ^= x1; x2 ^= x3; x3 &= x1; x3 ^= x0; x1 ^= x2;
+  x[0] = x2; x[1] = x4; x[2] = x1; x[3] = x3;
+}
+
+template <class T>
+static inline void serpent_s7(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x1 = ~x1; x4 = x1; x0 = ~x0; x1 &= x2; x1 ^= x3; x3 |= x4;
+  x4 ^= x2; x2 ^= x3; x3 ^= x0; x0 |= x1; x2 &= x0; x0 ^= x4;
+  x4 ^= x3; x3 &= x0; x4 ^= x1; x2 ^= x4; x3 ^= x1; x4 |= x0;
+  x4 ^= x1;
+  x[0] = x4; x[1] = x2; x[2] = x3; x[3] = x0;
+}
+
+template <class T>
+static inline void serpent_si0(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x3; x1 ^= x0; x3 |= x1; x4 ^= x1; x0 = ~x0; x2 ^= x3;
+  x3 ^= x0; x0 &= x1; x0 ^= x2; x2 &= x3; x3 ^= x4; x2 ^= x3;
+  x1 ^= x3; x3 &= x0; x1 ^= x0; x0 ^= x2; x4 ^= x3;
+  x[0] = x2; x[1] = x4; x[2] = x1; x[3] = x0;
+}
+
+template <class T>
+static inline void serpent_si1(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x1 ^= x3; x4 = x0; x0 ^= x2; x2 = ~x2; x4 |= x1; x4 ^= x3;
+  x3 &= x1; x1 ^= x2; x2 &= x4; x4 ^= x1; x1 |= x3; x3 ^= x0;
+  x2 ^= x0; x0 |= x4; x2 ^= x4; x1 ^= x0; x4 ^= x1;
+  x[0] = x4; x[1] = x1; x[2] = x2; x[3] = x3;
+}
+
+template <class T>
+static inline void serpent_si2(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x2 ^= x1; x4 = x3; x3 = ~x3; x3 |= x2; x2 ^= x4; x4 ^= x0;
+  x3 ^= x1; x1 |= x2; x2 ^= x0; x1 ^= x4; x4 |= x3; x2 ^= x3;
+  x4 ^= x2; x2 &= x1; x2 ^= x3; x3 ^= x4; x4 ^= x0;
+  x[0] = x1; x[1] = x4; x[2] = x3; x[3] = x2;
+}
+
+template <class T>
+static inline void serpent_si3(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x2 ^= x1; x4 = x1; x1 &= x2; x1 ^= x0; x0 |= x4; x4 ^= x3;
+  x0 ^= x3; x3 |= x1; x1 ^= x2; x1 ^= x3; x0 ^= x2; x2 ^= x3;
+  x3 &= x1; x1 ^= x0; x0 &= x2; x4 ^= x3; x3 ^= x0; x0 ^= x1;
+  x[0] = x2; x[1] = x0; x[2] = x4; x[3] = x3;
+}
+
+template <class T>
+static inline void serpent_si4(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x2 ^= x3; x4 = x0; x0 &= x1; x0 ^= x2; x2 |= x3; x4 = ~x4;
+  x1 ^= x0; x0 ^= x2; x2 &= x4; x2 ^= x0; x0 |= x4; x0 ^= x3;
+  x3 &= x2; x4 ^= x3; x3 ^= x1; x1 &= x0; x4 ^= x1; x0 ^= x3;
+  x[0] = x0; x[1] = x2; x[2] = x4; x[3] = x3;
+}
+
+template <class T>
+static inline void serpent_si5(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x1; x1 |= x2; x2 ^= x4; x1 ^= x3; x3 &= x4; x2 ^= x3;
+  x3 |= x0; x0 = ~x0; x3 ^= x2; x2 |= x0; x4 ^= x1; x2 ^= x4;
+  x4 &= x0; x0 ^= x1; x1 ^= x3; x0 &= x2; x2 ^= x3; x0 ^= x2;
+  x2 ^= x4; x4 ^= x3;
+  x[0] = x1; x[1] = x4; x[2] = x0; x[3] = x2;
+}
+
+template <class T>
+static inline void serpent_si6(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x0 ^= x2; x4 = x0; x0 &= x3; x2 ^= x3; x0 ^= x2; x3 ^= x1;
+  x2 |= x4; x2 ^= x3; x3 &= x0; x0 = ~x0; x3 ^= x1; x1 &= x2;
+  x4 ^= x0; x3 ^= x4; x4 ^= x2; x0 ^= x1; x2 ^= x0;
+  x[0] = x2; x[1] = x4; x[2] = x3; x[3] = x0;
+}
+
+template <class T>
+static inline void serpent_si7(T* x)
+{
+  T x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3], x4;
+  x4 = x3; x3 &= x0; x0 ^= x2; x2 |= x4; x4 ^= x1; x0 = ~x0;
+  x1 |= x3; x4 ^= x0; x0 &= x2; x0 ^= x1; x1 &= x2; x3 ^= x2;
+  x4 ^= x3; x2 &= x3; x3 |= x0; x1 ^= x4; x3 ^= x4; x4 &= x0;
+  x4 ^= x2;
+  x[0] = x1; x[1] = x3; x[2] = x0; x[3] = x4;
+}
+
+template <class T>
+static inline void serpent_sbox(const unsigned int n, T* x)
+{
+  switch (n % 8) {
+    case 0: serpent_s0(x); break;
+    case 1: serpent_s1(x); break;
+    case 2: serpent_s2(x); break;
+    case 3: serpent_s3(x); break;
+    case 4: serpent_s4(x); break;
+    case 5: serpent_s5(x); break;
+    case 6: serpent_s6(x); break;
+    case 7: serpent_s7(x); break;
+  }
+}
+
+static inline void serpent_key(JLanes* x, const word32* k)
+{
+  x[0] ^= k[0];
+  x[1] ^= k[1];
+  x[2] ^= k[2];
+  x[3] ^= k[3];
+}
+
+static inline void serpent_lt(JLanes* x)
+{
+  x[0] = lanes_rotl(x[0], 13);
+  x[2] = lanes_rotl(x[2], 3);
+  x[1] ^= x[0] ^ x[2];
+  x[3] ^= x[2] ^ (x[0] << 3);
+  x[1] = lanes_rotl(x[1], 1);
+  x[3] = lanes_rotl(x[3], 7);
+  x[0] ^= x[1] ^ x[3];
+  x[2] ^= x[3] ^ (x[1] << 7);
+  x[0] = lanes_rotl(x[0], 5);
+  x[2] = lanes_rotl(x[2], 22);
+}
+
+static inline void serpent_ilt(JLanes* x)
+{
+  x[2] = lanes_rotr(x[2], 22);
+  x[0] = lanes_rotr(x[0], 5);
+  x[2] ^= x[3] ^ (x[1] << 7);
+  x[0] ^= x[1] ^ x[3];
+  x[3] = lanes_rotr(x[3], 7);
+  x[1] = lanes_rotr(x[1], 1);
+  x[3] ^= x[2] ^ (x[0] << 3);
+  x[1] ^= x[0] ^ x[2];
+  x[2] = lanes_rotr(x[2], 3);
+  x[0] = lanes_rotr(x[0], 13);
+}
+
+/* Eight rounds, one through each S-box, starting at round. */
+static inline void serpent_encrypt8(JLanes* x, const word32* k, const unsigned int round)
+{
+  serpent_key(x, k + 4 * round);       serpent_s0(x); serpent_lt(x);
+  serpent_key(x, k + 4 * (round + 1)); serpent_s1(x); serpent_lt(x);
+  serpent_key(x, k + 4 * (round + 2)); serpent_s2(x); serpent_lt(x);
+  serpent_key(x, k + 4 * (round + 3)); serpent_s3(x); serpent_lt(x);
+  serpent_key(x, k + 4 * (round + 4)); serpent_s4(x); serpent_lt(x);
+  serpent_key(x, k + 4 * (round + 5)); serpent_s5(x); serpent_lt(x);
+  serpent_key(x, k + 4 * (round + 6)); serpent_s6(x); serpent_lt(x);
+  serpent_key(x, k + 4 * (round + 7)); serpent_s7(x);
+}
+
+static inline void serpent_decrypt8(JLanes* x, const word32* k, const unsigned int round)
+{
+  serpent_si7(x); serpent_key(x, k + 4 * (round + 7)); serpent_ilt(x);
+  serpent_si6(x); serpent_key(x, k + 4 * (round + 6)); serpent_ilt(x);
+  serpent_si5(x); serpent_key(x, k + 4 * (round + 5)); serpent_ilt(x);
+  serpent_si4(x); serpent_key(x, k + 4 * (round + 4)); serpent_ilt(x);
+  serpent_si3(x); serpent_key(x, k + 4 * (round + 3)); serpent_ilt(x);
+  serpent_si2(x); serpent_key(x, k + 4 * (round + 2)); serpent_ilt(x);
+  serpent_si1(x); serpent_key(x, k + 4 * (round + 1)); serpent_ilt(x);
+  serpent_si0(x); serpent_key(x, k + 4 * round);
+}
+
+JSerpentMultiBlock::JSerpentMultiBlock(const BlockCipher& cipher, const byte* key, const size_t length)
+  : JMultiBlockCipher(cipher, LITTLE_ENDIAN_ORDER)
+{
+  schedule(key, length);
+}
+
+void JSerpentMultiBlock::schedule(const byte* key, const size_t length)
+{
+  word32* k = itsKeys;
+  word32 w[8];
+
+  // a short key gets a single bit set after it
+  GetUserKey(LITTLE_ENDIAN_ORDER, w, 8, key, length);
+  if (length < 32) {
+    w[length / 4] |= word32(1) << ((length % 4) * 8);
+  }
+
+  for (unsigned int i = 0; i < 33 * 4; ++i) {
+    word32 t = rotlFixed((i < 8 ? w[i] : k[i - 8]) ^ (i < 5 ? w[i + 3] : k[i - 5]) ^ (i < 3 ? w[i + 5] : k[i - 3]) ^ (i < 1 ? w[7] : k[i - 1]) ^ 0x9e3779b9 ^ i, 11);
+    k[i] = t;
+  }
+
+  // round key i goes through S-box 3 - i
+  for (unsigned int i = 0; i < 33; ++i) {
+    serpent_sbox(35 - i, k + 4 * i);
+  }
+}
+
+void JSerpentMultiBlock::processLanes(JLanes* words) const
+{
+  const word32* k = itsKeys;
+
+  if (IsForwardTransformation()) {
+    for (unsigned int round = 0; round < 32; round += 8) {
+      if (round > 0) {
+        serpent_lt(words);
+      }
+      serpent_encrypt8(words, k, round);
+    }
+    serpent_key(words, k + 4 * 32);
+  }
+  else {
+    serpent_key(words, k + 4 * 32);
+    for (unsigned int round = 32; round > 0; round -= 8) {
+      if (round < 32) {
+        serpent_ilt(words);
+      }
+      serpent_decrypt8(words, k, round - 8);
+    }
+  }
+}
+
+JRC6MultiBlock::JRC6MultiBlock(const BlockCipher& cipher, const byte* key, const size_t length, const unsigned int rounds)
+  : JMultiBlockCipher(cipher, LITTLE_ENDIAN_ORDER), itsRounds(rounds)
+{
+  schedule(key, length);
+}
+
+void JRC6MultiBlock::schedule(const byte* key, const size_t length)
+{
+  itsTable.New(2 * itsRounds + 4);
+  rcKeySchedule(key, length, itsTable, itsTable.size());
+}
+
+void JRC6MultiBlock::processLanes(JLanes* words) const
+{
+  const word32* s = itsTable;
+  JLanes a = words[0], b = words[1], c = words[2], d = words[3], t, u, x;
+
+  if (IsForwardTransformation()) {
+    b += s[0];
+    d += s[1];
+    for (unsigned int i = 1; i <= itsRounds; ++i) {
+      t = lanes_rotl(b * (2 * b + 1), 5);
+      u = lanes_rotl(d * (2 * d + 1), 5);
+      a = lanes_rotlv(a ^ t, u) + s[2 * i];
+      c = lanes_rotlv(c ^ u, t) + s[2 * i + 1];
+      x = a; a = b; b = c; c = d; d = x;
+    }
+    a += s[2 * itsRounds + 2];
+    c += s[2 * itsRounds + 3];
+  }
+  else {
+    c -= s[2 * itsRounds + 3];
+    a -= s[2 * itsRounds + 2];
+    for (unsigned int i = itsRounds; i >= 1; --i) {
+      x = d; d = c; c = b; b = a; a = x;
+      u = lanes_rotl(d * (2 * d + 1), 5);
+      t = lanes_rotl(b * (2 * b + 1), 5);
+      c = lanes_rotrv(c - s[2 * i + 1], t) ^ u;
+      a = lanes_rotrv(a - s[2 * i], u) ^ t;
+    }
+    d -= s[1];
+    b -= s[0];
+  }
+
+  words[0] = a;
+  words[1] = b;
+  words[2] = c;
+  words[3] = d;
+}
+
+// SHA-256's round constants, the first 32 bits of the fractional parts of
+// the cube roots of the first 64 primes.
+static const word32 SHACAL2_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline JLanes shacal2_s0(const JLanes& a)
+{
+  return lanes_rotr(a, 2) ^ lanes_rotr(a, 13) ^ lanes_rotr(a, 22);
+}
+
+static inline JLanes shacal2_s1(const JLanes& e)
+{
+  return lanes_rotr(e, 6) ^ lanes_rotr(e, 11) ^ lanes_rotr(e, 25);
+}
+
+static inline JLanes shacal2_ch(const JLanes& e, const JLanes& f, const JLanes& g)
+{
+  return g ^ (e & (f ^ g));
+}
+
+static inline JLanes shacal2_maj(const JLanes& a, const JLanes& b, const JLanes& c)
+{
+  return (a & b) | (c & (a | b));
+}
+
+JSHACAL2MultiBlock::JSHACAL2MultiBlock(const BlockCipher& cipher, const byte* key, const size_t length)
+  : JMultiBlockCipher(cipher, BIG_ENDIAN_ORDER)
+{
+  schedule(key, length);
+}
+
+void JSHACAL2MultiBlock::schedule(const byte* key, const size_t length)
+{
+  word32* w = itsKeys;
+
+  // the key is the message block, expanded the same way SHA-256 does
+  GetUserKey(BIG_ENDIAN_ORDER, w, 16, key, length);
+  for (unsigned int i = 16; i < 64; ++i) {
+    w[i] = w[i - 16] + (rotrFixed(w[i - 15], 7) ^ rotrFixed(w[i - 15], 18) ^ (w[i - 15] >> 3)) +
+      w[i - 7] + (rotrFixed(w[i - 2], 17) ^ rotrFixed(w[i - 2], 19) ^ (w[i - 2] >> 10));
+  }
+  for (unsigned int i = 0; i < 64; ++i) {
+    w[i] += SHACAL2_K[i];
+  }
+}
+
+void JSHACAL2MultiBlock::processLanes(JLanes* words) const
+{
+  const word32* k = itsKeys;
+  JLanes a = words[0], b = words[1], c = words[2], d = words[3];
+  JLanes e = words[4], f = words[5], g = words[6], h = words[7], t1, t2;
+
+  if (IsForwardTransformation()) {
+    for (unsigned int i = 0; i < 64; ++i) {
+      t1 = h + shacal2_s1(e) + shacal2_ch(e, f, g) + k[i];
+      t2 = shacal2_s0(a) + shacal2_maj(a, b, c);
+      h = g; g = f; f = e; e = d + t1;
+      d = c; c = b; b = a; a = t1 + t2;
+    }
+  }
+  else {
+    // each round only really makes a and e, so the rest shift back and
+    // those two give up the old d and h
+    for (unsigned int i = 64; i-- > 0;) {
+      t1 = a; t2 = e;
+      a = b; b = c; c = d;
+      e = f; f = g; g = h;
+      t1 -= shacal2_s0(a) + shacal2_maj(a, b, c);
+      d = t2 - t1;
+      h = t1 - shacal2_s1(e) - shacal2_ch(e, f, g) - k[i];
+    }
+  }
+
+  words[0] = a; words[1] = b; words[2] = c; words[3] = d;
+  words[4] = e; words[5] = f; words[6] = g; words[7] = h;
+}
+
+// The 4-bit permutations that Twofish's q0 and q1 are built from.
+static const byte TWOFISH_T[2][4][16] = {
+  {
+    { 0x8, 0x1, 0x7, 0xd, 0x6, 0xf, 0x3, 0x2, 0x0, 0xb, 0x5, 0x9, 0xe, 0xc, 0xa, 0x4 },
+    { 0xe, 0xc, 0xb, 0x8, 0x1, 0x2, 0x3, 0x5, 0xf, 0x4, 0xa, 0x6, 0x7, 0x0, 0x9, 0xd },
+    { 0xb, 0xa, 0x5, 0xe, 0x6, 0xd, 0x9, 0x0, 0xc, 0x8, 0xf, 0x3, 0x2, 0x4, 0x7, 0x1 },
+    { 0xd, 0x7, 0xf, 0x4, 0x1, 0x2, 0x6, 0xe, 0x9, 0xb, 0x3, 0x0, 0x8, 0x5, 0xc, 0xa }
+  },
+  {
+    { 0x2, 0x8, 0xb, 0xd, 0xf, 0x7, 0x6, 0xe, 0x3, 0x1, 0x9, 0x4, 0x0, 0xa, 0xc, 0x5 },
+    { 0x1, 0xe, 0x2, 0xb, 0x4, 0xc, 0x3, 0x7, 0x6, 0xd, 0xa, 0x5, 0xf, 0x9, 0x0, 0x8 },
+    { 0x4, 0xc, 0x7, 0x5, 0x1, 0x6, 0x9, 0xa, 0x0, 0xe, 0xd, 0x8, 0x2, 0xb, 0x3, 0xf },
+    { 0xb, 0x9, 0x5, 0x1, 0xc, 0x3, 0xd, 0xe, 0x6, 0x4, 0x7, 0xf, 0x2, 0x0, 0x8, 0xa }
+  }
+};
+
+// Which of q0 and q1 each byte of h goes through, from the one keyed by
+// the last key word to the one after the first.
+static const byte TWOFISH_Q_ORDER[4][5] = {
+  { 1, 1, 0, 0, 1 },
+  { 0, 1, 1, 0, 0 },
+  { 0, 0, 0, 1, 1 },
+  { 1, 0, 1, 1, 0 }
+};
+
+static const byte TWOFISH_MDS[4][4] = {
+  { 0x01, 0xef, 0x5b, 0x5b },
+  { 0x5b, 0xef, 0xef, 0x01 },
+  { 0xef, 0x5b, 0x01, 0xef },
+  { 0xef, 0x01, 0xef, 0x5b }
+};
+
+static const byte TWOFISH_RS[4][8] = {
+  { 0x01, 0xa4, 0x55, 0x87, 0x5a, 0x58, 0xdb, 0x9e },
+  { 0xa4, 0x56, 0x82, 0xf3, 0x1e, 0xc6, 0x68, 0xe5 },
+  { 0x02, 0xa1, 0xfc, 0xc1, 0x47, 0xae, 0x3d, 0x19 },
+  { 0xa4, 0x55, 0x87, 0x5a, 0x58, 0xdb, 0x9e, 0x03 }
+};
+
+static byte twofish_q(const byte t[4][16], const byte x)
+{
+  byte a = x >> 4, b = x & 0xf;
+
+  for (unsigned int i = 0; i < 4; i += 2) {
+    const byte c = a ^ b, d = (a ^ (b >> 1) ^ (b << 3) ^ (a << 3)) & 0xf;
+    a = t[i][c];
+    b = t[i + 1][d];
+  }
+  return (b << 4) | a;
+}
+
+/* Multiplies in GF(2^8) modulo the polynomial with the given low byte. */
+static byte twofish_multiply(byte a, byte b, const byte polynomial)
+{
+  byte product = 0;
+
+  for (; b != 0; b >>= 1) {
+    if (b & 1) {
+      product ^= a;
+    }
+    a = (a << 1) ^ ((a & 0x80) ? polynomial : 0);
+  }
+  return product;
+}
+
+/* Column column of the MDS matrix times y. */
+static word32 twofish_mds(const unsigned int column, const byte y)
+{
+  word32 z = 0;
+
+  for (unsigned int i = 0; i < 4; ++i) {
+    z |= word32(twofish_multiply(TWOFISH_MDS[i][column], y, 0x69)) << (8 * i);
+  }
+  return z;
+}
+
+/* Byte i of x through its q0s and q1s, keyed by the k words of l. */
+static byte twofish_sbox(const byte q[2][256], const unsigned int i, const byte x, const word32* l, const unsigned int k)
+{
+  byte y = x;
+
+  for (unsigned int m = k; m-- > 0;) {
+    y = q[TWOFISH_Q_ORDER[i][3 - m]][y] ^ GETBYTE(l[m], i);
+  }
+  return q[TWOFISH_Q_ORDER[i][4]][y];
+}
+
+static word32 twofish_h(const byte q[2][256], const word32 x, const word32* l, const unsigned int k)
+{
+  word32 z = 0;
+
+  for (unsigned int i = 0; i < 4; ++i) {
+    z ^= twofish_mds(i, twofish_sbox(q, i, GETBYTE(x, i), l, k));
+  }
+  return z;
+}
+
+static inline JLanes twofish_g(const word32* s, const JLanes& x)
+{
+  return lanes_lookup(s, x & 0xff) ^ lanes_lookup(s + 256, (x >> 8) & 0xff) ^
+    lanes_lookup(s + 512, (x >> 16) & 0xff) ^ lanes_lookup(s + 768, x >> 24);
+}
+
+JTwofishMultiBlock::JTwofishMultiBlock(const BlockCipher& cipher, const byte* key, const size_t length)
+  : JMultiBlockCipher(cipher, LITTLE_ENDIAN_ORDER)
+{
+  schedule(key, length);
+}
+
+void JTwofishMultiBlock::schedule(const byte* key, const size_t length)
+{
+  byte q[2][256];
+  byte m[32] = { 0 };
+  word32 even[4], odd[4], s[4];
+
+  for (unsigned int x = 0; x < 256; ++x) {
+    q[0][x] = twofish_q(TWOFISH_T[0], x);
+    q[1][x] = twofish_q(TWOFISH_T[1], x);
+  }
+
+  // the key is padded out with zeroes to 128, 192 or 256 bits, like
+  // Crypto++ does it, and S comes out in reverse
+  const unsigned int k = length <= 16 ? 2 : (length <= 24 ? 3 : 4);
+  memcpy(m, key, length);
+  for (unsigned int i = 0; i < k; ++i) {
+    even[i] = GetWord<word32>(false, LITTLE_ENDIAN_ORDER, m + 8 * i);
+    odd[i] = GetWord<word32>(false, LITTLE_ENDIAN_ORDER, m + 8 * i + 4);
+    s[k - 1 - i] = 0;
+    for (unsigned int j = 0; j < 4; ++j) {
+      byte t = 0;
+      for (unsigned int c = 0; c < 8; ++c) {
+        t ^= twofish_multiply(TWOFISH_RS[j][c], m[8 * i + c], 0x4d);
+      }
+      s[k - 1 - i] |= word32(t) << (8 * j);
+    }
+  }
+
+  for (unsigned int i = 0; i < 20; ++i) {
+    const word32 a = twofish_h(q, 2 * i * 0x01010101, even, k);
+    const word32 b = rotlFixed(twofish_h(q, (2 * i + 1) * 0x01010101, odd, k), 8);
+    itsKeys[2 * i] = a + b;
+    itsKeys[2 * i + 1] = rotlFixed(a + 2 * b, 9);
+  }
+
+  // g's S-boxes with the MDS matrix already applied, one table a byte
+  for (unsigned int i = 0; i < 4; ++i) {
+    for (unsigned int x = 0; x < 256; ++x) {
+      itsSBoxes[256 * i + x] = twofish_mds(i, twofish_sbox(q, i, x, s, k));
+    }
+  }
+}
+
+void JTwofishMultiBlock::processLanes(JLanes* words) const
+{
+  const word32* k = itsKeys;
+  const word32* s = itsSBoxes;
+  JLanes r0, r1, r2, r3, t0, t1;
+
+  if (IsForwardTransformation()) {
+    r0 = words[0] ^ k[0];
+    r1 = words[1] ^ k[1];
+    r2 = words[2] ^ k[2];
+    r3 = words[3] ^ k[3];
+    for (unsigned int round = 0; round < 16; round += 2) {
+      t0 = twofish_g(s, r0);
+      t1 = twofish_g(s, lanes_rotl(r1, 8));
+      r2 = lanes_rotr(r2 ^ (t0 + t1 + k[2 * round + 8]), 1);
+      r3 = lanes_rotl(r3, 1) ^ (t0 + 2 * t1 + k[2 * round + 9]);
+      t0 = twofish_g(s, r2);
+      t1 = twofish_g(s, lanes_rotl(r3, 8));
+      r0 = lanes_rotr(r0 ^ (t0 + t1 + k[2 * round + 10]), 1);
+      r1 = lanes_rotl(r1, 1) ^ (t0 + 2 * t1 + k[2 * round + 11]);
+    }
+    words[0] = r2 ^ k[4];
+    words[1] = r3 ^ k[5];
+    words[2] = r0 ^ k[6];
+    words[3] = r1 ^ k[7];
+  }
+  else {
+    r2 = words[0] ^ k[4];
+    r3 = words[1] ^ k[5];
+    r0 = words[2] ^ k[6];
+    r1 = words[3] ^ k[7];
+    for (unsigned int round = 16; round > 0; round -= 2) {
+      t0 = twofish_g(s, r2);
+      t1 = twofish_g(s, lanes_rotl(r3, 8));
+      r1 = lanes_rotr(r1 ^ (t0 + 2 * t1 + k[2 * round + 7]), 1);
+      r0 = lanes_rotl(r0, 1) ^ (t0 + t1 + k[2 * round + 6]);
+      t0 = twofish_g(s, r0);
+      t1 = twofish_g(s, lanes_rotl(r1, 8));
+      r3 = lanes_rotr(r3 ^ (t0 + 2 * t1 + k[2 * round + 5]), 1);
+      r2 = lanes_rotl(r2, 1) ^ (t0 + t1 + k[2 * round + 4]);
+    }
+    words[0] = r0 ^ k[0];
+    words[1] = r1 ^ k[1];
+    words[2] = r2 ^ k[2];
+    words[3] = r3 ^ k[3];
+  }
+}
+
+// Camellia's first S-box. The other three are rotations of it, of its
+// output for s2 and s3 and of its input for s4.
+static const byte CAMELLIA_S1[256] = {
+  112, 130,  44, 236, 179,  39, 192, 229, 228, 133,  87,  53, 234,  12, 174,  65,
+   35, 239, 107, 147,  69,  25, 165,  33, 237,  14,  79,  78,  29, 101, 146, 189,
+  134, 184, 175, 143, 124, 235,  31, 206,  62,  48, 220,  95,  94, 197,  11,  26,
+  166, 225,  57, 202, 213,  71,  93,  61, 217,   1,  90, 214,  81,  86, 108,  77,
+  139,  13, 154, 102, 251, 204, 176,  45, 116,  18,  43,  32, 240, 177, 132, 153,
+  223,  76, 203, 194,  52, 126, 118,   5, 109, 183, 169,  49, 209,  23,   4, 215,
+   20,  88,  58,  97, 222,  27,  17,  28,  50,  15, 156,  22,  83,  24, 242,  34,
+  254,  68, 207, 178, 195, 181, 122, 145,  36,   8, 232, 168,  96, 252, 105,  80,
+  170, 208, 160, 125, 161, 137,  98, 151,  84,  91,  30, 149, 224, 255, 100, 210,
+   16, 196,   0,  72, 163, 247, 117, 219, 138,   3, 230, 218,   9,  63, 221, 148,
+  135,  92, 131,   2, 205,  74, 144,  51, 115, 103, 246, 243, 157, 127, 191, 226,
+   82, 155, 216,  38, 200,  55, 198,  59, 129, 150, 111,  75,  19, 190,  99,  46,
+  233, 121, 167, 140, 159, 110, 188, 142,  41, 245, 249, 182,  47, 253, 180,  89,
+  120, 152,   6, 106, 231,  70, 113, 186, 212,  37, 171,  66, 136, 162, 141, 250,
+  114,   7, 185,  85, 248, 238, 172,  10,  54,  73,  42, 104,  60,  56, 241, 164,
+   64,  40, 211, 123, 187, 201,  67, 193,  21, 227, 173, 244, 119, 199, 128, 158
+};
+
+// The constants the key schedule mixes in, as pairs of words.
+static const word32 CAMELLIA_SIGMA[12] = {
+  0xa09e667f, 0x3bcc908b, 0xb67ae858, 0x4caa73b2, 0xc6ef372f, 0xe94f82be,
+  0x54ff53a5, 0xf1d36f1c, 0x10e527fa, 0xde682d1d, 0xb05688c2, 0xb3e6c1fd
+};
+
+// Where each 64-bit subkey comes from, in the order encryption uses them:
+// which of KL, KR, KA and KB, how far it's rotated and which half is kept.
+static const byte CAMELLIA_KEYS_128[26][3] = {
+  { 0,   0, 0 }, { 0,   0, 1 }, { 2,   0, 0 }, { 2,   0, 1 }, { 0,  15, 0 }, { 0,  15, 1 },
+  { 2,  15, 0 }, { 2,  15, 1 }, { 2,  30, 0 }, { 2,  30, 1 }, { 0,  45, 0 }, { 0,  45, 1 },
+  { 2,  45, 0 }, { 0,  60, 1 }, { 2,  60, 0 }, { 2,  60, 1 }, { 0,  77, 0 }, { 0,  77, 1 },
+  { 0,  94, 0 }, { 0,  94, 1 }, { 2,  94, 0 }, { 2,  94, 1 }, { 0, 111, 0 }, { 0, 111, 1 },
+  { 2, 111, 0 }, { 2, 111, 1 }
+};
+
+static const byte CAMELLIA_KEYS_256[34][3] = {
+  { 0,   0, 0 }, { 0,   0, 1 }, { 3,   0, 0 }, { 3,   0, 1 }, { 1,  15, 0 }, { 1,  15, 1 },
+  { 2,  15, 0 }, { 2,  15, 1 }, { 1,  30, 0 }, { 1,  30, 1 }, { 3,  30, 0 }, { 3,  30, 1 },
+  { 0,  45, 0 }, { 0,  45, 1 }, { 2,  45, 0 }, { 2,  45, 1 }, { 0,  60, 0 }, { 0,  60, 1 },
+  { 1,  60, 0 }, { 1,  60, 1 }, { 3,  60, 0 }, { 3,  60, 1 }, { 0,  77, 0 }, { 0,  77, 1 },
+  { 2,  77, 0 }, { 2,  77, 1 }, { 1,  94, 0 }, { 1,  94, 1 }, { 2,  94, 0 }, { 2,  94, 1 },
+  { 0, 111, 0 }, { 0, 111, 1 }, { 3, 111, 0 }, { 3, 111, 1 }
+};
+
+/* The F function on the 64 bits in xl and xr, with the S-boxes and the P
+ * function done together through the four tables in sp. */
+template <class T>
+static inline void camellia_f(const word32* sp, const T& xl, const T& xr, const word32 kl, const word32 kr, T& yl, T& yr)
+{
+  const T il = xl ^ kl, ir = xr ^ kr;
+
+  yl = lanes_lookup(sp, ir & 0xff) ^ lanes_lookup(sp + 256, ir >> 24) ^
+    lanes_lookup(sp + 512, (ir >> 16) & 0xff) ^ lanes_lookup(sp + 768, (ir >> 8) & 0xff);
+  yr = lanes_lookup(sp, il >> 24) ^ lanes_lookup(sp + 256, (il >> 16) & 0xff) ^
+    lanes_lookup(sp + 512, (il >> 8) & 0xff) ^ lanes_lookup(sp + 768, il & 0xff);
+  yl ^= yr;
+  yr = lanes_rotr(yr, 8) ^ yl;
+}
+
+/* Two rounds on the 128 bits in d, keyed by the four words in k. */
+static void camellia_rounds(const word32* sp, word32* d, const word32* k)
+{
+  word32 yl, yr;
+
+  camellia_f(sp, d[0], d[1], k[0], k[1], yl, yr);
+  d[2] ^= yl;
+  d[3] ^= yr;
+  camellia_f(sp, d[2], d[3], k[2], k[3], yl, yr);
+  d[0] ^= yl;
+  d[1] ^= yr;
+}
+
+JCamelliaMultiBlock::JCamelliaMultiBlock(const BlockCipher& cipher, const byte* key, const size_t length)
+  : JMultiBlockCipher(cipher, BIG_ENDIAN_ORDER)
+{
+  schedule(key, length);
+}
+
+void JCamelliaMultiBlock::schedule(const byte* key, const size_t length)
+{
+  word32* sp = itsSP;
+
+  for (unsigned int x = 0; x < 256; ++x) {
+    const word32 s1 = CAMELLIA_S1[x];
+    const word32 s2 = byte((s1 << 1) | (s1 >> 7));
+    const word32 s3 = byte((s1 >> 1) | (s1 << 7));
+    const word32 s4 = CAMELLIA_S1[byte((x << 1) | (x >> 7))];
+
+    sp[x] = s1 * 0x01010100;
+    sp[256 + x] = s2 * 0x00010101;
+    sp[512 + x] = s3 * 0x01000101;
+    sp[768 + x] = s4 * 0x01010001;
+  }
+
+  // KL, KR, KA and KB, with a 192-bit key's KR filled out by its
+  // complement
+  word32 k[4][4] = { { 0 } };
+
+  GetUserKey(BIG_ENDIAN_ORDER, k[0], 8, key, length);
+  if (length == 24) {
+    k[1][2] = ~k[1][0];
+    k[1][3] = ~k[1][1];
+  }
+
+  for (unsigned int i = 0; i < 4; ++i) {
+    k[2][i] = k[0][i] ^ k[1][i];
+  }
+  camellia_rounds(sp, k[2], CAMELLIA_SIGMA);
+  for (unsigned int i = 0; i < 4; ++i) {
+    k[2][i] ^= k[0][i];
+  }
+  camellia_rounds(sp, k[2], CAMELLIA_SIGMA + 4);
+  for (unsigned int i = 0; i < 4; ++i) {
+    k[3][i] = k[2][i] ^ k[1][i];
+  }
+  camellia_rounds(sp, k[3], CAMELLIA_SIGMA + 8);
+
+  const byte (*keys)[3] = length > 16 ? CAMELLIA_KEYS_256 : CAMELLIA_KEYS_128;
+  const unsigned int count = length > 16 ? 34 : 26;
+  word32* subkeys = itsKeys;
+
+  itsRounds = length > 16 ? 24 : 18;
+  for (unsigned int i = 0; i < count; ++i) {
+    const word32* source = k[keys[i][0]];
+    const unsigned int words = keys[i][1] / 32, bits = keys[i][1] % 32;
+
+    for (unsigned int j = 0; j < 2; ++j) {
+      const unsigned int w = 2 * keys[i][2] + j + words;
+      subkeys[2 * i + j] = bits == 0 ? source[w % 4] : (source[w % 4] << bits) | (source[(w + 1) % 4] >> (32 - bits));
+    }
+  }
+
+  // decryption takes the same subkeys backwards, apart from the pairs
+  // that whiten the block at either end
+  if (!IsForwardTransformation()) {
+    for (unsigned int i = 0; i < count / 2; ++i) {
+      std::swap(subkeys[2 * i], subkeys[2 * (count - 1 - i)]);
+      std::swap(subkeys[2 * i + 1], subkeys[2 * (count - 1 - i) + 1]);
+    }
+    for (unsigned int i = 0; i < 2; ++i) {
+      std::swap(subkeys[i], subkeys[i + 2]);
+      std::swap(subkeys[2 * count - 4 + i], subkeys[2 * count - 2 + i]);
+    }
+  }
+}
+
+void JCamelliaMultiBlock::processLanes(JLanes* words) const
+{
+  const word32* sp = itsSP;
+  const word32* k = itsKeys;
+  JLanes l1 = words[0], r1 = words[1], l2 = words[2], r2 = words[3], yl, yr;
+
+  l1 ^= k[0];
+  r1 ^= k[1];
+  l2 ^= k[2];
+  r2 ^= k[3];
+  k += 4;
+
+  for (unsigned int round = 0; round < itsRounds; round += 2) {
+    // FL on the left half and its inverse on the right every six rounds
+    if (round > 0 && round % 6 == 0) {
+      r1 ^= lanes_rotl(l1 & k[0], 1);
+      l1 ^= r1 | k[1];
+      l2 ^= r2 | k[3];
+      r2 ^= lanes_rotl(l2 & k[2], 1);
+      k += 4;
+    }
+
+    camellia_f(sp, l1, r1, k[0], k[1], yl, yr);
+    l2 ^= yl;
+    r2 ^= yr;
+    camellia_f(sp, l2, r2, k[2], k[3], yl, yr);
+    l1 ^= yl;
+    r1 ^= yr;
+    k += 4;
+  }
+
+  words[0] = l2 ^ k[0];
+  words[1] = r2 ^ k[1];
+  words[2] = l1 ^ k[2];
+  words[3] = r1 ^ k[3];
+}
+
+// Crypto++ only lets the CAST ciphers at the S-boxes they share. CAST-256
+// uses the first four.
+struct JCASTSBoxes : public CAST
+{
+  static const word32* sboxes() { return S[0]; }
+};
+
+template <class T>
+static inline T cast256_f1(const word32* s, const T& x, const word32 km, const unsigned int kr)
+{
+  const T i = lanes_rotl(km + x, kr);
+  return ((lanes_lookup(s, i >> 24) ^ lanes_lookup(s + 256, (i >> 16) & 0xff)) -
+    lanes_lookup(s + 512, (i >> 8) & 0xff)) + lanes_lookup(s + 768, i & 0xff);
+}
+
+template <class T>
+static inline T cast256_f2(const word32* s, const T& x, const word32 km, const unsigned int kr)
+{
+  const T i = lanes_rotl(km ^ x, kr);
+  return ((lanes_lookup(s, i >> 24) - lanes_lookup(s + 256, (i >> 16) & 0xff)) +
+    lanes_lookup(s + 512, (i >> 8) & 0xff)) ^ lanes_lookup(s + 768, i & 0xff);
+}
+
+template <class T>
+static inline T cast256_f3(const word32* s, const T& x, const word32 km, const unsigned int kr)
+{
+  const T i = lanes_rotl(km - x, kr);
+  return ((lanes_lookup(s, i >> 24) + lanes_lookup(s + 256, (i >> 16) & 0xff)) ^
+    lanes_lookup(s + 512, (i >> 8) & 0xff)) - lanes_lookup(s + 768, i & 0xff);
+}
+
+/* A forward quad-round, and a reverse one, which also undoes it. */
+static inline void cast256_q(const word32* s, JLanes* x, const word32* km, const word32* kr)
+{
+  x[2] ^= cast256_f1(s, x[3], km[0], kr[0]);
+  x[1] ^= cast256_f2(s, x[2], km[1], kr[1]);
+  x[0] ^= cast256_f3(s, x[1], km[2], kr[2]);
+  x[3] ^= cast256_f1(s, x[0], km[3], kr[3]);
+}
+
+static inline void cast256_qbar(const word32* s, JLanes* x, const word32* km, const word32* kr)
+{
+  x[3] ^= cast256_f1(s, x[0], km[3], kr[3]);
+  x[0] ^= cast256_f3(s, x[1], km[2], kr[2]);
+  x[1] ^= cast256_f2(s, x[2], km[1], kr[1]);
+  x[2] ^= cast256_f1(s, x[3], km[0], kr[0]);
+}
+
+JCAST256MultiBlock::JCAST256MultiBlock(const BlockCipher& cipher, const byte* key, const size_t length)
+  : JMultiBlockCipher(cipher, BIG_ENDIAN_ORDER)
+{
+  schedule(key, length);
+}
+
+void JCAST256MultiBlock::schedule(const byte* key, const size_t length)
+{
+  const word32* s = JCASTSBoxes::sboxes();
+  word32 k[8], tm[8];
+  unsigned int tr[8];
+  word32 cm = 0x5a827999;
+  unsigned int cr = 19;
+
+  // the key is padded out with zeroes to 256 bits and run through 24
+  // forward octave-rounds, every other one of which gives a round's keys
+  GetUserKey(BIG_ENDIAN_ORDER, k, 8, key, length);
+  for (unsigned int i = 0; i < 24; ++i) {
+    for (unsigned int j = 0; j < 8; ++j) {
+      tm[j] = cm;
+      cm += 0x6ed9eba1;
+      tr[j] = cr;
+      cr = (cr + 17) % 32;
+    }
+
+    k[6] ^= cast256_f1(s, k[7], tm[0], tr[0]);
+    k[5] ^= cast256_f2(s, k[6], tm[1], tr[1]);
+    k[4] ^= cast256_f3(s, k[5], tm[2], tr[2]);
+    k[3] ^= cast256_f1(s, k[4], tm[3], tr[3]);
+    k[2] ^= cast256_f2(s, k[3], tm[4], tr[4]);
+    k[1] ^= cast256_f3(s, k[2], tm[5], tr[5]);
+    k[0] ^= cast256_f1(s, k[1], tm[6], tr[6]);
+    k[7] ^= cast256_f2(s, k[0], tm[7], tr[7]);
+
+    if (i % 2 == 1) {
+      word32* km = itsMasks + 2 * (i - 1);
+      word32* kr = itsRotations + 2 * (i - 1);
+
+      for (unsigned int j = 0; j < 4; ++j) {
+        kr[j] = k[2 * j] % 32;
+        km[j] = k[7 - 2 * j];
+      }
+    }
+  }
+}
+
+void JCAST256MultiBlock::processLanes(JLanes* words) const
+{
+  const word32* s = JCASTSBoxes::sboxes();
+
+  if (IsForwardTransformation()) {
+    for (unsigned int i = 0; i < 12; ++i) {
+      if (i < 6) {
+        cast256_q(s, words, itsMasks + 4 * i, itsRotations + 4 * i);
+      }
+      else {
+        cast256_qbar(s, words, itsMasks + 4 * i, itsRotations + 4 * i);
+      }
+    }
+  }
+  else {
+    for (unsigned int i = 12; i-- > 0;) {
+      if (i < 6) {
+        cast256_qbar(s, words, itsMasks + 4 * i, itsRotations + 4 * i);
+      }
+      else {
+        cast256_q(s, words, itsMasks + 4 * i, itsRotations + 4 * i);
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JMULTIBLOCK_H__
+#define __JMULTIBLOCK_H__
+
+#include <string>
+
+#include "jconfig.h"
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+#include "misc.h"
+#include "secblock.h"
+#include "smartptr.h"
+
+using namespace CryptoPP;
+
+// One 32-bit word from each of MULTIBLOCK_LANES blocks. With GCC and clang
+// that's a whole SIMD register, the same as the bitsliced DES, so blocks
+// go 8 at a time with AVX2 and 4 at a time with SSE2 or NEON.
+#if defined(__GNUC__) && defined(__AVX2__)
+typedef word32 JLanes __attribute__((vector_size(32)));
+#elif defined(__GNUC__)
+typedef word32 JLanes __attribute__((vector_size(16)));
+#else
+typedef word32 JLanes;
+#endif
+
+#if defined(__GNUC__)
+#define MULTIBLOCK_LANE(v, i) ((v)[i])
+#else
+#define MULTIBLOCK_LANE(v, i) (v)
+#endif
+
+#define MULTIBLOCK_LANES (sizeof(JLanes) / sizeof(word32))
+
+// Whether each lane can be shifted by its own amount in one instruction.
+// Without that, RC6's rotations go a lane at a time and it's no faster
+// than one block at a time.
+#if defined(__GNUC__) && defined(__AVX2__)
+#define MULTIBLOCK_VARIABLE_SHIFTS 1
+#else
+#define MULTIBLOCK_VARIABLE_SHIFTS 0
+#endif
+
+// Whether a table lookup can be done for every lane in one instruction.
+// Without that, Twofish, Camellia and CAST-256 look their S-boxes up a lane
+// at a time and are barely any faster than one block at a time.
+#if defined(__GNUC__) && defined(__AVX2__)
+#define MULTIBLOCK_GATHER 1
+#else
+#define MULTIBLOCK_GATHER 0
+#endif
+
+// The most words in a block, for SHACAL-2's 256 bits.
+#define MULTIBLOCK_MAX_WORDS 8
+
+// A block cipher that does runs of blocks MULTIBLOCK_LANES at a time, with
+// word i of every block in the same SIMD register. Single blocks and short
+// runs go to cipher, a copy of the Crypto++ object for the same algorithm
+// and direction, which is also where the name and key lengths come from.
+// Subclasses do the key schedule and the rounds.
+class JMultiBlockCipher : public BlockCipher
+{
+  public:
+    JMultiBlockCipher(const BlockCipher& cipher, const ByteOrder order);
+    JMultiBlockCipher(const JMultiBlockCipher& other);
+
+    std::string AlgorithmName() const { return itsCipher->AlgorithmName(); }
+    std::string AlgorithmProvider() const;
+
+    size_t MinKeyLength() const { return itsCipher->MinKeyLength(); }
+    size_t MaxKeyLength() const { return itsCipher->MaxKeyLength(); }
+    size_t DefaultKeyLength() const { return itsCipher->DefaultKeyLength(); }
+    size_t GetValidKeyLength(size_t keylength) const { return itsCipher->GetValidKeyLength(keylength); }
+    IV_Requirement IVRequirement() const { return NOT_RESYNCHRONIZABLE; }
+
+    unsigned int BlockSize() const { return itsCipher->BlockSize(); }
+    bool IsForwardTransformation() const { return itsCipher->IsForwardTransformation(); }
+
+    void ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const;
+    size_t AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const;
+
+  protected:
+    void UncheckedSetKey(const byte* key, unsigned int length, const NameValuePairs& params);
+    virtual void schedule(const byte* key, const size_t length) = 0;
+
+    // Encrypts or decrypts the blocks in words, where words[i] holds word i
+    // of each of them.
+    virtual void processLanes(JLanes* words) const = 0;
+
+    member_ptr<BlockCipher> itsCipher;
+
+  private:
+    void processPass(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, const size_t first, const size_t blocks, const word32 flags) const;
+
+    ByteOrder itsOrder;
+};
+
+// Serpent, with the S-boxes as Dag Arne Osvik's sequences of logic gates.
+class JSerpentMultiBlock : public JMultiBlockCipher
+{
+  public:
+    JSerpentMultiBlock(const BlockCipher& cipher, const byte* key, const size_t length);
+
+    Clonable* Clone() const { return new JSerpentMultiBlock(*this); }
+
+  protected:
+    void schedule(const byte* key, const size_t length);
+    void processLanes(JLanes* words) const;
+
+  private:
+    FixedSizeSecBlock<word32, 33 * 4> itsKeys;
+};
+
+// RC6 at any number of rounds. Its rotations depend on the data, so each
+// lane gets its own, which AVX2 does with one instruction.
+class JRC6MultiBlock : public JMultiBlockCipher
+{
+  public:
+    JRC6MultiBlock(const BlockCipher& cipher, const byte* key, const size_t length, const unsigned int rounds);
+
+    Clonable* Clone() const { return new JRC6MultiBlock(*this); }
+
+  protected:
+    void schedule(const byte* key, const size_t length);
+    void processLanes(JLanes* words) const;
+
+  private:
+    unsigned int itsRounds;
+    SecBlock<word32> itsTable;
+};
+
+// SHACAL-2, which is SHA-256's compression function without the final
+// addition, keyed by the message block.
+class JSHACAL2MultiBlock : public JMultiBlockCipher
+{
+  public:
+    JSHACAL2MultiBlock(const BlockCipher& cipher, const byte* key, const size_t length);
+
+    Clonable* Clone() const { return new JSHACAL2MultiBlock(*this); }
+
+  protected:
+    void schedule(const byte* key, const size_t length);
+    void processLanes(JLanes* words) const;
+
+  private:
+    // the expanded key with the round constants already added
+    FixedSizeSecBlock<word32, 64> itsKeys;
+};
+
+// Twofish, with g's key-dependent S-boxes looked up a lane at a time, or
+// gathered all at once with AVX2.
+class JTwofishMultiBlock : public JMultiBlockCipher
+{
+  public:
+    JTwofishMultiBlock(const BlockCipher& cipher, const byte* key, const size_t length);
+
+    Clonable* Clone() const { return new JTwofishMultiBlock(*this); }
+
+  protected:
+    void schedule(const byte* key, const size_t length);
+    void processLanes(JLanes* words) const;
+
+  private:
+    FixedSizeSecBlock<word32, 40> itsKeys;
+    FixedSizeSecBlock<word32, 4 * 256> itsSBoxes;
+};
+
+// Camellia, with the S-boxes and the P function as four tables of words
+// looked up a lane at a time, or gathered all at once with AVX2.
+class JCamelliaMultiBlock : public JMultiBlockCipher
+{
+  public:
+    JCamelliaMultiBlock(const BlockCipher& cipher, const byte* key, const size_t length);
+
+    Clonable* Clone() const { return new JCamelliaMultiBlock(*this); }
+
+  protected:
+    void schedule(const byte* key, const size_t length);
+    void processLanes(JLanes* words) const;
+
+  private:
+    unsigned int itsRounds;
+    FixedSizeSecBlock<word32, 34 * 2> itsKeys;
+    FixedSizeSecBlock<word32, 4 * 256> itsSP;
+};
+
+// CAST-256, with the S-boxes it shares with CAST-128 looked up a lane at a
+// time, or gathered all at once with AVX2.
+class JCAST256MultiBlock : public JMultiBlockCipher
+{
+  public:
+    JCAST256MultiBlock(const BlockCipher& cipher, const byte* key, const size_t length);
+
+    Clonable* Clone() const { return new JCAST256MultiBlock(*this); }
+
+  protected:
+    void schedule(const byte* key, const size_t length);
+    void processLanes(JLanes* words) const;
+
+  private:
+    FixedSizeSecBlock<word32, 12 * 4> itsMasks;
+    FixedSizeSecBlock<word32, 12 * 4> itsRotations;
+};
+
+#endif
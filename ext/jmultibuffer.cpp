@@ -0,0 +1,72 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jmultibuffer.h"
+#include "jexception.h"
+
+// Crypto++ headers...
+
+#include "misc.h"
+#include "secblock.h"
+
+void encryptCBCMultiBuffer(const BlockCipher& cipher, const byte* const* in, byte* const* out, const size_t* blocks, byte* ivs, const unsigned int count)
+{
+  if (count > MULTI_BUFFER_LANES) {
+    throw JException("too many messages for a multi-buffer job");
+  }
+
+  size_t blockSize = cipher.BlockSize();
+  unsigned int order[MULTI_BUFFER_LANES];
+
+  // longest first, so the messages still going are always the first few
+  // and their chaining values stay packed together
+  for (unsigned int i = 0; i < count; ++i) {
+    unsigned int j = i;
+    for (; j > 0 && blocks[order[j - 1]] < blocks[i]; --j) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  SecByteBlock chain(count * blockSize), work(count * blockSize);
+
+  for (unsigned int k = 0; k < count; ++k) {
+    memcpy(chain + k * blockSize, ivs + order[k] * blockSize, blockSize);
+  }
+
+  unsigned int active = count;
+
+  for (size_t j = 0; active > 0; ++j) {
+    while (active > 0 && blocks[order[active - 1]] <= j) {
+      --active;
+    }
+
+    if (active == 0) {
+      break;
+    }
+
+    for (unsigned int k = 0; k < active; ++k) {
+      memcpy(work + k * blockSize, in[order[k]] + j * blockSize, blockSize);
+    }
+
+    cipher.AdvancedProcessBlocks(work, chain, work, active * blockSize, BlockTransformation::BT_XorInput);
+
+    for (unsigned int k = 0; k < active; ++k) {
+      memcpy(out[order[k]] + j * blockSize, work + k * blockSize, blockSize);
+    }
+
+    // the ciphertext blocks are the next round's chaining values, and the
+    // chaining values of messages that are done are already in their output
+    chain.swap(work);
+  }
+
+  for (unsigned int i = 0; i < count; ++i) {
+    if (blocks[i] > 0) {
+      memcpy(ivs + i * blockSize, out[i] + (blocks[i] - 1) * blockSize, blockSize);
+    }
+  }
+}
@@ -0,0 +1,32 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JMULTIBUFFER_H__
+#define __JMULTIBUFFER_H__
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+
+using namespace CryptoPP;
+
+// The most messages encryptCBCMultiBuffer() takes at once. Block ciphers
+// with pipelined implementations such as AES-NI work on four to eight
+// blocks at a time.
+#define MULTI_BUFFER_LANES 8
+
+// Encrypts count independent messages in CBC mode under the same key. A
+// message on its own can't be sped up since each block depends on the one
+// before it, but the messages don't depend on each other, so block j of
+// every message goes to cipher in a single AdvancedProcessBlocks call.
+//
+// Message i is blocks[i] whole blocks of in[i] that go to out[i]. ivs holds
+// the count IVs one after the other and gets each message's last
+// ciphertext block in its place, ready to carry on from. No padding is done.
+void encryptCBCMultiBuffer(const BlockCipher& cipher, const byte* const* in, byte* const* out, const size_t* blocks, byte* ivs, const unsigned int count);
+
+#endif
@@ -0,0 +1,267 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jocb.h"
+
+#if HAVE_JOCB
+
+// Crypto++ headers...
+
+#include "argnames.h"
+#include "misc.h"
+
+#define OCB_BLOCK_SIZE 16
+
+// How many blocks processBlocks() hands to the block cipher at once.
+#define OCB_PARALLEL_BLOCKS 64
+
+/* Multiplies a block by x in GF(2^128), called double() in RFC 7253. */
+static void ocb_double(byte* out, const byte* in)
+{
+  byte carry = in[0] >> 7;
+
+  for (unsigned int i = 0; i < OCB_BLOCK_SIZE - 1; ++i) {
+    out[i] = (byte) ((in[i] << 1) | (in[i + 1] >> 7));
+  }
+  out[OCB_BLOCK_SIZE - 1] = (byte) ((in[OCB_BLOCK_SIZE - 1] << 1) ^ (carry * 0x87));
+}
+
+JOCB::JOCB(const BlockCipher& cipher, const BlockCipher* inverse)
+  : m_cipher((BlockCipher*) cipher.Clone()), m_tagLength(OCB_BLOCK_SIZE), m_blocks(0), m_aadBuffered(0), m_aadBlocks(0)
+{
+  if (m_cipher->BlockSize() != OCB_BLOCK_SIZE) {
+    throw InvalidArgument(AlgorithmName() + ": block size of underlying block cipher is not 16");
+  }
+
+  if (inverse != NULL) {
+    m_inverse.reset((BlockCipher*) inverse->Clone());
+  }
+
+  m_lStar.CleanNew(OCB_BLOCK_SIZE);
+  m_lDollar.CleanNew(OCB_BLOCK_SIZE);
+  m_l.CleanNew(OCB_BLOCK_SIZE * 64);
+  m_offset.CleanNew(OCB_BLOCK_SIZE);
+  m_checksum.CleanNew(OCB_BLOCK_SIZE);
+  m_aadOffset.CleanNew(OCB_BLOCK_SIZE);
+  m_aadSum.CleanNew(OCB_BLOCK_SIZE);
+  m_aadBuffer.CleanNew(OCB_BLOCK_SIZE);
+  m_offsets.New(OCB_BLOCK_SIZE * OCB_PARALLEL_BLOCKS);
+  m_work.New(OCB_BLOCK_SIZE * OCB_PARALLEL_BLOCKS);
+}
+
+void JOCB::setTagLength(const unsigned int length)
+{
+  if (length < 1 || length > OCB_BLOCK_SIZE) {
+    throw InvalidArgument(AlgorithmName() + ": tag length must be between 1 and 16 bytes");
+  }
+  m_tagLength = length;
+}
+
+unsigned int JOCB::OptimalBlockSize() const
+{
+  return OCB_BLOCK_SIZE * OCB_PARALLEL_BLOCKS;
+}
+
+void JOCB::UncheckedSetKey(const byte* key, unsigned int length, const NameValuePairs& params)
+{
+  m_cipher->SetKey(key, length, params);
+  if (m_inverse.get() != NULL) {
+    m_inverse->SetKey(key, length, params);
+  }
+
+  memset(m_lStar, 0, OCB_BLOCK_SIZE);
+  m_cipher->ProcessBlock(m_lStar);
+  ocb_double(m_lDollar, m_lStar);
+  ocb_double(m_l, m_lDollar);
+  for (unsigned int i = 1; i < 64; ++i) {
+    ocb_double(m_l + OCB_BLOCK_SIZE * i, m_l + OCB_BLOCK_SIZE * (i - 1));
+  }
+
+  ConstByteArrayParameter iv;
+  if (params.GetValue(Name::IV(), iv)) {
+    Resynchronize(iv.begin(), (int) iv.size());
+  }
+}
+
+void JOCB::Resynchronize(const byte* iv, int ivLength)
+{
+  if (ivLength < 0) {
+    ivLength = (int) IVSize();
+  }
+  if (ivLength < (int) MinIVLength() || ivLength > (int) MaxIVLength()) {
+    throw InvalidArgument(AlgorithmName() + ": IV length must be between 1 and 15 bytes");
+  }
+
+  // Nonce = num2str(TAGLEN mod 128, 7) || zeros || 1 || N
+  byte nonce[OCB_BLOCK_SIZE];
+  memset(nonce, 0, sizeof(nonce));
+  nonce[0] = (byte) (((m_tagLength * 8) % 128) << 1);
+  nonce[OCB_BLOCK_SIZE - 1 - ivLength] |= 1;
+  memcpy(nonce + OCB_BLOCK_SIZE - ivLength, iv, ivLength);
+
+  unsigned int bottom = nonce[OCB_BLOCK_SIZE - 1] & 0x3f;
+  nonce[OCB_BLOCK_SIZE - 1] &= 0xc0;
+
+  // Stretch = Ktop || (Ktop[1..64] xor Ktop[9..72])
+  byte stretch[OCB_BLOCK_SIZE + 8];
+  m_cipher->ProcessBlock(nonce, stretch);
+  for (unsigned int i = 0; i < 8; ++i) {
+    stretch[OCB_BLOCK_SIZE + i] = stretch[i] ^ stretch[i + 1];
+  }
+
+  // Offset_0 = Stretch[1+bottom..128+bottom]
+  unsigned int bytes = bottom / 8;
+  unsigned int bits = bottom % 8;
+  for (unsigned int i = 0; i < OCB_BLOCK_SIZE; ++i) {
+    if (bits == 0) {
+      m_offset[i] = stretch[bytes + i];
+    }
+    else {
+      m_offset[i] = (byte) ((stretch[bytes + i] << bits) | (stretch[bytes + i + 1] >> (8 - bits)));
+    }
+  }
+
+  memset(m_checksum, 0, OCB_BLOCK_SIZE);
+  m_blocks = 0;
+
+  memset(m_aadOffset, 0, OCB_BLOCK_SIZE);
+  memset(m_aadSum, 0, OCB_BLOCK_SIZE);
+  m_aadBuffered = 0;
+  m_aadBlocks = 0;
+}
+
+void JOCB::processBlocks(byte* outString, const byte* inString, const size_t blocks)
+{
+  const bool encrypting = IsForwardTransformation();
+  const size_t length = blocks * OCB_BLOCK_SIZE;
+
+  // Offset_i = Offset_{i-1} xor L_{ntz(i)}, and the checksum is over the
+  // plaintext
+  for (size_t i = 0; i < blocks; ++i) {
+    ++m_blocks;
+    xorbuf(m_offset, m_l + OCB_BLOCK_SIZE * TrailingZeros((word64) m_blocks), OCB_BLOCK_SIZE);
+    memcpy(m_offsets + OCB_BLOCK_SIZE * i, m_offset, OCB_BLOCK_SIZE);
+
+    if (encrypting) {
+      xorbuf(m_checksum, inString + OCB_BLOCK_SIZE * i, OCB_BLOCK_SIZE);
+    }
+  }
+
+  // out = Offset_i xor E(in xor Offset_i)
+  xorbuf(m_work, inString, m_offsets, length);
+  (encrypting ? *m_cipher : *m_inverse).AdvancedProcessBlocks(m_work, m_offsets, outString, length, 0);
+
+  if (!encrypting) {
+    for (size_t i = 0; i < blocks; ++i) {
+      xorbuf(m_checksum, outString + OCB_BLOCK_SIZE * i, OCB_BLOCK_SIZE);
+    }
+  }
+}
+
+void JOCB::ProcessData(byte* outString, const byte* inString, size_t length)
+{
+  if (length % OCB_BLOCK_SIZE != 0) {
+    throw InvalidArgument(AlgorithmName() + ": only the last block may be partial");
+  }
+
+  while (length > 0) {
+    size_t blocks = STDMIN(length / OCB_BLOCK_SIZE, (size_t) OCB_PARALLEL_BLOCKS);
+
+    processBlocks(outString, inString, blocks);
+    outString += blocks * OCB_BLOCK_SIZE;
+    inString += blocks * OCB_BLOCK_SIZE;
+    length -= blocks * OCB_BLOCK_SIZE;
+  }
+}
+
+size_t JOCB::ProcessLastBlock(byte* outString, size_t outLength, const byte* inString, size_t inLength)
+{
+  CRYPTOPP_UNUSED(outLength);
+
+  size_t partial = inLength % OCB_BLOCK_SIZE;
+  size_t full = inLength - partial;
+
+  ProcessData(outString, inString, full);
+
+  if (partial > 0) {
+    // Offset_* = Offset_m xor L_*, Pad = E(Offset_*) and the checksum
+    // gets the plaintext padded with 10*
+    byte pad[OCB_BLOCK_SIZE];
+    xorbuf(m_offset, m_lStar, OCB_BLOCK_SIZE);
+    m_cipher->ProcessBlock(m_offset, pad);
+
+    if (IsForwardTransformation()) {
+      xorbuf(m_checksum, inString + full, partial);
+    }
+    xorbuf(outString + full, inString + full, pad, partial);
+    if (!IsForwardTransformation()) {
+      xorbuf(m_checksum, outString + full, partial);
+    }
+    m_checksum[partial] ^= 0x80;
+  }
+
+  return inLength;
+}
+
+void JOCB::hashBlock(const byte* block)
+{
+  byte work[OCB_BLOCK_SIZE];
+
+  ++m_aadBlocks;
+  xorbuf(m_aadOffset, m_l + OCB_BLOCK_SIZE * TrailingZeros((word64) m_aadBlocks), OCB_BLOCK_SIZE);
+  xorbuf(work, block, m_aadOffset, OCB_BLOCK_SIZE);
+  m_cipher->ProcessBlock(work);
+  xorbuf(m_aadSum, work, OCB_BLOCK_SIZE);
+}
+
+void JOCB::Update(const byte* input, size_t length)
+{
+  // full blocks of associated data are hashed as they come in, only a
+  // trailing partial one is treated differently
+  while (length > 0) {
+    size_t n = STDMIN(length, (size_t) OCB_BLOCK_SIZE - m_aadBuffered);
+
+    memcpy(m_aadBuffer + m_aadBuffered, input, n);
+    m_aadBuffered += n;
+    input += n;
+    length -= n;
+
+    if (m_aadBuffered == OCB_BLOCK_SIZE) {
+      hashBlock(m_aadBuffer);
+      m_aadBuffered = 0;
+    }
+  }
+}
+
+void JOCB::TruncatedFinal(byte* mac, size_t size)
+{
+  ThrowIfInvalidTruncatedSize(size);
+
+  if (m_aadBuffered > 0) {
+    byte work[OCB_BLOCK_SIZE];
+    memset(work, 0, sizeof(work));
+    memcpy(work, m_aadBuffer, m_aadBuffered);
+    work[m_aadBuffered] = 0x80;
+
+    xorbuf(m_aadOffset, m_lStar, OCB_BLOCK_SIZE);
+    xorbuf(work, m_aadOffset, OCB_BLOCK_SIZE);
+    m_cipher->ProcessBlock(work);
+    xorbuf(m_aadSum, work, OCB_BLOCK_SIZE);
+    m_aadBuffered = 0;
+  }
+
+  // Tag = E(Checksum xor Offset xor L_$) xor HASH(K, A)
+  byte tag[OCB_BLOCK_SIZE];
+  xorbuf(tag, m_checksum, m_offset, OCB_BLOCK_SIZE);
+  xorbuf(tag, m_lDollar, OCB_BLOCK_SIZE);
+  m_cipher->ProcessBlock(tag);
+  xorbuf(tag, m_aadSum, OCB_BLOCK_SIZE);
+
+  memcpy(mac, tag, size);
+}
+
+#endif
@@ -0,0 +1,108 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JOCB_H__
+#define __JOCB_H__
+
+#include <string>
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+#include "secblock.h"
+#include "smartptr.h"
+
+using namespace CryptoPP;
+
+// Crypto++ 6.0 added the hooks StreamTransformationFilter uses to hand a
+// mode its final partial block, which OCB needs.
+#if CRYPTOPP_VERSION >= 600
+#  define HAVE_JOCB 1
+#endif
+
+#if HAVE_JOCB
+
+// OCB3 as in RFC 7253 around any 128-bit block cipher object. Crypto++
+// doesn't come with OCB, so this is written against the
+// AuthenticatedSymmetricCipher interface so that it works with the same
+// filters as GCM and EAX. Every block takes one block cipher call and the
+// offsets don't depend on the data, so runs of blocks are handed to the
+// cipher together with AdvancedProcessBlocks where implementations like
+// AES-NI can pipeline them.
+//
+// inverse is the decryption direction of cipher and is only given when
+// decrypting. Both are copied. The tag length is part of the nonce, so it
+// has to be set before resynchronizing.
+class JOCB : public AuthenticatedSymmetricCipher
+{
+  public:
+    JOCB(const BlockCipher& cipher, const BlockCipher* inverse);
+
+    std::string AlgorithmName() const { return m_cipher->AlgorithmName() + "/OCB"; }
+
+    size_t MinKeyLength() const { return m_cipher->MinKeyLength(); }
+    size_t MaxKeyLength() const { return m_cipher->MaxKeyLength(); }
+    size_t DefaultKeyLength() const { return m_cipher->DefaultKeyLength(); }
+    size_t GetValidKeyLength(size_t keylength) const { return m_cipher->GetValidKeyLength(keylength); }
+    IV_Requirement IVRequirement() const { return UNIQUE_IV; }
+    unsigned int IVSize() const { return 12; }
+    unsigned int MinIVLength() const { return 1; }
+    unsigned int MaxIVLength() const { return 15; }
+    void Resynchronize(const byte* iv, int ivLength = -1);
+
+    unsigned int MandatoryBlockSize() const { return 16; }
+    unsigned int OptimalBlockSize() const;
+    bool IsLastBlockSpecial() const { return true; }
+    void ProcessData(byte* outString, const byte* inString, size_t length);
+    size_t ProcessLastBlock(byte* outString, size_t outLength, const byte* inString, size_t inLength);
+    bool IsRandomAccess() const { return false; }
+    bool IsSelfInverting() const { return false; }
+    bool IsForwardTransformation() const { return m_inverse.get() == NULL; }
+
+    unsigned int DigestSize() const { return m_tagLength; }
+    void Update(const byte* input, size_t length);
+    void TruncatedFinal(byte* mac, size_t size);
+
+    lword MaxHeaderLength() const { return LWORD_MAX; }
+    lword MaxMessageLength() const { return LWORD_MAX; }
+
+    void setTagLength(const unsigned int length);
+
+  protected:
+    void UncheckedSetKey(const byte* key, unsigned int length, const NameValuePairs& params);
+
+  private:
+    void processBlocks(byte* outString, const byte* inString, const size_t blocks);
+    void hashBlock(const byte* block);
+
+    member_ptr<BlockCipher> m_cipher;
+    member_ptr<BlockCipher> m_inverse;
+    unsigned int m_tagLength;
+
+    // L_*, L_$ and L_0 through L_63
+    SecByteBlock m_lStar;
+    SecByteBlock m_lDollar;
+    SecByteBlock m_l;
+
+    SecByteBlock m_offset;
+    SecByteBlock m_checksum;
+    lword m_blocks;
+
+    SecByteBlock m_aadOffset;
+    SecByteBlock m_aadSum;
+    SecByteBlock m_aadBuffer;
+    size_t m_aadBuffered;
+    lword m_aadBlocks;
+
+    // workspace for processBlocks()
+    SecByteBlock m_offsets;
+    SecByteBlock m_work;
+};
+
+#endif
+
+#endif
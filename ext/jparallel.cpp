@@ -0,0 +1,202 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jparallel.h"
+#include "jexception.h"
+
+// Crypto++ headers...
+
+#include "smartptr.h"
+
+// Each batch collected by JParallelDecryptionFilter is this many bytes per
+// thread.
+#define PARALLEL_BATCH_SIZE (1024 * 1024)
+
+struct JBlockModeJob
+{
+  const BlockCipher* cipher;
+  enum ModeEnum mode;
+  const byte* iv;
+  lword position;
+  const byte* in;
+  byte* out;
+  size_t length;
+  size_t segmentSize;
+  size_t chunkSize;
+  const volatile bool* interrupted;
+};
+
+/* Sets up the bits of a job shared by all of the job types. */
+static void job_init(JBlockModeJob& job, const BlockCipher& cipher, const enum ModeEnum mode, const byte* iv, const byte* in, byte* out, const size_t length, const unsigned int threads, const volatile bool* interrupted)
+{
+  size_t blockSize = cipher.BlockSize();
+
+  job.cipher = &cipher;
+  job.mode = mode;
+  job.iv = iv;
+  job.position = 0;
+  job.in = in;
+  job.out = out;
+  job.length = length;
+  job.segmentSize = (length + threads - 1) / threads;
+  job.segmentSize = (job.segmentSize + blockSize - 1) / blockSize * blockSize;
+  job.chunkSize = STDMAX((size_t) PARALLEL_CHUNK_SIZE / blockSize, (size_t) 1) * blockSize;
+  job.interrupted = interrupted;
+}
+
+/* Runs a segment through a mode object in chunks, checking for
+ * interruptions in between. */
+static void job_process(JBlockModeJob* job, StreamTransformation& mode, const size_t offset, const size_t length)
+{
+  for (size_t done = 0; done < length; done += job->chunkSize) {
+    if (job->interrupted != NULL && *job->interrupted) {
+      throw JException("operation interrupted");
+    }
+    size_t chunk = STDMIN(job->chunkSize, length - done);
+    mode.ProcessData(job->out + offset + done, job->in + offset + done, chunk);
+  }
+}
+
+/* Processes one segment of a CTR job. The counter is simply seeked to the
+ * segment's offset. */
+static void ctr_segment(void* data, const unsigned int index)
+{
+  JBlockModeJob* job = (JBlockModeJob*) data;
+  size_t offset = job->segmentSize * index;
+
+  if (offset >= job->length) {
+    return;
+  }
+
+  // the schedule is copied rather than shared since some Crypto++ block
+  // ciphers use member workspace while processing
+  member_ptr<BlockCipher> cipher((BlockCipher*) job->cipher->Clone());
+  CTR_Mode_ExternalCipher::Encryption ctr(*cipher, job->iv);
+  ctr.Seek(job->position + offset);
+
+  job_process(job, ctr, offset, STDMIN(job->segmentSize, job->length - offset));
+}
+
+/* Processes one segment of an ECB job. Every block stands on its own, and
+ * the mode hands whole chunks to the cipher's AdvancedProcessBlocks. */
+static void ecb_segment(void* data, const unsigned int index)
+{
+  JBlockModeJob* job = (JBlockModeJob*) data;
+  size_t offset = job->segmentSize * index;
+
+  if (offset >= job->length) {
+    return;
+  }
+
+  member_ptr<BlockCipher> cipher((BlockCipher*) job->cipher->Clone());
+  ECB_Mode_ExternalCipher::Encryption ecb(*cipher);
+
+  job_process(job, ecb, offset, STDMIN(job->segmentSize, job->length - offset));
+}
+
+/* Processes one segment of a CBC or CFB decryption job. Each plaintext
+ * block only depends on two ciphertext blocks, so a segment just starts
+ * with the last ciphertext block of the segment before it as its IV. */
+static void chained_segment(void* data, const unsigned int index)
+{
+  JBlockModeJob* job = (JBlockModeJob*) data;
+  size_t offset = job->segmentSize * index;
+
+  if (offset >= job->length) {
+    return;
+  }
+
+  const byte* iv = (offset == 0) ? job->iv : job->in + offset - job->cipher->BlockSize();
+  member_ptr<BlockCipher> cipher((BlockCipher*) job->cipher->Clone());
+  member_ptr<CipherModeBase> mode;
+
+  if (job->mode == CFB_MODE) {
+    mode.reset(new CFB_Mode_ExternalCipher::Decryption(*cipher, iv));
+  }
+  else {
+    mode.reset(new CBC_Mode_ExternalCipher::Decryption(*cipher, iv));
+  }
+
+  job_process(job, *mode, offset, STDMIN(job->segmentSize, job->length - offset));
+}
+
+void processCTRInParallel(const BlockCipher& cipher, const byte* iv, const lword position, const byte* in, byte* out, const size_t length, const unsigned int threads, const volatile bool* interrupted)
+{
+  JBlockModeJob job;
+  job_init(job, cipher, CTR_MODE, iv, in, out, length, threads, interrupted);
+  job.position = position;
+  runInParallel(ctr_segment, &job, threads);
+}
+
+void processECBInParallel(const BlockCipher& cipher, const byte* in, byte* out, const size_t length, const unsigned int threads, const volatile bool* interrupted)
+{
+  JBlockModeJob job;
+  job_init(job, cipher, ECB_MODE, NULL, in, out, length, threads, interrupted);
+  runInParallel(ecb_segment, &job, threads);
+}
+
+void decryptChainedInParallel(const BlockCipher& cipher, const enum ModeEnum mode, const byte* iv, const byte* in, byte* out, const size_t length, const unsigned int threads, const volatile bool* interrupted)
+{
+  JBlockModeJob job;
+  job_init(job, cipher, mode, iv, in, out, length, threads, interrupted);
+  runInParallel(chained_segment, &job, threads);
+}
+
+JParallelDecryptionFilter::JParallelDecryptionFilter(const BlockCipher& cipher, CipherModeBase& tailMode, const enum ModeEnum mode, const byte* iv, const unsigned int threads, StreamTransformationFilter::BlockPaddingScheme padding, BufferedTransformation* attachment)
+  : m_cipher(cipher), m_tailMode(tailMode), m_mode(mode), m_iv(iv, cipher.BlockSize()), m_threads(threads), m_padding(padding)
+{
+  size_t blockSize = cipher.BlockSize();
+
+  m_batchSize = threads * PARALLEL_BATCH_SIZE / blockSize * blockSize;
+
+  // enough to always leave ciphertext stealing and padding two full blocks
+  // plus whatever partial block there is
+  m_holdback = 3 * blockSize;
+
+  Detach(attachment);
+}
+
+size_t JParallelDecryptionFilter::Put2(const byte* inString, size_t length, int messageEnd, bool blocking)
+{
+  m_buffer.append((const char*) inString, length);
+
+  while (m_buffer.length() >= m_batchSize + m_holdback) {
+    decryptBatch(m_batchSize, blocking);
+  }
+
+  if (messageEnd) {
+    size_t blockSize = m_cipher.BlockSize();
+    size_t tail = 2 * blockSize + m_buffer.length() % blockSize;
+
+    if (m_buffer.length() > tail) {
+      decryptBatch(m_buffer.length() - tail, blocking);
+    }
+
+    m_output.erase();
+    m_tailMode.Resynchronize(m_iv.data(), (int) blockSize);
+    StringSource((const byte*) m_buffer.data(), m_buffer.length(), true, new StreamTransformationFilter(m_tailMode, new StringSink(m_output), m_padding));
+    m_buffer.erase();
+
+    AttachedTransformation()->Put2((const byte*) m_output.data(), m_output.length(), messageEnd, blocking);
+    m_output.erase();
+  }
+
+  return 0;
+}
+
+void JParallelDecryptionFilter::decryptBatch(const size_t length, bool blocking)
+{
+  size_t blockSize = m_cipher.BlockSize();
+  unsigned int threads = (unsigned int) STDMAX((size_t) 1, STDMIN((size_t) m_threads, length / PARALLEL_MIN_SEGMENT_SIZE));
+
+  m_output.resize(length);
+  decryptChainedInParallel(m_cipher, m_mode, m_iv.data(), (const byte*) m_buffer.data(), (byte*) &m_output[0], length, threads, NULL);
+  memcpy(m_iv.data(), m_buffer.data() + length - blockSize, blockSize);
+  m_buffer.erase(0, length);
+
+  AttachedTransformation()->Put2((const byte*) m_output.data(), m_output.length(), 0, blocking);
+}
@@ -0,0 +1,67 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JPARALLEL_H__
+#define __JPARALLEL_H__
+
+#include <string>
+
+#include "jconstants.h"
+#include "jthreads.h"
+
+// Crypto++ headers...
+
+#include "filters.h"
+#include "modes.h"
+
+using namespace CryptoPP;
+
+// Block mode work split over several threads. Every thread works on its own
+// copy of cipher and a segment of the buffer starting on a block boundary.
+
+// Encrypts or decrypts length bytes in CTR mode, starting position bytes into
+// the keystream.
+void processCTRInParallel(const BlockCipher& cipher, const byte* iv, const lword position, const byte* in, byte* out, const size_t length, const unsigned int threads, const volatile bool* interrupted);
+
+// Encrypts or decrypts length bytes in ECB mode, depending on which way
+// cipher goes. length must be a multiple of the block size.
+void processECBInParallel(const BlockCipher& cipher, const byte* in, byte* out, const size_t length, const unsigned int threads, const volatile bool* interrupted);
+
+// Decrypts length bytes of CBC or CFB ciphertext chained from iv. length
+// must be a multiple of the block size. For CFB, cipher is the encryption
+// object, as usual.
+void decryptChainedInParallel(const BlockCipher& cipher, const enum ModeEnum mode, const byte* iv, const byte* in, byte* out, const size_t length, const unsigned int threads, const volatile bool* interrupted);
+
+// Decrypts CBC, CBC with CTS or CFB input that arrives in pieces, such as
+// from a RubyIOSource. Input is collected into batches that are decrypted
+// with decryptChainedInParallel. The last couple of blocks go through a
+// StreamTransformationFilter wrapped around tailMode at the end of the
+// message so padding and ciphertext stealing are handled as usual.
+class JParallelDecryptionFilter : public Unflushable<Filter>
+{
+  public:
+    JParallelDecryptionFilter(const BlockCipher& cipher, CipherModeBase& tailMode, const enum ModeEnum mode, const byte* iv, const unsigned int threads, StreamTransformationFilter::BlockPaddingScheme padding, BufferedTransformation* attachment = NULL);
+
+    size_t Put2(const byte* inString, size_t length, int messageEnd, bool blocking);
+
+  private:
+    void decryptBatch(const size_t length, bool blocking);
+
+    const BlockCipher& m_cipher;
+    CipherModeBase& m_tailMode;
+    enum ModeEnum m_mode;
+    SecByteBlock m_iv;
+    unsigned int m_threads;
+    StreamTransformationFilter::BlockPaddingScheme m_padding;
+
+    std::string m_buffer;
+    std::string m_output;
+    size_t m_batchSize;
+    size_t m_holdback;
+};
+
+#endif
@@ -16,6 +16,8 @@ JRC2::JRC2()
 
 unsigned int JRC2::setEffectiveKeylength(const unsigned int keylength)
 {
+  unsigned int previous = itsEffectiveKeylength;
+
   if (keylength > RC2_Info::MAX_EFFECTIVE_KEYLENGTH) {
     itsEffectiveKeylength = RC2_Info::MAX_EFFECTIVE_KEYLENGTH;
   }
@@ -23,6 +25,10 @@ unsigned int JRC2::setEffectiveKeylength(const unsigned int keylength)
     itsEffectiveKeylength = keylength;
   }
 
+  if (itsEffectiveKeylength != previous) {
+    invalidateCipherObjects();
+  }
+
   return itsEffectiveKeylength;
 }
 
@@ -31,6 +37,11 @@ unsigned int JRC2::getEffectiveKeylength() const
   return itsEffectiveKeylength;
 }
 
+AlgorithmParameters JRC2::getKeyParameters() const
+{
+  return MakeParameters(Name::EffectiveKeyLength(), (int) itsEffectiveKeylength, false);
+}
+
 BlockCipher* JRC2::getEncryptionObject()
 {
   return new RC2Encryption((byte*) itsKey.data(), itsKeylength, itsEffectiveKeylength);
@@ -29,6 +29,7 @@ class JRC2 : public JCipher_Template<RC2_Info, RC2_CIPHER>
     unsigned int getEffectiveKeylength() const;
 
   protected:
+    AlgorithmParameters getKeyParameters() const;
     BlockCipher* getEncryptionObject();
     BlockCipher* getDecryptionObject();
 
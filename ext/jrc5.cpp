@@ -6,16 +6,29 @@
  */
 
 #include "jrc5.h"
+#include "jfixedrounds.h"
 
 #if ENABLED_RC5_CIPHER
 
 BlockCipher* JRC5::getEncryptionObject()
 {
+#if ENABLED_FIXED_ROUNDS
+  if (itsRounds == DEFAULT_ROUND_COUNT) {
+    return new JRC5FixedRounds<DEFAULT_ROUND_COUNT>(RC5Encryption((byte*) itsKey.data(), itsKeylength, itsRounds), (byte*) itsKey.data(), itsKeylength);
+  }
+#endif
+
   return new RC5Encryption((byte*) itsKey.data(), itsKeylength, itsRounds);
 }
 
 BlockCipher* JRC5::getDecryptionObject()
 {
+#if ENABLED_FIXED_ROUNDS
+  if (itsRounds == DEFAULT_ROUND_COUNT) {
+    return new JRC5FixedRounds<DEFAULT_ROUND_COUNT>(RC5Decryption((byte*) itsKey.data(), itsKeylength, itsRounds), (byte*) itsKey.data(), itsKeylength);
+  }
+#endif
+
   return new RC5Decryption((byte*) itsKey.data(), itsKeylength, itsRounds);
 }
 
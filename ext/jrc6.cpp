@@ -6,17 +6,42 @@
  */
 
 #include "jrc6.h"
+#include "jfixedrounds.h"
+#include "jmultiblock.h"
 
 #if ENABLED_RC6_CIPHER
 
+/* Puts cipher behind the SIMD kernel where that's any faster, or returns a
+ * copy of it as it is. */
+static BlockCipher* multiBlock(const BlockCipher& cipher, const byte* key, const size_t length, const unsigned int rounds)
+{
+#if ENABLED_MULTIBLOCK && MULTIBLOCK_VARIABLE_SHIFTS
+  return new JRC6MultiBlock(cipher, key, length, rounds);
+#else
+  return (BlockCipher*) cipher.Clone();
+#endif
+}
+
 BlockCipher* JRC6::getEncryptionObject()
 {
-  return new RC6Encryption((byte*) itsKey.data(), itsKeylength);
+#if ENABLED_FIXED_ROUNDS
+  if (itsRounds == DEFAULT_ROUND_COUNT) {
+    return multiBlock(JRC6FixedRounds<DEFAULT_ROUND_COUNT>(RC6Encryption((byte*) itsKey.data(), itsKeylength, itsRounds), (byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength, itsRounds);
+  }
+#endif
+
+  return multiBlock(RC6Encryption((byte*) itsKey.data(), itsKeylength, itsRounds), (byte*) itsKey.data(), itsKeylength, itsRounds);
 }
 
 BlockCipher* JRC6::getDecryptionObject()
 {
-  return new RC6Decryption((byte*) itsKey.data(), itsKeylength);
+#if ENABLED_FIXED_ROUNDS
+  if (itsRounds == DEFAULT_ROUND_COUNT) {
+    return multiBlock(JRC6FixedRounds<DEFAULT_ROUND_COUNT>(RC6Decryption((byte*) itsKey.data(), itsKeylength, itsRounds), (byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength, itsRounds);
+  }
+#endif
+
+  return multiBlock(RC6Decryption((byte*) itsKey.data(), itsKeylength, itsRounds), (byte*) itsKey.data(), itsKeylength, itsRounds);
 }
 
 #endif
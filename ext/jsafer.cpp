@@ -6,15 +6,28 @@
  */
 
 #include "jsafer.h"
+#include "jfixedrounds.h"
 
 #if ENABLED_SAFER_K_CIPHER
 BlockCipher* JSAFER_K::getEncryptionObject()
 {
+#if ENABLED_FIXED_ROUNDS
+  if (itsRounds == DEFAULT_ROUND_COUNT) {
+    return new JSAFERFixedRounds<DEFAULT_ROUND_COUNT>(SAFER_K_Encryption((byte*) itsKey.data(), itsKeylength, itsRounds), false, (byte*) itsKey.data(), itsKeylength);
+  }
+#endif
+
   return new SAFER_K_Encryption((byte*) itsKey.data(), itsKeylength, itsRounds);
 }
 
 BlockCipher* JSAFER_K::getDecryptionObject()
 {
+#if ENABLED_FIXED_ROUNDS
+  if (itsRounds == DEFAULT_ROUND_COUNT) {
+    return new JSAFERFixedRounds<DEFAULT_ROUND_COUNT>(SAFER_K_Decryption((byte*) itsKey.data(), itsKeylength, itsRounds), false, (byte*) itsKey.data(), itsKeylength);
+  }
+#endif
+
   return new SAFER_K_Decryption((byte*) itsKey.data(), itsKeylength, itsRounds);
 }
 #endif
@@ -22,11 +35,23 @@ BlockCipher* JSAFER_K::getDecryptionObject()
 #if ENABLED_SAFER_SK_CIPHER
 BlockCipher* JSAFER_SK::getEncryptionObject()
 {
+#if ENABLED_FIXED_ROUNDS
+  if (itsRounds == DEFAULT_ROUND_COUNT) {
+    return new JSAFERFixedRounds<DEFAULT_ROUND_COUNT>(SAFER_SK_Encryption((byte*) itsKey.data(), itsKeylength, itsRounds), true, (byte*) itsKey.data(), itsKeylength);
+  }
+#endif
+
   return new SAFER_SK_Encryption((byte*) itsKey.data(), itsKeylength, itsRounds);
 }
 
 BlockCipher* JSAFER_SK::getDecryptionObject()
 {
+#if ENABLED_FIXED_ROUNDS
+  if (itsRounds == DEFAULT_ROUND_COUNT) {
+    return new JSAFERFixedRounds<DEFAULT_ROUND_COUNT>(SAFER_SK_Decryption((byte*) itsKey.data(), itsKeylength, itsRounds), true, (byte*) itsKey.data(), itsKeylength);
+  }
+#endif
+
   return new SAFER_SK_Decryption((byte*) itsKey.data(), itsKeylength, itsRounds);
 }
 #endif
@@ -6,17 +6,26 @@
  */
 
 #include "jserpent.h"
+#include "jmultiblock.h"
 
 #if ENABLED_SERPENT_CIPHER
 
 BlockCipher* JSerpent::getEncryptionObject()
 {
+#if ENABLED_MULTIBLOCK
+  return new JSerpentMultiBlock(SerpentEncryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new SerpentEncryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 BlockCipher* JSerpent::getDecryptionObject()
 {
+#if ENABLED_MULTIBLOCK
+  return new JSerpentMultiBlock(SerpentDecryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new SerpentDecryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
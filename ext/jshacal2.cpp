@@ -6,17 +6,33 @@
  */
 
 #include "jshacal2.h"
+#include "jmultiblock.h"
 
 #if ENABLED_SHACAL2_CIPHER
 
 BlockCipher* JSHACAL2::getEncryptionObject()
 {
+#if ENABLED_MULTIBLOCK
+  SHACAL2Encryption cipher((byte*) itsKey.data(), itsKeylength);
+  const string provider = getAlgorithmProvider(cipher);
+
+  // with SHA-NI and the like Crypto++ does one block faster than the
+  // kernel does several, but there's nothing like it for decryption
+  if (provider == "C++" || provider == "unknown") {
+    return new JSHACAL2MultiBlock(cipher, (byte*) itsKey.data(), itsKeylength);
+  }
+#endif
+
   return new SHACAL2Encryption((byte*) itsKey.data(), itsKeylength);
 }
 
 BlockCipher* JSHACAL2::getDecryptionObject()
 {
+#if ENABLED_MULTIBLOCK
+  return new JSHACAL2MultiBlock(SHACAL2Decryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new SHACAL2Decryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
@@ -6,3 +6,13 @@
  */
 
 #include "jstream.h"
+
+JStream::JStream()
+{
+  itsPosition = 0;
+}
+
+lword JStream::getPosition() const
+{
+  return itsPosition;
+}
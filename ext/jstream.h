@@ -15,6 +15,24 @@
 
 class JStream : public JBase
 {
+  public:
+    JStream();
+
+    // Where in the keystream encrypt, decrypt and the streaming methods
+    // start, 0 being the start of the keystream for the key and IV.
+    lword getPosition() const;
+
+    // Only ciphers that can jump around in their keystream, i.e. SEAL,
+    // can be moved off of position 0. Throws for the others.
+    virtual void seek(const lword position) = 0;
+    virtual bool isRandomAccess() = 0;
+
+    // Encrypts or decrypts data as if it were found position bytes into
+    // a message, without generating the keystream before it.
+    virtual string processAt(const lword position, const string& data, const volatile bool* interrupted = NULL) = 0;
+
+  protected:
+    lword itsPosition;
 };
 
 #endif
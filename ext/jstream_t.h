@@ -15,86 +15,301 @@ class JStream_Template : public JBasicCipherInfo<INFO, JStream>
 {
   public:
     JStream_Template();
+    virtual ~JStream_Template();
 
     inline enum CipherEnum getCipherType() const;
     inline unsigned int getBlockSize() const { return 0; }
+    string getImplementationName();
 
-    bool encrypt();
-    bool decrypt();
+    size_t processMessage(const byte* in, const size_t length, byte* out, const bool decrypting, const volatile bool* interrupted = NULL);
+    void processInPlace(byte* data, const size_t length, const bool decrypting, const volatile bool* interrupted = NULL);
 
     bool encryptRubyIO(VALUE* in, VALUE* out);
     bool decryptRubyIO(VALUE* in, VALUE* out);
 
+    void seek(const lword position);
+    bool isRandomAccess();
+    string processAt(const lword position, const string& data, const volatile bool* interrupted = NULL);
+    void precomputeKeystream(const size_t length, const bool background, const volatile bool* interrupted = NULL);
+
   protected:
     virtual SymmetricCipher* getEncryptionObject() = 0;
     virtual SymmetricCipher* getDecryptionObject() = 0;
+
+    // Keyed ciphers are kept between calls until the key or key length
+    // change and are rewound to itsPosition in the keystream before each
+    // use.
+    SymmetricCipher* getEncryptionCipher();
+    SymmetricCipher* getDecryptionCipher();
+    void rewind(SymmetricCipher* cipher);
+    void invalidateCipherObjects();
+    BufferedTransformation* createStreamFilter(const bool decrypting, BufferedTransformation* sink);
+
+    SymmetricCipher* itsEncryptionObject;
+    SymmetricCipher* itsDecryptionObject;
 };
 
 template <typename INFO, enum CipherEnum TYPE>
 JStream_Template<INFO, TYPE>::JStream_Template()
 {
   this->itsKeylength = INFO::DEFAULT_KEYLENGTH;
+
+  itsEncryptionObject = NULL;
+  itsDecryptionObject = NULL;
 }
 
 template <typename INFO, enum CipherEnum TYPE>
-CipherEnum JStream_Template<INFO, TYPE>::getCipherType() const
+JStream_Template<INFO, TYPE>::~JStream_Template()
 {
-  return TYPE;
+  invalidateCipherObjects();
 }
 
 template <typename INFO, enum CipherEnum TYPE>
-bool JStream_Template<INFO, TYPE>::encrypt()
+void JStream_Template<INFO, TYPE>::invalidateCipherObjects()
 {
-  StreamTransformation* cipher = NULL;
+  this->endStream();
+  this->itsKeystream.clear();
+  delete itsEncryptionObject;
+  delete itsDecryptionObject;
 
-  cipher = getEncryptionObject();
+  itsEncryptionObject = NULL;
+  itsDecryptionObject = NULL;
+}
 
-  if (cipher != NULL) {
-    this->itsCiphertext.erase();
-    StringSource(this->itsPlaintext, true, new StreamTransformationFilter(*cipher, new StringSink(this->itsCiphertext)));
-    delete cipher;
-    return true;
+template <typename INFO, enum CipherEnum TYPE>
+void JStream_Template<INFO, TYPE>::rewind(SymmetricCipher* cipher)
+{
+  // ciphers without an IV like ARC4 can only be rewound by keying them again
+  if (!this->resynchronize(cipher)) {
+    cipher->SetKey((const byte*) this->itsKey.data(), this->itsKeylength);
   }
-  else {
-    return false;
+
+  if (this->itsPosition > 0) {
+    cipher->Seek(this->itsPosition);
   }
 }
 
 template <typename INFO, enum CipherEnum TYPE>
-bool JStream_Template<INFO, TYPE>::decrypt()
+SymmetricCipher* JStream_Template<INFO, TYPE>::getEncryptionCipher()
 {
-  StreamTransformation* cipher = NULL;
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
+
+  if (itsEncryptionObject == NULL) {
+    itsEncryptionObject = getEncryptionObject();
+    if (itsEncryptionObject != NULL && this->itsPosition > 0) {
+      itsEncryptionObject->Seek(this->itsPosition);
+    }
+  }
+  else {
+    rewind(itsEncryptionObject);
+  }
 
-  cipher = getDecryptionObject();
+  return itsEncryptionObject;
+}
 
-  if (cipher != NULL) {
-    this->itsPlaintext.erase();
-    StringSource(this->itsCiphertext, true, new StreamTransformationFilter(*cipher, new StringSink(this->itsPlaintext)));
-    delete cipher;
-    return true;
+template <typename INFO, enum CipherEnum TYPE>
+SymmetricCipher* JStream_Template<INFO, TYPE>::getDecryptionCipher()
+{
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
+
+  if (itsDecryptionObject == NULL) {
+    itsDecryptionObject = getDecryptionObject();
+    if (itsDecryptionObject != NULL && this->itsPosition > 0) {
+      itsDecryptionObject->Seek(this->itsPosition);
+    }
   }
   else {
-    return false;
+    rewind(itsDecryptionObject);
   }
+
+  return itsDecryptionObject;
 }
 
 template <typename INFO, enum CipherEnum TYPE>
-bool JStream_Template<INFO, TYPE>::encryptRubyIO(VALUE* in, VALUE* out)
+BufferedTransformation* JStream_Template<INFO, TYPE>::createStreamFilter(const bool decrypting, BufferedTransformation* sink)
 {
-  StreamTransformation* cipher = NULL;
+  SymmetricCipher* cipher = NULL;
 
-  cipher = getEncryptionObject();
+  try {
+    cipher = decrypting ? getDecryptionCipher() : getEncryptionCipher();
+  }
+  catch (...) {
+    delete sink;
+    throw;
+  }
 
-  if (cipher != NULL) {
-    try {
-      RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out)));
-    }
-    catch (RubyIOStore::OpenErr e) {
-      delete cipher;
-      throw e;
-    }
-    delete cipher;
+  if (cipher == NULL) {
+    delete sink;
+    return NULL;
+  }
+
+  return new StreamTransformationFilter(*cipher, sink);
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+string JStream_Template<INFO, TYPE>::getImplementationName()
+{
+  if (itsEncryptionObject != NULL) {
+    return getAlgorithmProvider(*itsEncryptionObject);
+  }
+
+  // the implementation doesn't depend on the key, so a throwaway object
+  // keyed with zeroes does if no key has been set yet
+  string key(this->itsKey);
+  this->itsKey.resize(this->itsKeylength);
+  member_ptr<SymmetricCipher> cipher;
+  try {
+    cipher.reset(getEncryptionObject());
+  }
+  catch (...) {
+    this->itsKey.swap(key);
+    throw;
+  }
+  this->itsKey.swap(key);
+
+  return cipher.get() == NULL ? "unknown" : getAlgorithmProvider(*cipher);
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+bool JStream_Template<INFO, TYPE>::isRandomAccess()
+{
+  if (itsEncryptionObject != NULL) {
+    return itsEncryptionObject->IsRandomAccess();
+  }
+
+  // seeking doesn't depend on the key either
+  string key(this->itsKey);
+  this->itsKey.resize(this->itsKeylength);
+  member_ptr<SymmetricCipher> cipher;
+  try {
+    cipher.reset(getEncryptionObject());
+  }
+  catch (...) {
+    this->itsKey.swap(key);
+    throw;
   }
+  this->itsKey.swap(key);
+
+  return cipher.get() != NULL && cipher->IsRandomAccess();
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+void JStream_Template<INFO, TYPE>::seek(const lword position)
+{
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
+  else if (position > 0 && !isRandomAccess()) {
+    throw JException(this->getCipherName() + " can't seek in its keystream");
+  }
+
+  if (position != this->itsPosition) {
+    this->itsKeystream.clear();
+  }
+
+  this->itsPosition = position;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+string JStream_Template<INFO, TYPE>::processAt(const lword position, const string& data, const volatile bool* interrupted)
+{
+  if (position > 0 && !isRandomAccess()) {
+    throw JException(this->getCipherName() + " can't seek in its keystream");
+  }
+
+  SymmetricCipher* cipher = getEncryptionCipher();
+
+  if (cipher == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  // the cipher comes back at itsPosition, and Seek() counts from the start
+  // of the keystream rather than from there
+  if (position != this->itsPosition) {
+    cipher->Seek(position);
+  }
+
+  string retval;
+  StringSource source(data, false, new StreamTransformationFilter(*cipher, new StringSink(retval)));
+  pumpAll(source, interrupted);
+
+  return retval;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+void JStream_Template<INFO, TYPE>::precomputeKeystream(const size_t length, const bool background, const volatile bool* interrupted)
+{
+  if (this->itsStream != NULL) {
+    throw JException("a stream is in progress on this cipher; call final first");
+  }
+
+  // a fresh object so a background fill has it to itself
+  member_ptr<SymmetricCipher> cipher(getEncryptionObject());
+
+  if (cipher.get() == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  rewind(cipher.get());
+  this->itsKeystream.start(cipher.release(), NULL, this->itsIV, length, background, interrupted);
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+CipherEnum JStream_Template<INFO, TYPE>::getCipherType() const
+{
+  return TYPE;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+size_t JStream_Template<INFO, TYPE>::processMessage(const byte* in, const size_t length, byte* out, const bool decrypting, const volatile bool* interrupted)
+{
+  if (this->applyKeystream(in, length, out)) {
+    return length;
+  }
+
+  SymmetricCipher* cipher = decrypting ? getDecryptionCipher() : getEncryptionCipher();
+
+  if (cipher == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  // the whole message is already in memory, so there's nothing for a
+  // filter to do
+  processAll(*cipher, in, out, length, interrupted);
+
+  return length;
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+void JStream_Template<INFO, TYPE>::processInPlace(byte* data, const size_t length, const bool decrypting, const volatile bool* interrupted)
+{
+  if (this->applyKeystream(data, length, data)) {
+    return;
+  }
+
+  SymmetricCipher* cipher = decrypting ? getDecryptionCipher() : getEncryptionCipher();
+
+  if (cipher == NULL) {
+    throw JException("could not create a cipher object");
+  }
+
+  processAll(*cipher, data, data, length, interrupted);
+}
+
+template <typename INFO, enum CipherEnum TYPE>
+bool JStream_Template<INFO, TYPE>::encryptRubyIO(VALUE* in, VALUE* out)
+{
+  SymmetricCipher* cipher = getEncryptionCipher();
+
+  if (cipher == NULL) {
+    return false;
+  }
+
+  RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out)));
 
   return true;
 }
@@ -102,21 +317,14 @@ bool JStream_Template<INFO, TYPE>::encryptRubyIO(VALUE* in, VALUE* out)
 template <typename INFO, enum CipherEnum TYPE>
 bool JStream_Template<INFO, TYPE>::decryptRubyIO(VALUE* in, VALUE* out)
 {
-  StreamTransformation* cipher = NULL;
+  SymmetricCipher* cipher = getDecryptionCipher();
 
-  cipher = getDecryptionObject();
-
-  if (cipher != NULL) {
-    try {
-      RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out)));
-    }
-    catch (RubyIOStore::OpenErr e) {
-      delete cipher;
-      throw e;
-    }
-    delete cipher;
+  if (cipher == NULL) {
+    return false;
   }
 
+  RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out)));
+
   return true;
 }
 
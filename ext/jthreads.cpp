@@ -0,0 +1,277 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include <exception>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "jthreads.h"
+#include "jexception.h"
+
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+#include "ruby/thread.h"
+#endif
+
+using namespace std;
+
+#define PUMP_CHUNK_SIZE (64 * 1024)
+#define WORK_ERROR_SIZE 256
+
+static size_t gvlThreshold = 64 * 1024;
+
+struct JWork
+{
+  JWorkFunction func;
+  void* data;
+  volatile bool interrupted;
+  bool failed;
+  char error[WORK_ERROR_SIZE];
+  int state;
+};
+
+// set while the calling thread is running work without the GVL
+static __thread bool workThread = false;
+
+// the work the calling thread is running with the GVL held, if any, for
+// waitWithoutGVL to hand a raise on to
+static __thread JWork* gvlWork = NULL;
+
+static void work_call(JWork* work)
+{
+  try {
+    work->func(work->data, &work->interrupted);
+  }
+  catch (Exception& e) {
+    work->failed = true;
+    strncpy(work->error, e.GetWhat().c_str(), WORK_ERROR_SIZE - 1);
+  }
+  catch (std::exception& e) {
+    work->failed = true;
+    strncpy(work->error, e.what(), WORK_ERROR_SIZE - 1);
+  }
+}
+
+size_t getGVLThreshold()
+{
+  return gvlThreshold;
+}
+
+void setGVLThreshold(const size_t threshold)
+{
+  gvlThreshold = threshold;
+}
+
+static bool canReleaseGVL()
+{
+  return !workThread && !rb_during_gc();
+}
+
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+static void* work_call_without_gvl(void* ptr)
+{
+  JWork* work = (JWork*) ptr;
+
+  workThread = true;
+  work_call(work);
+  workThread = false;
+
+  return ptr;
+}
+
+/* Called by Ruby when it wants the thread back, for Thread#raise,
+ * Thread#kill, a signal or Thread#wakeup. The work stops at its next look at
+ * the flag. */
+static void work_unblock(void* ptr)
+{
+  ((JWork*) ptr)->interrupted = true;
+}
+
+static VALUE work_check_ints(VALUE unused)
+{
+  rb_thread_check_ints();
+  return Qnil;
+}
+
+/* Runs the work on this thread without the GVL. If Ruby interrupts it and
+ * then raises, the tag is returned rather than jumped to, since the caller
+ * still has C++ objects to destroy. An interrupt that doesn't raise, like a
+ * trapped signal, only costs the work if it arrived in time to stop it, in
+ * which case the work fails with "operation interrupted". */
+static int work_run_without_gvl(JWork* work)
+{
+  int state = 0;
+
+  // returns NULL without calling the work at all if an interrupt is already
+  // pending, so handle that first
+  while (rb_thread_call_without_gvl2(work_call_without_gvl, work, work_unblock, work) == NULL) {
+    rb_protect(work_check_ints, Qnil, &state);
+    if (state != 0) {
+      return state;
+    }
+  }
+
+  if (work->interrupted) {
+    rb_protect(work_check_ints, Qnil, &state);
+  }
+  return state;
+}
+#endif
+
+int runWithoutGVL(JWorkFunction func, void* data, const size_t length)
+{
+  JWork work;
+  int state = 0;
+
+  work.func = func;
+  work.data = data;
+  work.interrupted = false;
+  work.failed = false;
+  memset(work.error, 0, WORK_ERROR_SIZE);
+  work.state = 0;
+
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+  if (length >= gvlThreshold && canReleaseGVL()) {
+    state = work_run_without_gvl(&work);
+  }
+  else
+#endif
+  {
+    JWork* outer = gvlWork;
+    gvlWork = &work;
+    work_call(&work);
+    gvlWork = outer;
+    state = work.state;
+  }
+
+  if (state == 0 && work.failed) {
+    throw JException(work.error);
+  }
+  return state;
+}
+
+bool waitWithoutGVL(JWaitFunction func, JWakeFunction wake, void* data)
+{
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+  JWork* work = gvlWork;
+
+  if (work != NULL && !rb_during_gc()) {
+    while (rb_thread_call_without_gvl2(func, data, wake, data) == NULL) {
+      int state = 0;
+
+      rb_protect(work_check_ints, Qnil, &state);
+      if (state != 0) {
+        work->state = state;
+        work->interrupted = true;
+        return false;
+      }
+    }
+    return true;
+  }
+#endif
+
+  while (func(data) == NULL) {
+  }
+  return true;
+}
+
+void pumpAll(Source& source, const volatile bool* interrupted)
+{
+  if (interrupted != NULL) {
+    while (source.Pump(PUMP_CHUNK_SIZE) > 0) {
+      if (*interrupted) {
+        throw JException("operation interrupted");
+      }
+    }
+  }
+
+  source.PumpAll();
+}
+
+void processAll(StreamTransformation& cipher, const byte* in, byte* out, const size_t length, const volatile bool* interrupted)
+{
+  for (size_t done = 0; done < length; done += PARALLEL_CHUNK_SIZE) {
+    if (interrupted != NULL && *interrupted) {
+      throw JException("operation interrupted");
+    }
+    size_t chunk = STDMIN((size_t) PARALLEL_CHUNK_SIZE, length - done);
+    cipher.ProcessData(out + done, in + done, chunk);
+  }
+}
+
+struct JTask
+{
+  JTaskFunction func;
+  void* data;
+  unsigned int index;
+  bool started;
+  bool failed;
+  string error;
+  pthread_t thread;
+};
+
+static void* task_run(void* ptr)
+{
+  JTask* task = (JTask*) ptr;
+
+  try {
+    task->func(task->data, task->index);
+  }
+  catch (Exception& e) {
+    task->failed = true;
+    task->error = e.GetWhat();
+  }
+  catch (std::exception& e) {
+    task->failed = true;
+    task->error = e.what();
+  }
+
+  return NULL;
+}
+
+unsigned int getProcessorCount()
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (unsigned int) count : 1;
+}
+
+void runInParallel(JTaskFunction func, void* data, const unsigned int count)
+{
+  vector<JTask> tasks(count);
+
+  for (unsigned int i = 0; i < count; ++i) {
+    tasks[i].func = func;
+    tasks[i].data = data;
+    tasks[i].index = i;
+    tasks[i].started = false;
+    tasks[i].failed = false;
+  }
+
+  for (unsigned int i = 1; i < count; ++i) {
+    tasks[i].started = (pthread_create(&tasks[i].thread, NULL, task_run, &tasks[i]) == 0);
+  }
+
+  task_run(&tasks[0]);
+
+  for (unsigned int i = 1; i < count; ++i) {
+    if (tasks[i].started) {
+      pthread_join(tasks[i].thread, NULL);
+    }
+    else {
+      // couldn't get a thread, so do the work here instead
+      task_run(&tasks[i]);
+    }
+  }
+
+  for (unsigned int i = 0; i < count; ++i) {
+    if (tasks[i].failed) {
+      throw JException(tasks[i].error);
+    }
+  }
+}
@@ -0,0 +1,82 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JTHREADS_H__
+#define __JTHREADS_H__
+
+#include "ruby.h"
+
+// Crypto++ headers...
+
+#include "filters.h"
+
+using namespace CryptoPP;
+
+// Work functions are handed a flag that gets set if they should stop early
+// because Ruby wants the thread back, i.e. for Thread#raise, Thread#kill or
+// a signal.
+typedef void (*JWorkFunction)(void* data, const volatile bool* interrupted);
+
+// Payloads of at least this many bytes are processed without the GVL.
+size_t getGVLThreshold();
+void setGVLThreshold(const size_t threshold);
+
+// Runs func on the calling thread, without the GVL if length is at or above
+// the threshold. Exceptions thrown by func are rethrown as JExceptions once
+// the GVL has been reacquired. func must not touch any Ruby objects.
+//
+// If Ruby raises while func runs, e.g. for Thread#raise or Ctrl-C, func is
+// stopped and the tag of the pending exception is returned instead of being
+// jumped to. Callers have to let their C++ objects go out of scope and then
+// pass a non-zero tag to rb_jump_tag(), since longjmping straight past them
+// would skip their destructors. Returns 0 otherwise.
+int runWithoutGVL(JWorkFunction func, void* data, const size_t length);
+
+// Waits for something to finish, returning non-NULL once it has or NULL
+// early once woken, the same as for rb_thread_call_without_gvl2().
+typedef void* (*JWaitFunction)(void* data);
+typedef void (*JWakeFunction)(void* data);
+
+// Waits through func for work that runWithoutGVL() is running with the GVL
+// held, e.g. for a background thread to finish. The GVL is let go of in the
+// meantime. Interrupts that don't raise, like a trapped signal, are handled
+// in between and the wait carries on. If Ruby raises, the work's interrupted
+// flag is set, false is returned without waiting any longer, and
+// runWithoutGVL() returns the tag once the work has stopped. Anywhere else,
+// e.g. without the GVL, this just waits and returns true.
+bool waitWithoutGVL(JWaitFunction func, JWakeFunction wake, void* data);
+
+// Pumps a Source through to the end in chunks, throwing a JException if
+// interrupted is set in between.
+void pumpAll(Source& source, const volatile bool* interrupted);
+
+// The same for running length bytes straight through cipher with
+// ProcessData(), which may be done in place with in and out the same.
+// length has to suit the cipher, i.e. be whole blocks for CBC.
+void processAll(StreamTransformation& cipher, const byte* in, byte* out, const size_t length, const volatile bool* interrupted);
+
+// Work is only split over several threads if every thread gets at least
+// this many bytes, otherwise starting the threads costs more than it saves.
+#define PARALLEL_MIN_SEGMENT_SIZE (256 * 1024)
+
+// The size of the pieces parallel work is done in between checks of the
+// interrupted flag.
+#define PARALLEL_CHUNK_SIZE (64 * 1024)
+
+// An upper limit on the threads option, mostly to catch typos.
+#define MAX_THREADS 64
+
+typedef void (*JTaskFunction)(void* data, const unsigned int index);
+
+unsigned int getProcessorCount();
+
+// Runs func(data, 0) through func(data, count - 1) on count native threads,
+// one of which is the calling thread, and waits for all of them. The first
+// exception thrown by any of them is rethrown as a JException.
+void runInParallel(JTaskFunction func, void* data, const unsigned int count);
+
+#endif
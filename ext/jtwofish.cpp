@@ -6,17 +6,26 @@
  */
 
 #include "jtwofish.h"
+#include "jmultiblock.h"
 
 #if ENABLED_TWOFISH_CIPHER
 
 BlockCipher* JTwofish::getEncryptionObject()
 {
+#if ENABLED_MULTIBLOCK && MULTIBLOCK_GATHER
+  return new JTwofishMultiBlock(TwofishEncryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new TwofishEncryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 BlockCipher* JTwofish::getDecryptionObject()
 {
+#if ENABLED_MULTIBLOCK && MULTIBLOCK_GATHER
+  return new JTwofishMultiBlock(TwofishDecryption((byte*) itsKey.data(), itsKeylength), (byte*) itsKey.data(), itsKeylength);
+#else
   return new TwofishDecryption((byte*) itsKey.data(), itsKeylength);
+#endif
 }
 
 #endif
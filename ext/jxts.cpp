@@ -0,0 +1,182 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jxts.h"
+#include "jexception.h"
+
+// Crypto++ headers...
+
+#include "misc.h"
+#include "secblock.h"
+#include "smartptr.h"
+
+#define XTS_BLOCK_SIZE 16
+
+// How many blocks xts_unit() hands to the block cipher at once.
+#define XTS_PARALLEL_BLOCKS 64
+
+struct JXTSJob
+{
+  const BlockCipher* cipher;
+  const BlockCipher* tweakCipher;
+  const byte* tweak;
+  const byte* in;
+  byte* out;
+  size_t sectorSize;
+  size_t sectors;
+  size_t sectorsPerThread;
+  bool decrypting;
+  const volatile bool* interrupted;
+};
+
+/* Multiplies a tweak by alpha, the little-endian doubling of IEEE 1619. */
+static void xts_multiply(byte* t)
+{
+  byte carry = 0;
+
+  for (unsigned int i = 0; i < XTS_BLOCK_SIZE; ++i) {
+    byte next = t[i] >> 7;
+    t[i] = (byte) ((t[i] << 1) | carry);
+    carry = next;
+  }
+
+  if (carry) {
+    t[0] ^= 0x87;
+  }
+}
+
+/* Adds n to a 16 byte little-endian number. */
+static void xts_add(byte* value, word64 n)
+{
+  for (unsigned int i = 0; i < XTS_BLOCK_SIZE && n > 0; ++i) {
+    n += value[i];
+    value[i] = (byte) n;
+    n >>= 8;
+  }
+}
+
+/* Processes one block as out = T xor E(in xor T). */
+static void xts_block(const BlockCipher& cipher, const byte* t, const byte* in, byte* out)
+{
+  byte work[XTS_BLOCK_SIZE];
+
+  xorbuf(work, in, t, XTS_BLOCK_SIZE);
+  cipher.ProcessAndXorBlock(work, t, out);
+}
+
+/* Processes a single data unit. t starts out as the encrypted tweak and is
+ * used as workspace. */
+static void xts_unit(const BlockCipher& cipher, byte* t, const byte* in, byte* out, const size_t length, const bool decrypting, SecByteBlock& tweaks, SecByteBlock& work)
+{
+  size_t partial = length % XTS_BLOCK_SIZE;
+
+  // with ciphertext stealing the last full block is handled with the
+  // partial one
+  size_t blocks = length / XTS_BLOCK_SIZE - (partial > 0 ? 1 : 0);
+
+  // the tweaks for a run of blocks are worked out first so the block
+  // cipher gets the whole run in one AdvancedProcessBlocks call
+  for (size_t done = 0; done < blocks; ) {
+    size_t run = STDMIN(blocks - done, (size_t) XTS_PARALLEL_BLOCKS);
+    size_t offset = done * XTS_BLOCK_SIZE;
+
+    for (size_t i = 0; i < run; ++i) {
+      memcpy(tweaks + XTS_BLOCK_SIZE * i, t, XTS_BLOCK_SIZE);
+      xts_multiply(t);
+    }
+
+    xorbuf(work, in + offset, tweaks, run * XTS_BLOCK_SIZE);
+    cipher.AdvancedProcessBlocks(work, tweaks, out + offset, run * XTS_BLOCK_SIZE, 0);
+    done += run;
+  }
+
+  if (partial > 0) {
+    size_t offset = blocks * XTS_BLOCK_SIZE;
+    byte last[XTS_BLOCK_SIZE];
+    byte stolen[XTS_BLOCK_SIZE];
+    byte next[XTS_BLOCK_SIZE];
+
+    // decryption uses the tweaks for the last two blocks the other way
+    // around
+    memcpy(next, t, XTS_BLOCK_SIZE);
+    xts_multiply(next);
+
+    xts_block(cipher, decrypting ? next : t, in + offset, last);
+
+    // the partial block is padded out with the tail of the processed last
+    // full block, which in turn gives up its head as the partial output
+    memcpy(stolen, in + offset + XTS_BLOCK_SIZE, partial);
+    memcpy(stolen + partial, last + partial, XTS_BLOCK_SIZE - partial);
+
+    memcpy(out + offset + XTS_BLOCK_SIZE, last, partial);
+    xts_block(cipher, decrypting ? t : next, stolen, out + offset);
+  }
+}
+
+/* Processes one thread's share of the units in a job. */
+static void xts_segment(void* data, const unsigned int index)
+{
+  JXTSJob* job = (JXTSJob*) data;
+  size_t first = job->sectorsPerThread * index;
+
+  if (first >= job->sectors) {
+    return;
+  }
+
+  size_t count = STDMIN(job->sectorsPerThread, job->sectors - first);
+
+  // see ctr_segment() in jparallel.cpp for why these are copied
+  member_ptr<BlockCipher> cipher((BlockCipher*) job->cipher->Clone());
+  member_ptr<BlockCipher> tweakCipher((BlockCipher*) job->tweakCipher->Clone());
+
+  SecByteBlock tweaks(XTS_BLOCK_SIZE * XTS_PARALLEL_BLOCKS);
+  SecByteBlock work(XTS_BLOCK_SIZE * XTS_PARALLEL_BLOCKS);
+  byte sector[XTS_BLOCK_SIZE];
+  byte t[XTS_BLOCK_SIZE];
+
+  memcpy(sector, job->tweak, XTS_BLOCK_SIZE);
+  xts_add(sector, first);
+
+  for (size_t i = first; i < first + count; ++i) {
+    if (job->interrupted != NULL && *job->interrupted) {
+      throw JException("operation interrupted");
+    }
+
+    tweakCipher->ProcessBlock(sector, t);
+    xts_unit(*cipher, t, job->in + i * job->sectorSize, job->out + i * job->sectorSize, job->sectorSize, job->decrypting, tweaks, work);
+    xts_add(sector, 1);
+  }
+}
+
+void processXTS(const BlockCipher& cipher, const BlockCipher& tweakCipher, const byte* tweak, const byte* in, byte* out, const size_t length, const size_t sectorSize, const bool decrypting, const unsigned int threads, const volatile bool* interrupted)
+{
+  if (cipher.BlockSize() != XTS_BLOCK_SIZE) {
+    throw JException("XTS mode needs a cipher with 128-bit blocks");
+  }
+  else if (sectorSize < XTS_BLOCK_SIZE) {
+    throw JException("XTS data units must be at least one block long");
+  }
+  else if (length % sectorSize != 0) {
+    throw JException("the data isn't a whole number of sectors");
+  }
+
+  JXTSJob job;
+  job.cipher = &cipher;
+  job.tweakCipher = &tweakCipher;
+  job.tweak = tweak;
+  job.in = in;
+  job.out = out;
+  job.sectorSize = sectorSize;
+  job.sectors = length / sectorSize;
+  job.decrypting = decrypting;
+  job.interrupted = interrupted;
+
+  unsigned int count = (unsigned int) STDMAX((size_t) 1, STDMIN((size_t) threads, job.sectors));
+  job.sectorsPerThread = (job.sectors + count - 1) / count;
+
+  runInParallel(xts_segment, &job, count);
+}
@@ -0,0 +1,32 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JXTS_H__
+#define __JXTS_H__
+
+#include "jthreads.h"
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+
+using namespace CryptoPP;
+
+// XTS as in IEEE 1619 over consecutive data units ("sectors") of sectorSize
+// bytes, with ciphertext stealing when sectorSize isn't a multiple of the
+// block size. tweak is the 16 byte tweak value of the first unit and is
+// incremented as a little-endian number for each unit after it, so for
+// storage it's simply the first sector number.
+//
+// cipher is keyed with the data key in the direction wanted, tweakCipher is
+// the encryption direction keyed with the tweak key. Both need 128-bit
+// blocks. length must be a multiple of sectorSize, which must be at least
+// one block. Units are spread over threads, each of which works on its own
+// copies of the ciphers.
+void processXTS(const BlockCipher& cipher, const BlockCipher& tweakCipher, const byte* tweak, const byte* in, byte* out, const size_t length, const size_t sectorSize, const bool decrypting, const unsigned int threads, const volatile bool* interrupted);
+
+#endif
@@ -6,3 +6,90 @@
  */
 
 #include "cryptopp_ruby_api.h"
+#include "jthreads.h"
+
+// Crypto++ headers...
+
+#include "cpu.h"
+
+/**
+ * call-seq:
+ *    gvl_threshold => Integer
+ *
+ * Returns the size in bytes at and above which encrypt, decrypt and digest
+ * calculations release the GVL while they work.
+ */
+VALUE rb_module_gvl_threshold(VALUE self)
+{
+  return ULONG2NUM(getGVLThreshold());
+}
+
+/**
+ * call-seq:
+ *    gvl_threshold = Integer
+ *
+ * Sets the size in bytes at and above which encrypt, decrypt and digest
+ * calculations release the GVL while they work. Releasing the GVL lets other
+ * Ruby threads run alongside but has some overhead of its own, so small
+ * payloads are better off keeping it. The default is 64 KB.
+ */
+VALUE rb_module_gvl_threshold_eq(VALUE self, VALUE threshold)
+{
+  setGVLThreshold(NUM2ULONG(threshold));
+  return threshold;
+}
+
+/* Sets one entry of the cpu_features Hash. */
+static void cpu_feature(VALUE features, const char* name, bool available)
+{
+  rb_hash_aset(features, ID2SYM(rb_intern(name)), available ? Qtrue : Qfalse);
+}
+
+/**
+ * call-seq:
+ *    cpu_features => Hash
+ *
+ * Returns a Hash of the CPU features Crypto++ detected at runtime and may
+ * use to speed things up, such as <tt>:aesni</tt> and <tt>:clmul</tt> on
+ * x86 or <tt>:neon</tt> and <tt>:aes</tt> on ARM. Which features are listed
+ * depends on the platform and the Crypto++ version. Whether a particular
+ * algorithm makes use of them is reported by Cipher#implementation_name and
+ * Digest#implementation_name.
+ */
+VALUE rb_module_cpu_features(VALUE self)
+{
+  VALUE retval = rb_hash_new();
+
+  // nothing is detected when the extension is built with --disable-asm
+#if defined(CRYPTOPP_DISABLE_ASM)
+#elif CRYPTOPP_BOOL_X86 || CRYPTOPP_BOOL_X32 || CRYPTOPP_BOOL_X64
+  cpu_feature(retval, "sse2", HasSSE2());
+#  if CRYPTOPP_VERSION >= 561
+  cpu_feature(retval, "ssse3", HasSSSE3());
+  cpu_feature(retval, "aesni", HasAESNI());
+  cpu_feature(retval, "clmul", HasCLMUL());
+#  endif
+#  if CRYPTOPP_VERSION >= 563
+  cpu_feature(retval, "rdrand", HasRDRAND());
+  cpu_feature(retval, "rdseed", HasRDSEED());
+#  endif
+#  if CRYPTOPP_VERSION >= 600
+  cpu_feature(retval, "sse41", HasSSE41());
+  cpu_feature(retval, "sse42", HasSSE42());
+  cpu_feature(retval, "sha", HasSHA());
+#  endif
+#  if CRYPTOPP_VERSION >= 800
+  cpu_feature(retval, "avx", HasAVX());
+  cpu_feature(retval, "avx2", HasAVX2());
+#  endif
+#elif (CRYPTOPP_BOOL_ARM32 || CRYPTOPP_BOOL_ARMV8 || CRYPTOPP_BOOL_ARM64) && CRYPTOPP_VERSION >= 600
+  cpu_feature(retval, "neon", HasNEON());
+  cpu_feature(retval, "pmull", HasPMULL());
+  cpu_feature(retval, "aes", HasAES());
+  cpu_feature(retval, "sha1", HasSHA1());
+  cpu_feature(retval, "sha2", HasSHA2());
+  cpu_feature(retval, "crc32", HasCRC32());
+#endif
+
+  return retval;
+}
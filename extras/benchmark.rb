@@ -0,0 +1,52 @@
+#!/usr/bin/env ruby
+
+# Throughput of the block ciphers in the modes where several blocks can be
+# worked on at once: ECB and CTR in both directions and CBC decryption.
+# Each is run on one thread and then on every core, along with the code
+# path picked for the cipher, be it one of Crypto++'s or one of the SIMD
+# kernels in jmultiblock.cpp, so the speedup for each algorithm is easy to
+# see. RC6, Twofish, Camellia and CAST-256 only get a kernel when the
+# extension was configured with --enable-native on a CPU with AVX2.
+#
+#   ruby extras/benchmark.rb [megabytes] [algorithm ...]
+
+require 'benchmark'
+require 'etc'
+require File.join(File.dirname(__FILE__), %w{ .. ext cryptopp })
+
+ALGORITHMS = [ :aes, :twofish, :serpent, :camellia, :cast256, :rc6, :mars, :shacal2 ]
+
+megabytes = (ARGV.shift || 16).to_i
+algorithms = ARGV.empty? ? ALGORITHMS : ARGV.collect(&:to_sym)
+data = Random.new(0).bytes(megabytes * 1024 * 1024)
+cores = Etc.nprocessors
+
+def throughput(bytes, seconds)
+  '%9.1f MB/s' % (bytes / seconds / 1024 / 1024)
+end
+
+puts "Crypto++ #{CryptoPP::CRYPTOPP_VERSION}, #{megabytes} MB, 1 and #{cores} threads"
+puts
+
+algorithms.each do |algorithm|
+  next unless CryptoPP.cipher_enabled?(algorithm)
+
+  [ :ecb, :ctr, :cbc ].each do |mode|
+    cipher = CryptoPP.cipher_factory(algorithm, :block_mode => mode, :padding => :none, :key => 'k' * 16, :iv => 'i' * 32)
+    ciphertext = cipher.encrypt(data)
+
+    results = [ 1, cores ].collect do |threads|
+      cipher.threads = threads
+      encrypt = Benchmark.realtime { cipher.encrypt(data) }
+      decrypt = Benchmark.realtime { cipher.decrypt(ciphertext) }
+      [ mode == :cbc ? nil : encrypt, decrypt ]
+    end
+
+    line = '%-10s %-4s %-12s' % [ algorithm, mode, cipher.implementation_name ]
+    [ 0, 1 ].each do |i|
+      next if results[0][i].nil?
+      line << "  #{i == 0 ? 'enc' : 'dec'} #{throughput(data.length, results[0][i])} -> #{throughput(data.length, results[1][i])}"
+    end
+    puts line
+  end
+end
@@ -1,6 +1,7 @@
 
 $: << File.dirname(__FILE__)
 require 'test_helper'
+require 'stringio'
 
 class CiphersTest < MiniTest::Unit::TestCase
   extend TestHelper
@@ -26,6 +27,764 @@ class CiphersTest < MiniTest::Unit::TestCase
           assert_equal(decrypt.ciphertext_hex, options[:ciphertext_hex])
         end
       end
+
+      define_method("test_#{test_name}_#{i}_streaming") do
+        if CryptoPP.cipher_enabled? options[:algorithm]
+          cipher = CryptoPP.cipher_factory options[:algorithm], options.reject { |k, v|
+            [ :algorithm ].include? k
+          }
+          plaintext, ciphertext = cipher.plaintext, cipher.ciphertext
+          half = plaintext.length / 2
+
+          encrypted = cipher.update(plaintext[0, half]) + cipher.update(plaintext[half..-1]) + cipher.final
+          assert_equal(ciphertext, encrypted)
+
+          decrypted = cipher.decrypt_update(ciphertext[0, half]) + cipher.decrypt_update(ciphertext[half..-1]) + cipher.final
+          assert_equal(plaintext, decrypted)
+        end
+      end
+    end
+  end
+
+  def test_without_gvl
+    threshold = CryptoPP.gvl_threshold
+    CryptoPP.gvl_threshold = 0
+
+    cipher = CryptoPP.cipher_factory(:aes, :key_hex => '00' * 16, :block_mode => :cbc, :iv_hex => '00' * 16)
+    cipher.plaintext = 'x' * 100_000
+    ciphertext = cipher.encrypt
+    cipher.ciphertext = ciphertext
+    assert_equal('x' * 100_000, cipher.decrypt)
+  ensure
+    CryptoPP.gvl_threshold = threshold
+  end
+
+  def test_parallel_ctr
+    options = { :key_hex => '01' * 16, :block_mode => :ctr, :iv_hex => 'ff' * 16 }
+    plaintext = (0...256).map(&:chr).join * 8192
+
+    serial = CryptoPP.cipher_factory(:aes, options)
+    serial.plaintext = plaintext
+
+    parallel = CryptoPP.cipher_factory(:aes, options.merge(:threads => 4))
+    parallel.plaintext = plaintext
+
+    ciphertext = parallel.encrypt
+    assert_equal(serial.encrypt, ciphertext)
+
+    parallel.ciphertext = ciphertext
+    assert_equal(plaintext, parallel.decrypt)
+  end
+
+  def test_parallel_ecb
+    plaintext = (0...256).map(&:chr).join * 8192
+
+    [ :twofish, :serpent ].each do |algorithm|
+      [ [ :pkcs, plaintext + "odd" ], [ :zeros, plaintext ], [ :none, plaintext ] ].each do |padding, message|
+        options = { :key_hex => '01' * 16, :block_mode => :ecb, :padding => padding }
+        expected = CryptoPP.cipher_factory(algorithm, options).encrypt(message)
+        parallel = CryptoPP.cipher_factory(algorithm, options.merge(:threads => 4))
+
+        assert_equal(expected, parallel.encrypt(message), "#{algorithm} #{padding}")
+        assert_equal(message, parallel.decrypt(expected), "#{algorithm} #{padding}")
+      end
+    end
+  end
+
+  def test_parallel_chained_decryption
+    plaintext = (0...256).map(&:chr).join * 8192 + 'tail'
+
+    [ :cbc, :cbc_cts, :cfb ].each do |mode|
+      options = { :key_hex => '01' * 16, :block_mode => mode, :iv_hex => 'ff' * 16 }
+
+      serial = CryptoPP.cipher_factory(:aes, options)
+      serial.plaintext = plaintext
+      ciphertext = serial.encrypt
+
+      parallel = CryptoPP.cipher_factory(:aes, options.merge(:threads => 4))
+      parallel.ciphertext = ciphertext
+      assert_equal(plaintext, parallel.decrypt, "#{mode} decrypt")
+
+      output = StringIO.new
+      parallel.decrypt_io(StringIO.new(ciphertext), output)
+      assert_equal(plaintext, output.string.force_encoding("BINARY"), "#{mode} decrypt_io")
+    end
+  end
+
+  def test_bitsliced_des
+    %w{ descert 3desval }.each do |file|
+      YAML.load_file("test/data/ciphers/#{file}.yml").each do |options|
+        next if options[:block_mode] || !CryptoPP.cipher_enabled?(options[:algorithm])
+        assert_repeated_vector(options[:algorithm], options, 1000)
+      end
+    end
+
+    [ :des, :des_ede2, :des_ede3, :des_xex3 ].each do |algorithm|
+      next unless CryptoPP.cipher_enabled?(algorithm)
+
+      # every subkey different, so a mixed up key schedule shows
+      key_length = { :des => 8, :des_ede2 => 16 }.fetch(algorithm, 24)
+      key_hex = ('0123456789abcdef' 'fedcba9876543210' '89abcdef01234567')[0, key_length * 2]
+      assert_bulk_modes(algorithm, key_hex, 8)
+    end
+  end
+
+  def test_multiblock
+    { :serpent => 'serpentv', :rc6 => 'rc6val', :shacal2 => 'shacal2', :twofish => 'twofishv', :camellia => 'camellia', :cast256 => 'cast256v' }.each do |algorithm, file|
+      next unless CryptoPP.cipher_enabled?(algorithm)
+
+      vectors = YAML.load_file("test/data/ciphers/#{file}.yml").reject { |options| options[:block_mode] }
+      vectors.each do |options|
+        assert_repeated_vector(algorithm, options, 1001)
+      end
+
+      # every key schedule, including the ones the vectors miss
+      [ 16, 24, 32 ].each do |key_length|
+        assert_bulk_modes(algorithm, ('0123456789abcdef' * 4)[0, key_length * 2], vectors.first[:plaintext_hex].length / 2)
+      end
+    end
+  end
+
+  def test_fixed_rounds
+    # RC5 at its default 16 rounds, where rc5val.yml only has 12
+    if CryptoPP.cipher_enabled?(:rc5)
+      cipher = CryptoPP.cipher_factory(:rc5, :key_hex => '915f4619be41b2516355a50110a9ce91', :block_mode => :ecb, :padding => :none)
+      assert_equal([ 'a78952d7f0f35712' ].pack('H*'), cipher.encrypt([ '21a5dbee154b8f6d' ].pack('H*')))
+    end
+
+    # known answers away from the default rounds, which skip the unrolled
+    # versions, worked out with the reference algorithms
+    [
+      [ :rc5, 8, '000102030405060708090a0b0c0d0e0f', '0011223344556677', '5564155aba1e3c57' ],
+      [ :rc5, 20, '000102030405060708090a0b0c0d0e0f', '0011223344556677', '46d289aee461054b' ],
+      [ :rc6, 12, '000102030405060708090a0b0c0d0e0f', '00112233445566778899aabbccddeeff', 'b39e8c38e0f1688455f1bc4339d1b758' ],
+      [ :rc6, 24, '000102030405060708090a0b0c0d0e0f', '00112233445566778899aabbccddeeff', '1070c382042f22ac45a7bb15515adf80' ],
+      [ :safer_k, 8, '0001020304050607', '0011223344556677', '0199a2457fb4ba55' ],
+      [ :safer_k, 12, '000102030405060708090a0b0c0d0e0f', '0011223344556677', 'fcb7732e3a17f25c' ],
+      [ :safer_sk, 8, '0001020304050607', '0011223344556677', '1415cfb13aeb59e9' ],
+      [ :safer_sk, 10, '000102030405060708090a0b0c0d0e0f', '0011223344556677', 'ad2e972682af453a' ]
+    ].each do |algorithm, rounds, key_hex, plaintext_hex, ciphertext_hex|
+      next unless CryptoPP.cipher_enabled?(algorithm)
+      assert_repeated_vector(algorithm, { :rounds => rounds, :key_hex => key_hex, :plaintext_hex => plaintext_hex, :ciphertext_hex => ciphertext_hex }, 1001)
+    end
+
+    plaintext = (0...256).map(&:chr).join * 16
+
+    { :rc5 => 16, :rc6 => 20, :safer_k => 6, :safer_sk => 6 }.each do |algorithm, rounds|
+      next unless CryptoPP.cipher_enabled?(algorithm)
+
+      ciphertexts = [ rounds, rounds + 1 ].collect do |r|
+        cipher = CryptoPP.cipher_factory(algorithm, :key_hex => '0123456789abcdef', :block_mode => :ecb, :padding => :none, :rounds => r)
+        ciphertext = cipher.encrypt(plaintext)
+        assert_equal(plaintext, cipher.decrypt(ciphertext), "#{algorithm} #{r} rounds")
+        ciphertext
+      end
+
+      refute_equal(ciphertexts.first, ciphertexts.last, "#{algorithm} rounds")
+    end
+  end
+
+  def test_batch
+    messages = [ 'foo', '', 'a' * 100, (0...256).map(&:chr).join * 4096 ]
+    ivs = (0...messages.length).collect { |i| i.chr * 16 }
+
+    [ 1, 4 ].each do |threads|
+      cipher = CryptoPP.cipher_factory(:aes, :key_hex => '01' * 16, :block_mode => :cbc, :padding => :pkcs, :threads => threads)
+      cipher.iv = 'iv' * 8
+      ciphertexts = cipher.encrypt_batch(messages, :ivs => ivs)
+
+      messages.each_with_index do |message, i|
+        single = CryptoPP.cipher_factory(:aes, :key_hex => '01' * 16, :block_mode => :cbc, :padding => :pkcs, :iv => ivs[i])
+        single.plaintext = message
+        assert_equal(single.encrypt, ciphertexts[i])
+      end
+
+      assert_equal(messages, cipher.decrypt_batch(ciphertexts, :ivs => ivs).collect { |m| m.force_encoding("BINARY") })
+      assert_equal('iv' * 8, cipher.iv)
+    end
+
+    arc4 = CryptoPP.cipher_factory(:arc4, :key_hex => '01' * 16)
+    assert_equal(messages, arc4.decrypt_batch(arc4.encrypt_batch(messages)).collect { |m| m.force_encoding("BINARY") })
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      arc4.encrypt_batch(messages, :ivs => [])
+    end
+  end
+
+  def test_batch_cbc_multi_buffer
+    # more messages than lanes, of every length around a block boundary
+    messages = (0...40).collect { |i| (i % 256).chr * (i * 7) }
+    ivs = (0...messages.length).collect { |i| i.chr * 16 }
+
+    [ :pkcs, :zeros, :one_and_zeros ].each do |padding|
+      [ 1, 4 ].each do |threads|
+        cipher = CryptoPP.cipher_factory(:aes, :key_hex => '01' * 16, :block_mode => :cbc, :padding => padding, :threads => threads)
+        ciphertexts = cipher.encrypt_batch(messages, :ivs => ivs)
+
+        messages.each_with_index do |message, i|
+          single = CryptoPP.cipher_factory(:aes, :key_hex => '01' * 16, :block_mode => :cbc, :padding => padding, :iv => ivs[i])
+          single.plaintext = message
+          assert_equal(single.encrypt, ciphertexts[i], "#{padding} #{threads} #{i}")
+        end
+      end
+    end
+  end
+
+  def test_encrypt_many
+    entries = [ 'foo', '', 'a' * 100, (0...256).map(&:chr).join * 4096 ].each_with_index.collect do |message, i|
+      [ (i + 1).chr * 16, i.chr * 16, message ]
+    end
+
+    [ [ :aes, { :block_mode => :ctr } ],
+      [ :aes, { :block_mode => :cbc, :padding => :pkcs, :threads => 4 } ],
+      [ :rc5, { :block_mode => :cbc, :padding => :pkcs, :rounds => 12 } ],
+      [ :arc4, {} ]
+    ].each do |algorithm, options|
+      ciphertexts = CryptoPP.encrypt_many(algorithm, entries, options)
+
+      entries.each_with_index do |(key, iv, message), i|
+        single = CryptoPP.cipher_factory(algorithm, options.merge(:key => key, :iv => iv))
+        single.plaintext = message
+        assert_equal(single.encrypt, ciphertexts[i], "#{algorithm} #{options.inspect}")
+      end
+
+      decrypted = CryptoPP.decrypt_many(algorithm, entries.zip(ciphertexts).collect { |(key, iv, _), c| [ key, iv, c ] }, options)
+      assert_equal(entries.collect(&:last), decrypted.collect { |m| m.force_encoding("BINARY") })
+    end
+  end
+
+  def test_implementation_name
+    [ :aes, :arc4 ].each do |algorithm|
+      name = CryptoPP.cipher_factory(algorithm).implementation_name
+      assert_kind_of(String, name)
+      refute_empty(name)
+    end
+
+    features = CryptoPP.cpu_features
+    assert_kind_of(Hash, features)
+    features.each do |feature, available|
+      assert_kind_of(Symbol, feature)
+      assert_includes([ true, false ], available)
+    end
+  end
+
+  def test_gcm
+    plaintext = [ "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39" ].pack("H*")
+    ciphertext = "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091"
+    tag = "5bc94fbc3221a5db94fae95ae7121a47"
+
+    [ :gcm_2k, :gcm_64k ].each do |tables|
+      options = {
+        :key_hex => "feffe9928665731c6d6a8f9467308308",
+        :iv_hex => "cafebabefacedbaddecaf888",
+        :aad_hex => "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+        :block_mode => :gcm,
+        :gcm_tables => tables
+      }
+
+      cipher = CryptoPP.cipher_factory(:aes, options.merge(:plaintext => plaintext))
+      cipher.encrypt
+      assert_equal(ciphertext + tag, cipher.ciphertext_hex)
+      assert_equal(tag, cipher.tag_hex)
+      assert_equal(tables, cipher.gcm_tables)
+
+      cipher = CryptoPP.cipher_factory(:aes, options.merge(:ciphertext_hex => ciphertext + tag))
+      assert_equal(plaintext, cipher.decrypt.force_encoding("BINARY"))
+
+      cipher = CryptoPP.cipher_factory(:aes, options.merge(:ciphertext_hex => ciphertext + tag.reverse))
+      assert_raises(CryptoPP::CryptoPPError) do
+        cipher.decrypt
+      end
+    end
+
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :gcm, :key => "x" * 16, :iv => "y" * 12, :tag_length => 12)
+    cipher.plaintext = "hello world"
+    assert_equal(11 + 12, cipher.encrypt.length)
+    assert_equal(12, cipher.tag.length)
+    assert_raises(CryptoPP::CryptoPPError) do
+      cipher.padding = :pkcs
+    end
+
+    # no IV means the same nonce for every message
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :gcm, :key => "x" * 16)
+    assert_raises(CryptoPP::CryptoPPError) do
+      cipher.encrypt("hello world")
+    end
+  end
+
+  def test_encrypt_then_mac
+    options = {
+      :key => "0123456789abcdef",
+      :iv => "fedcba9876543210",
+      :block_mode => :cbc,
+      :mac => :sha256_hmac,
+      :mac_key => "mac key" * 4
+    }
+    plaintext = "The quick brown fox jumps over the lazy dog"
+    ciphertext = "edba03fe193e35946bf5215234d3f84759e7bf360a4b89e541f541c6e84fbb9c24d652004bf731d822d7530bd3844457"
+    tag = "57b3ea9024d38eb01766aa7917845909"
+
+    cipher = CryptoPP.cipher_factory(:aes, options.merge(:plaintext => plaintext))
+    cipher.encrypt
+    assert_equal(ciphertext + tag, cipher.ciphertext_hex)
+    assert_equal(tag, cipher.tag_hex)
+    assert_equal(:sha256_hmac, cipher.mac)
+
+    cipher = CryptoPP.cipher_factory(:aes, options.merge(:ciphertext_hex => ciphertext + tag))
+    assert_equal(plaintext, cipher.decrypt)
+
+    [ ciphertext.sub(/^../, "00") + tag, ciphertext + tag.reverse ].each do |tampered|
+      cipher = CryptoPP.cipher_factory(:aes, options.merge(:ciphertext_hex => tampered))
+      assert_raises(CryptoPP::CryptoPPError) do
+        cipher.decrypt
+      end
+      assert_empty(cipher.plaintext)
+    end
+
+    cipher = CryptoPP.cipher_factory(:twofish, :key => "k" * 32, :iv => "i" * 16, :block_mode => :ctr, :mac => :sha512_hmac, :mac_key => "m" * 64, :tag_length => 8)
+    cipher.plaintext = "x" * 1000
+    encrypted = cipher.encrypt
+    assert_equal(1008, encrypted.length)
+    cipher.ciphertext = encrypted
+    assert_equal("x" * 1000, cipher.decrypt)
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :mac => :sha256)
+    end
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:arc4, :mac => :sha256_hmac)
+    end
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :key => "k" * 16, :iv => "i" * 16, :block_mode => :cbc, :mac => :sha256_hmac).encrypt("hello")
+    end
+  end
+
+  def test_eax_and_ocb
+    vectors = [
+      # from the EAX paper
+      [ :eax, "91945d3f4dcbee0bf45ef52255f095a4", "becaf043b0a23d843194ba972c66debd", "fa3bfd4806eb53fa", "f7fb", "19dd5c4c9331049d0bdab0277408f67967e5" ],
+      [ :eax, "233952dee4d5ed5f9b9c6d6ff80ff478", "62ec67f9c3a4a407fcb2a8c49031a8b3", "6bfb914fd07eae6b", "", "e037830e8389f27b025a2d6527e79d01" ]
+    ]
+
+    if CryptoPP::CRYPTOPP_VERSION >= 600
+      vectors.push(
+        # from RFC 7253
+        [ :ocb, "000102030405060708090a0b0c0d0e0f", "bbaa99887766554433221101", "0001020304050607", "0001020304050607", "6820b3657b6f615a5725bda0d3b4eb3a257c9af1f8f03009" ],
+        [ :ocb, "6b" * 16, "6e" * 12, "header".unpack("H*").first, "The quick brown fox jumps over the lazy dog".unpack("H*").first, "4c1433bb94ebc1b3ae2cb504ed380ac0db683371964456a801fbfb91eb485eb3c519a4b6fcb5f245366e602ac5b8d4d6d2130288c9120189f16b08" ]
+      )
+    end
+
+    vectors.each do |mode, key, iv, aad, plaintext, expected|
+      options = { :block_mode => mode, :key_hex => key, :iv_hex => iv, :aad_hex => aad }
+
+      cipher = CryptoPP.cipher_factory(:aes, options.merge(:plaintext_hex => plaintext))
+      cipher.encrypt
+      assert_equal(expected, cipher.ciphertext_hex, mode.to_s)
+
+      cipher = CryptoPP.cipher_factory(:aes, options.merge(:ciphertext_hex => expected))
+      cipher.decrypt
+      assert_equal(plaintext, cipher.plaintext_hex, mode.to_s)
+
+      cipher = CryptoPP.cipher_factory(:aes, options.merge(:ciphertext_hex => expected, :aad => "tampered"))
+      assert_raises(CryptoPP::CryptoPPError) do
+        cipher.decrypt
+      end
+    end
+
+    modes = [ :eax ]
+    modes << :ocb if CryptoPP::CRYPTOPP_VERSION >= 600
+
+    modes.each do |mode|
+      [ 0, 15, 16, 17, 1000, 4099 ].each do |length|
+        message = "m" * length
+        cipher = CryptoPP.cipher_factory(:serpent, :block_mode => mode, :key => "k" * 16, :iv => "i" * 12, :aad => "a" * 20, :tag_length => 12)
+        cipher.plaintext = message
+        encrypted = cipher.encrypt
+        assert_equal(length + 12, encrypted.length)
+
+        cipher.ciphertext = encrypted
+        assert_equal(message, cipher.decrypt, "#{mode} #{length}")
+      end
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      cipher = CryptoPP.cipher_factory(:blowfish, :block_mode => :ocb, :key => "k" * 16, :plaintext => "hello")
+      cipher.encrypt
+    end
+  end
+
+  def test_xts
+    # IEEE 1619 vector 2
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :xts, :key_hex => "11" * 16 + "22" * 16, :iv_hex => "3333333333" + "00" * 11)
+    assert_equal(32, cipher.key_length)
+    cipher.plaintext_hex = "44" * 32
+    cipher.encrypt
+    assert_equal("c454185e6a16936e39334038acef838bfb186fff7480adc4289382ecd6d394f0", cipher.ciphertext_hex)
+
+    # vector 1 has the same key for data and tweaks, which isn't allowed
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :xts, :key_hex => "00" * 32, :iv_hex => "00" * 16).encrypt("\0" * 32)
+    end
+
+    # checked against OpenSSL's aes-128-xts, with ciphertext stealing
+    key = (0..31).to_a.pack("C*")
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :xts, :key => key, :iv => [ 5 ].pack("Q<") + "\0" * 8)
+    cipher.plaintext = "The quick brown fox jumps"
+    cipher.encrypt
+    assert_equal("d4ed4036330b156951de490435b9afbb586d0f12afa755d597", cipher.ciphertext_hex)
+    assert_equal("The quick brown fox jumps", cipher.decrypt)
+
+    # sectors match encrypting each one with its number as the tweak
+    data = (0...520 * 3).collect { |i| (i % 251).chr }.join
+    expected = (0...3).collect { |i|
+      cipher.iv = [ 5 + i ].pack("Q<") + "\0" * 8
+      cipher.plaintext = data[i * 520, 520]
+      cipher.encrypt
+    }.join
+    assert_equal(expected, cipher.encrypt_sectors(data, 5, 520))
+    assert_equal(data, cipher.decrypt_sectors(expected, 5, 520))
+
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :xts, :key => "k" * 32 + "t" * 32, :threads => 4)
+    assert_equal(64, cipher.key_length)
+    data = "d" * (4096 * 300)
+    encrypted = cipher.encrypt_sectors(data, 1 << 40, 4096)
+    assert_equal(data.length, encrypted.length)
+    assert_equal(data, cipher.decrypt_sectors(encrypted, 1 << 40, 4096))
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      cipher.encrypt_sectors("d" * 4100, 0, 4096)
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :cbc, :key => key).encrypt_sectors("d" * 512, 0, 512)
+    end
+  end
+
+  def test_decrypt_range
+    message = (0...5000).collect { |i| (i % 253).chr }.join
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16, :plaintext => message)
+    encrypted = cipher.encrypt
+
+    [ [ 0, 10 ], [ 5, 20 ], [ 16, 16 ], [ 1000, 3000 ], [ 4990, 100 ], [ 6000, 10 ] ].each do |offset, length|
+      expected = message.byteslice(offset, length) || ""
+      assert_equal(expected, cipher.decrypt_range(encrypted, offset, length), "#{offset} #{length}")
+      assert_equal(expected, cipher.decrypt_range(StringIO.new(encrypted), offset, length), "#{offset} #{length}")
+    end
+    assert_equal(message, cipher.plaintext)
+
+    message = "m" * (2 * 1024 * 1024)
+    cipher = CryptoPP.cipher_factory(:twofish, :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16, :plaintext => message, :threads => 4)
+    encrypted = cipher.encrypt
+    assert_equal(message[12345, 1024 * 1024], cipher.decrypt_range(encrypted, 12345, 1024 * 1024))
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :cbc, :key => "k" * 16).decrypt_range(encrypted, 0, 16)
+    end
+  end
+
+  def test_chacha20
+    return unless CryptoPP.cipher_enabled?(:chacha20)
+
+    # RFC 8439 starts its example at block 1 of the keystream
+    plaintext = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it."
+    cipher = CryptoPP.cipher_factory(:chacha20, :key_hex => (0...32).collect { |i| "%02x" % i }.join, :iv_hex => "000000000000004a00000000")
+    cipher.seek(64)
+    assert_equal("6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0bf91b65c5524733ab8f593dabcd62b3571639d624e65152ab8f530c359f0861d807ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab77937365af90bbf74a35be6b40b8eedf2785e42874d", cipher.encrypt(plaintext).unpack("H*").first)
+
+    xchacha = CryptoPP.cipher_factory(:xchacha20, :key => "k" * 32, :iv => "n" * 24)
+    message = "m" * 1000
+    encrypted = xchacha.encrypt(message)
+    assert_equal(message, xchacha.decrypt(encrypted))
+    assert_equal(message.byteslice(500, 500), xchacha.process_at(500, encrypted.byteslice(500, 500)))
+
+    aead = CryptoPP.cipher_factory(:chacha20_poly1305, :key => "k" * 32, :iv => "n" * 12, :aad => "header")
+    encrypted = aead.encrypt(message)
+    assert_equal(message.length + 16, encrypted.length)
+    assert_equal(encrypted.byteslice(-16, 16), aead.tag)
+    assert_equal(message, aead.decrypt(encrypted))
+
+    aead.aad = "other header"
+    assert_raises(CryptoPP::CryptoPPError) do
+      aead.decrypt(encrypted)
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      aead.encrypt!("m" * 16)
+    end
+    assert_raises(CryptoPP::CryptoPPError) do
+      aead.seek(64)
+    end
+  end
+
+  def test_stream_cipher_seeking
+    message = (0...10000).collect { |i| (i % 251).chr }.join
+    cipher = CryptoPP.cipher_factory(:seal_be, :key => "k" * 20, :iv => "i" * 4, :plaintext => message)
+    encrypted = cipher.encrypt
+    assert_equal(0, cipher.position)
+
+    [ [ 0, 100 ], [ 3, 50 ], [ 4096, 1000 ], [ 9999, 1 ] ].each do |position, length|
+      assert_equal(message.byteslice(position, length), cipher.process_at(position, encrypted.byteslice(position, length)))
+    end
+
+    cipher.seek(5000)
+    assert_equal(5000, cipher.position)
+    cipher.ciphertext = encrypted.byteslice(5000, 5000)
+    assert_equal(message.byteslice(5000, 5000), cipher.decrypt)
+    assert_equal(message.byteslice(0, 10), cipher.process_at(0, encrypted.byteslice(0, 10)))
+
+    arc4 = CryptoPP.cipher_factory(:arc4, :key => "k" * 16)
+    arc4.seek(0)
+    assert_raises(CryptoPP::CryptoPPError) do
+      arc4.seek(10)
+    end
+    assert_raises(CryptoPP::CryptoPPError) do
+      arc4.process_at(10, "data")
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :key => "k" * 16).seek(16)
+    end
+  end
+
+  def test_precompute_keystream
+    message = "m" * 777
+
+    [
+      [ :aes, { :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16 } ],
+      [ :camellia, { :block_mode => :ofb, :key => "k" * 16, :iv => "i" * 16 } ],
+      [ :arc4, { :key => "k" * 16 } ],
+      [ :seal_be, { :key => "k" * 20, :iv => "i" * 4 } ]
+    ].each do |algorithm, options|
+      expected = CryptoPP.cipher_factory(algorithm, options.merge(:plaintext => message)).encrypt
+
+      [ false, true ].each do |background|
+        cipher = CryptoPP.cipher_factory(algorithm, options)
+        cipher.precompute_keystream(1000, background)
+        cipher.plaintext = message
+        assert_equal(expected, cipher.encrypt, "#{algorithm} #{background}")
+        cipher.ciphertext = expected
+        assert_equal(message, cipher.decrypt, "#{algorithm} #{background}")
+
+        # too long for the keystream, so it goes the usual way
+        cipher.plaintext = message * 2
+        assert_equal(message * 2, CryptoPP.cipher_factory(algorithm, options.merge(:ciphertext => cipher.encrypt)).decrypt)
+      end
+    end
+
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16)
+    cipher.precompute_keystream(1000)
+    cipher.iv = "j" * 16
+    cipher.plaintext = message
+    assert_equal(CryptoPP.cipher_factory(:aes, :block_mode => :ctr, :key => "k" * 16, :iv => "j" * 16, :plaintext => message).encrypt, cipher.encrypt)
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :cbc, :key => "k" * 16).precompute_keystream(1000)
+    end
+  end
+
+  def test_encrypt_data
+    message = "m" * 777
+
+    [
+      [ :aes, { :block_mode => :cbc, :key => "k" * 16, :iv => "i" * 16 } ],
+      [ :aes, { :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16, :threads => 4 } ],
+      [ :aes, { :block_mode => :gcm, :key => "k" * 16, :iv => "i" * 12 } ],
+      [ :aes, { :block_mode => :xts, :key => "k" * 16 + "t" * 16, :iv => "i" * 16 } ],
+      [ :aes, { :block_mode => :cbc, :key => "k" * 16, :iv => "i" * 16, :mac => :sha256_hmac, :mac_key => "m" * 32 } ],
+      [ :arc4, { :key => "k" * 16 } ]
+    ].each do |algorithm, options|
+      expected = CryptoPP.cipher_factory(algorithm, options.merge(:plaintext => message)).encrypt
+
+      cipher = CryptoPP.cipher_factory(algorithm, options)
+      assert_equal(expected, cipher.encrypt(message), "#{algorithm} #{options[:block_mode]}")
+      assert_equal(message, cipher.decrypt(expected), "#{algorithm} #{options[:block_mode]}")
+      assert_equal("", cipher.plaintext)
+      assert_equal("", cipher.ciphertext)
     end
+
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :gcm, :key => "k" * 16, :iv => "i" * 12)
+    ciphertext = cipher.encrypt(message)
+    ciphertext[0] = (ciphertext[0].ord ^ 1).chr
+    assert_raises(CryptoPP::CryptoPPError) do
+      cipher.decrypt(ciphertext)
+    end
+  end
+
+  def test_module_encrypt
+    message = "m" * 777
+    key = "k" * 16
+    iv = "i" * 16
+
+    [
+      [ :aes, iv, { :block_mode => :ctr } ],
+      [ :aes, iv, { :block_mode => :cbc, :padding => :pkcs } ],
+      [ :aes, "i" * 12, { :block_mode => :gcm, :aad => "aad", :tag_length => 12 } ],
+      [ :rc6, iv, { :block_mode => :cbc, :rounds => 24 } ],
+      [ :arc4, nil, {} ]
+    ].each do |algorithm, iv, options|
+      expected = CryptoPP.cipher_factory(algorithm, options.merge(:key => key, :iv => iv, :plaintext => message)).encrypt
+
+      # the second time around comes from the cache
+      2.times do
+        assert_equal(expected, CryptoPP.encrypt(algorithm, key, iv, message, options), algorithm.to_s)
+        assert_equal(message, CryptoPP.decrypt(algorithm, key, iv, expected, options), algorithm.to_s)
+      end
+    end
+
+    # the same key under a different IV
+    assert_equal(
+      CryptoPP.cipher_factory(:aes, :block_mode => :ctr, :key => key, :iv => "j" * 16, :plaintext => message).encrypt,
+      CryptoPP.encrypt(:aes, key, "j" * 16, message, :block_mode => :ctr)
+    )
+
+    threads = (1..4).collect do |i|
+      Thread.new do
+        50.times.all? do
+          CryptoPP.decrypt(:aes, key * i, iv, CryptoPP.encrypt(:aes, key * i, iv, message, :block_mode => :ctr), :block_mode => :ctr) == message
+        end
+      end
+    end
+    assert(threads.collect(&:value).all?)
+
+    size = CryptoPP.cipher_cache_size
+    begin
+      CryptoPP.cipher_cache_size = 0
+      assert_equal(message, CryptoPP.decrypt(:aes, key, iv, CryptoPP.encrypt(:aes, key, iv, message, :block_mode => :ctr), :block_mode => :ctr))
+    ensure
+      CryptoPP.cipher_cache_size = size
+    end
+
+    # a call that fails still leaves the cached cipher usable
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.encrypt(:aes, key, "j" * 3, message, :block_mode => :ctr)
+    end
+    assert_equal(message, CryptoPP.decrypt(:aes, key, iv, CryptoPP.encrypt(:aes, key, iv, message, :block_mode => :ctr), :block_mode => :ctr))
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.encrypt(:arc4, key, nil, message, :block_mode => :cbc)
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.encrypt(:aes, key, iv, message, :block_mode => :ctr, :padding => :pkcs)
+    end
+  end
+
+  def test_encrypt_in_place
+    message = "m" * 777
+
+    [
+      [ :aes, { :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16 } ],
+      [ :aes, { :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16, :threads => 4 } ],
+      [ :aes, { :block_mode => :cfb, :key => "k" * 16, :iv => "i" * 16, :threads => 4 } ],
+      [ :aes, { :block_mode => :ofb, :key => "k" * 16, :iv => "i" * 16 } ],
+      [ :aes, { :block_mode => :cbc_cts, :key => "k" * 16, :iv => "i" * 16 } ],
+      [ :arc4, { :key => "k" * 16 } ]
+    ].each do |algorithm, options|
+      [ message, message * 1000, message[0, 32] ].each do |plaintext|
+        expected = CryptoPP.cipher_factory(algorithm, options.merge(:plaintext => plaintext)).encrypt
+
+        cipher = CryptoPP.cipher_factory(algorithm, options)
+        buffer = plaintext.dup
+        assert_same(buffer, cipher.encrypt!(buffer))
+        assert_equal(expected, buffer, "#{algorithm} #{options[:block_mode]} #{plaintext.length}")
+        cipher.decrypt!(buffer)
+        assert_equal(plaintext, buffer, "#{algorithm} #{options[:block_mode]} #{plaintext.length}")
+      end
+    end
+
+    # a String sharing its buffer with another leaves the other one alone
+    original = "m" * 100
+    copy = original.dup
+    CryptoPP.cipher_factory(:aes, :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16).encrypt!(copy)
+    assert_equal("m" * 100, original)
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :cbc, :key => "k" * 16, :iv => "i" * 16).encrypt!(message.dup)
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :gcm, :key => "k" * 16, :iv => "i" * 12).encrypt!(message.dup)
+    end
+
+    assert_raises(RuntimeError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :ctr, :key => "k" * 16, :iv => "i" * 16).encrypt!(message.dup.freeze)
+    end
+  end
+
+  def test_direct_padding
+    # encrypt and decrypt pad by hand while update and final still go
+    # through Crypto++'s filters, so the two have to agree
+    [ :ecb, :cbc ].each do |mode|
+      [ :none, :zeros, :pkcs, :one_and_zeros, :default ].each do |padding|
+        (0..33).each do |length|
+          next if padding == :none && length % 16 != 0
+
+          plaintext = "p" * length
+          cipher = CryptoPP.cipher_factory(:aes, :block_mode => mode, :padding => padding, :key => "k" * 16, :iv => "i" * 16)
+          ciphertext = cipher.encrypt(plaintext)
+          assert_equal(cipher.update(plaintext) + cipher.final, ciphertext, "#{mode} #{padding} #{length}")
+
+          next if ciphertext.empty?
+          assert_equal(cipher.decrypt_update(ciphertext) + cipher.final, cipher.decrypt(ciphertext), "#{mode} #{padding} #{length}")
+        end
+      end
+    end
+
+    cipher = CryptoPP.cipher_factory(:aes, :block_mode => :cbc, :padding => :pkcs, :key => "k" * 16, :iv => "i" * 16)
+    ciphertext = cipher.encrypt("p" * 20)
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      cipher.decrypt(ciphertext[0, 31])
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      cipher.decrypt("")
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :cbc, :padding => :pkcs, :key => "k" * 16, :iv => "j" * 16).decrypt(ciphertext[16, 16])
+    end
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP.cipher_factory(:aes, :block_mode => :cbc, :padding => :none, :key => "k" * 16).encrypt("p" * 20)
+    end
+  end
+
+  private
+
+  # Encrypts and decrypts an ECB test vector repeated count times, which is
+  # enough blocks at once for the bitsliced and multi-block kernels with a
+  # few left over. The vector's rounds are used if it has any.
+  def assert_repeated_vector(algorithm, options, count)
+    factory_options = { :key_hex => options[:key_hex], :block_mode => :ecb, :padding => :none }
+    factory_options[:rounds] = options[:rounds] if options[:rounds]
+    cipher = CryptoPP.cipher_factory(algorithm, factory_options)
+    plaintext = [ options[:plaintext_hex] ].pack('H*') * count
+    ciphertext = [ options[:ciphertext_hex] ].pack('H*') * count
+    message = "#{algorithm} #{options[:key_hex]} #{options[:rounds]}".strip
+
+    assert_equal(ciphertext, cipher.encrypt(plaintext), message)
+    assert_equal(plaintext, cipher.decrypt(ciphertext), message)
+  end
+
+  # Checks the modes that hand the kernels runs of blocks against feeding
+  # them a block at a time, which never reaches the kernels. CTR's counter
+  # carries over its last byte along the way, while OFB and CFB feed each
+  # block's output into the next. CBC only encrypts a block at a time, but
+  # decrypts in bulk.
+  def assert_bulk_modes(algorithm, key_hex, block_size)
+    plaintext = (0...256).map(&:chr).join * 64 + 'tail'
+    options = { :key_hex => key_hex, :iv_hex => 'fe' * (block_size - 2) + 'ff' * 2 }
+    message = "#{algorithm} #{key_hex.length / 2}"
+
+    [ :ctr, :ofb, :cfb ].each do |mode|
+      cipher = CryptoPP.cipher_factory(algorithm, options.merge(:block_mode => mode))
+      expected = plaintext.scan(/.{1,#{block_size}}/m).inject('') { |memo, chunk| memo + cipher.update(chunk) } + cipher.final
+      assert_equal(expected, cipher.encrypt(plaintext), "#{message} #{mode}")
+      assert_equal(plaintext, cipher.decrypt(expected), "#{message} #{mode}")
+    end
+
+    cbc = CryptoPP.cipher_factory(algorithm, options.merge(:block_mode => :cbc, :padding => :pkcs))
+    assert_equal(plaintext, cbc.decrypt(cbc.encrypt(plaintext)), "#{message} cbc")
   end
 end